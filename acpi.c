@@ -17,6 +17,9 @@ struct RSDPDescriptor20 {
  uint8_t reserved[3];
 } __attribute__ ((packed));
 
+/* The firmware's RSDP, kept so other code can look up ACPI tables. */
+static struct RSDPDescriptor *acpi_rsdp;
+
 int copy_rsdt(struct csmwrap_priv *priv)
 {
     int i;
@@ -33,12 +36,14 @@ int copy_rsdt(struct csmwrap_priv *priv)
         if (!efi_guidcmp(table->VendorGuid, acpi2Guid)) {
             printf("Found ACPI 2.0 RSDT at %lx, copied to %lx\n", (uintptr_t)table->VendorTable, (uintptr_t)table_target);
             memcpy(table_target, table->VendorTable, sizeof(struct RSDPDescriptor20));
+            acpi_rsdp = table->VendorTable;
             return 0;
         }
 
         if (!efi_guidcmp(table->VendorGuid, acpiGuid)) {
             printf("Found ACPI 1.0 RSDT at %lx, copied to %lx\n", (uintptr_t)table->VendorTable, (uintptr_t)table_target);
             memcpy(table_target, table->VendorTable, sizeof(struct RSDPDescriptor));
+            acpi_rsdp = table->VendorTable;
             return 0;
         }
 
@@ -47,3 +52,129 @@ int copy_rsdt(struct csmwrap_priv *priv)
     printf("No ACPI RSDT found\n");
     return -1;
 }
+
+/*
+ * Find an ACPI table by signature through the XSDT (ACPI 2.0+) or the RSDT.
+ * Only tables below 4GiB can be reached, we run without paging.
+ */
+void *acpi_find_table(uint32_t signature)
+{
+    EFI_ACPI_DESCRIPTION_HEADER *sdt;
+    uint32_t entry_size;
+    uint32_t entries;
+    uint8_t *entry;
+
+    if (acpi_rsdp == NULL)
+        return NULL;
+
+    if (acpi_rsdp->Revision >= 2 && ((struct RSDPDescriptor20 *)acpi_rsdp)->XsdtAddress != 0 &&
+        ((struct RSDPDescriptor20 *)acpi_rsdp)->XsdtAddress <= 0xffffffff) {
+        sdt = (EFI_ACPI_DESCRIPTION_HEADER *)(uintptr_t)((struct RSDPDescriptor20 *)acpi_rsdp)->XsdtAddress;
+        entry_size = sizeof(uint64_t);
+    } else {
+        sdt = (EFI_ACPI_DESCRIPTION_HEADER *)(uintptr_t)acpi_rsdp->RsdtAddress;
+        entry_size = sizeof(uint32_t);
+    }
+
+    if (sdt == NULL || sdt->Length < sizeof(EFI_ACPI_DESCRIPTION_HEADER))
+        return NULL;
+
+    entries = (sdt->Length - sizeof(EFI_ACPI_DESCRIPTION_HEADER)) / entry_size;
+    entry = (uint8_t *)sdt + sizeof(EFI_ACPI_DESCRIPTION_HEADER);
+
+    for (uint32_t i = 0; i < entries; i++, entry += entry_size) {
+        EFI_ACPI_DESCRIPTION_HEADER *table;
+        uint64_t addr;
+
+        if (entry_size == sizeof(uint64_t))
+            addr = *(uint64_t *)entry;
+        else
+            addr = *(uint32_t *)entry;
+
+        if (addr == 0 || addr > 0xffffffff)
+            continue;
+
+        table = (EFI_ACPI_DESCRIPTION_HEADER *)(uintptr_t)addr;
+        if (table->Signature == signature)
+            return table;
+    }
+
+    return NULL;
+}
+
+static void acpi_visit_sdt(uint64_t addr, acpi_visit_t visit, void *ctx)
+{
+    EFI_ACPI_DESCRIPTION_HEADER *table;
+
+    if (addr == 0 || addr > 0xffffffff)
+        return;
+
+    table = (EFI_ACPI_DESCRIPTION_HEADER *)(uintptr_t)addr;
+    visit(table, table->Length, ctx);
+}
+
+/*
+ * Call `visit` for the RSDP, the RSDT and XSDT, every table listed in the
+ * one acpi_find_table would use, and the DSDT and FACS the FADT points to.
+ * Used to capture what the firmware handed us; tables are not validated.
+ */
+void acpi_walk_tables(const void *rsdp_ptr, acpi_visit_t visit, void *ctx)
+{
+    const struct RSDPDescriptor *rsdp = rsdp_ptr;
+    const struct RSDPDescriptor20 *rsdp20 = rsdp_ptr;
+    EFI_ACPI_DESCRIPTION_HEADER *sdt;
+    uint32_t entry_size;
+    uint8_t *entry;
+    uint32_t entries;
+
+    if (rsdp == NULL)
+        return;
+
+    if (rsdp->Revision >= 2) {
+        visit(rsdp, sizeof(struct RSDPDescriptor20), ctx);
+        acpi_visit_sdt(rsdp->RsdtAddress, visit, ctx);
+        acpi_visit_sdt(rsdp20->XsdtAddress, visit, ctx);
+    } else {
+        visit(rsdp, sizeof(struct RSDPDescriptor), ctx);
+        acpi_visit_sdt(rsdp->RsdtAddress, visit, ctx);
+    }
+
+    if (rsdp->Revision >= 2 && rsdp20->XsdtAddress != 0 && rsdp20->XsdtAddress <= 0xffffffff) {
+        sdt = (EFI_ACPI_DESCRIPTION_HEADER *)(uintptr_t)rsdp20->XsdtAddress;
+        entry_size = sizeof(uint64_t);
+    } else {
+        sdt = (EFI_ACPI_DESCRIPTION_HEADER *)(uintptr_t)rsdp->RsdtAddress;
+        entry_size = sizeof(uint32_t);
+    }
+
+    if (sdt == NULL || sdt->Length < sizeof(EFI_ACPI_DESCRIPTION_HEADER))
+        return;
+
+    entries = (sdt->Length - sizeof(EFI_ACPI_DESCRIPTION_HEADER)) / entry_size;
+    entry = (uint8_t *)sdt + sizeof(EFI_ACPI_DESCRIPTION_HEADER);
+
+    for (uint32_t i = 0; i < entries; i++, entry += entry_size) {
+        uint64_t addr = (entry_size == sizeof(uint64_t)) ? *(uint64_t *)entry : *(uint32_t *)entry;
+        EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *fadt;
+
+        acpi_visit_sdt(addr, visit, ctx);
+
+        if (addr == 0 || addr > 0xffffffff)
+            continue;
+
+        fadt = (EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE *)(uintptr_t)addr;
+        if (fadt->Header.Signature != SIGNATURE_32('F', 'A', 'C', 'P'))
+            continue;
+
+        // The FACS has no standard header, only its length.
+        if (fadt->FirmwareCtrl != 0)
+            visit((void *)(uintptr_t)fadt->FirmwareCtrl,
+                  ((EFI_ACPI_DESCRIPTION_HEADER *)(uintptr_t)fadt->FirmwareCtrl)->Length, ctx);
+
+        if (fadt->Header.Length >= offsetof(EFI_ACPI_2_0_FIXED_ACPI_DESCRIPTION_TABLE, XDsdt) + sizeof(uint64_t) &&
+            fadt->XDsdt != 0)
+            acpi_visit_sdt(fadt->XDsdt, visit, ctx);
+        else
+            acpi_visit_sdt(fadt->Dsdt, visit, ctx);
+    }
+}
@@ -6,6 +6,19 @@
 
 #pragma once
 
+extern int isupper(int);
+extern int islower(int);
+extern int isalpha(int);
+extern int isdigit(int);
+extern int isalnum(int);
+extern int isascii(int);
+extern int isblank(int);
+extern int iscntrl(int);
+extern int isspace(int);
+extern int isxdigit(int);
+extern int toupper(int);
+extern int tolower(int);
+
 extern void *memccpy(void *, const void *, int, size_t);
 extern void *memchr(const void *, int, size_t);
 extern void *memrchr(const void *, int, size_t);
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Build HDD_INFO and the BBS table for the CSM from the PCI cache.
+ * SPDX-License-Identifier: LGPL-2.1-only
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "pci.h"
+
+/* Legacy (compatibility mode) IDE resources */
+#define IDE_PRIMARY_CMD         0x1F0
+#define IDE_PRIMARY_CTRL        0x3F6
+#define IDE_PRIMARY_IRQ         14
+#define IDE_SECONDARY_CMD       0x170
+#define IDE_SECONDARY_CTRL      0x376
+#define IDE_SECONDARY_IRQ       15
+
+/* Programming interface bits: channel in native PCI mode */
+#define IDE_PROGIF_PRIMARY_NATIVE   0x01
+#define IDE_PROGIF_SECONDARY_NATIVE 0x04
+
+#define PCI_INTERRUPT_LINE      0x3C
+
+/*
+ * Fill one HDD_INFO per IDE channel, the same way EDK2's LegacyBiosBuildIdeData
+ * does: HddInfo[2n] is the primary and HddInfo[2n+1] the secondary channel of
+ * the n-th controller.
+ */
+static uint32_t build_hdd_info(HDD_INFO *hdd_info)
+{
+    struct pci_device *dev = NULL;
+    uint32_t channels = 0;
+
+    while ((dev = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_STORAGE_IDE, dev)) != NULL) {
+        for (uint32_t chan = 0; chan < 2 && channels < MAX_IDE_CONTROLLER; chan++) {
+            HDD_INFO *info = &hdd_info[channels++];
+            boolean_t native = dev->prog_if & (chan ? IDE_PROGIF_SECONDARY_NATIVE : IDE_PROGIF_PRIMARY_NATIVE);
+
+            info->Status = chan ? HDD_SECONDARY : HDD_PRIMARY;
+            info->Bus = dev->bus;
+            info->Device = PCI_SLOT(dev->devfn);
+            info->Function = PCI_FUNC(dev->devfn);
+
+            if (native) {
+                info->CommandBaseAddress = (uint16_t)(dev->bar[chan * 2] & ~3);
+                info->ControlBaseAddress = (uint16_t)((dev->bar[chan * 2 + 1] & ~3) + 2);
+                info->HddIrq = pci_cfg_read8(dev->bus, dev->devfn, PCI_INTERRUPT_LINE);
+            } else {
+                info->CommandBaseAddress = chan ? IDE_SECONDARY_CMD : IDE_PRIMARY_CMD;
+                info->ControlBaseAddress = chan ? IDE_SECONDARY_CTRL : IDE_PRIMARY_CTRL;
+                info->HddIrq = chan ? IDE_SECONDARY_IRQ : IDE_PRIMARY_IRQ;
+            }
+
+            if (dev->bar[4] & 1)
+                info->BusMasterAddress = (uint16_t)((dev->bar[4] & ~3) + chan * 8);
+
+            printf("HDD: %02x:%02x.%x %s cmd %x ctrl %x bm %x irq %d\n",
+                   dev->bus, PCI_SLOT(dev->devfn), PCI_FUNC(dev->devfn),
+                   chan ? "secondary" : "primary",
+                   info->CommandBaseAddress, info->ControlBaseAddress,
+                   info->BusMasterAddress, info->HddIrq);
+        }
+    }
+
+    return channels;
+}
+
+/*
+ * Map a `bootdev=` item to a BBS index: fd0 is entry 0, hdN is IDE drive N
+ * (primary master, primary slave, secondary master, ...).
+ */
+static int bbs_index_of(const char *item)
+{
+    uint32_t n;
+    const char *end;
+
+    if (!strcmp(item, "fd0"))
+        return 0;
+
+    if (!strncmp(item, "hd", 2) && parse_uint(item + 2, &n, &end) &&
+        *end == '\0' && n < MAX_IDE_CONTROLLER * 2)
+        return (int)(1 + n);
+
+    return -1;
+}
+
+/*
+ * Lay out the BBS table like EDK2's LegacyBiosInitBbsTable: entry 0 is the
+ * floppy, entries 1 + 2n (+1) are the master (slave) of IDE channel n. The
+ * boot order comes from `bootdev=hd0,hd1,...`; drives not listed there are
+ * marked do-not-boot so the CSM does not fall through to them. Without a
+ * bootdev= argument, IDE drives boot in channel order.
+ */
+int build_bbs_table(struct csmwrap_priv *priv)
+{
+    EFI_TO_COMPATIBILITY16_BOOT_TABLE *boot_table = &priv->low_stub->boot_table;
+    BBS_TABLE *bbs = priv->low_stub->bbs_table;
+    uint32_t channels;
+    uint32_t num_entries;
+    char order[64];
+    boolean_t pinned;
+
+    memset(boot_table->HddInfo, 0, sizeof(boot_table->HddInfo));
+    channels = build_hdd_info(boot_table->HddInfo);
+
+    num_entries = 1 + channels * 2;
+    memset(bbs, 0, sizeof(BBS_TABLE) * BBS_MAX_ENTRIES);
+
+    bbs[0].BootPriority = BBS_IGNORE_ENTRY;
+    bbs[0].DeviceType = BBS_FLOPPY;
+    bbs[0].Class = PCI_CLASS_STORAGE;
+    bbs[0].SubClass = 0x02; /* Floppy */
+
+    for (uint32_t chan = 0; chan < channels; chan++) {
+        HDD_INFO *info = &boot_table->HddInfo[chan];
+
+        for (uint32_t slave = 0; slave < 2; slave++) {
+            BBS_TABLE *entry = &bbs[1 + chan * 2 + slave];
+
+            entry->BootPriority = (uint16_t)(chan * 2 + slave);
+            entry->Bus = info->Bus;
+            entry->Device = info->Device;
+            entry->Function = info->Function;
+            entry->Class = PCI_CLASS_STORAGE;
+            entry->SubClass = PCI_SUBCLASS_STORAGE_IDE;
+            entry->DeviceType = BBS_HARDDISK;
+            entry->StatusFlags.Enabled = 1;
+            entry->StatusFlags.MediaPresent = 1; /* Unknown */
+        }
+    }
+
+    pinned = cmdline_get("bootdev", order, sizeof(order)) && order[0];
+    if (pinned) {
+        char *cursor = order;
+        char *item;
+        uint16_t priority = 0;
+
+        for (uint32_t i = 0; i < num_entries; i++)
+            bbs[i].BootPriority = BBS_DO_NOT_BOOT_FROM;
+
+        while ((item = strsep(&cursor, ",")) != NULL) {
+            int index = bbs_index_of(item);
+
+            if (index < 0 || (uint32_t)index >= num_entries) {
+                printf("BBS: ignoring unknown boot device '%s'\n", item);
+                continue;
+            }
+
+            bbs[index].BootPriority = priority++;
+            bbs[index].StatusFlags.Enabled = 1;
+        }
+    }
+
+    boot_table->NumberBbsEntries = num_entries;
+    boot_table->BbsTable = (uint32_t)(uintptr_t)bbs;
+
+    for (uint32_t i = 0; i < num_entries; i++) {
+        if (bbs[i].BootPriority < BBS_DO_NOT_BOOT_FROM)
+            printf("BBS: entry %d type %x priority %d\n", i, bbs[i].DeviceType, bbs[i].BootPriority);
+    }
+
+    return (int)num_entries;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Capture what the firmware hands us, for replay on the host.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "capture.h"
+
+static struct
+{
+    uint32_t    offset;     /* Bytes emitted so far */
+    uint32_t    sum;
+    uint8_t     line[CAPTURE_LINE_BYTES];
+    uint32_t    fill;
+} out;
+
+/* Fletcher-style running checksum; stays the same across split buffers. */
+uint32_t capture_checksum(uint32_t sum, const void *data, uint32_t size)
+{
+    const uint8_t *p = data;
+    uint32_t a = sum & 0xFFFF;
+    uint32_t b = sum >> 16;
+
+    while (size--) {
+        a = (a + *p++) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    return (b << 16) | a;
+}
+
+static void emit_flush(void)
+{
+    if (out.fill == 0)
+        return;
+
+    printf("CAPTURE: %08x ", out.offset - out.fill);
+    for (uint32_t i = 0; i < out.fill; i++)
+        printf("%02x", out.line[i]);
+    printf("\n");
+    out.fill = 0;
+}
+
+static void emit(const void *data, uint32_t size)
+{
+    const uint8_t *p = data;
+
+    out.sum = capture_checksum(out.sum, data, size);
+    while (size--) {
+        out.line[out.fill++] = *p++;
+        out.offset++;
+        if (out.fill == CAPTURE_LINE_BYTES)
+            emit_flush();
+    }
+}
+
+static void emit_block(uint16_t type, const void *data, uint32_t size)
+{
+    static const uint8_t pad[3];
+    capture_block_t block;
+
+    if (data == NULL || size == 0 || size > CAPTURE_MAX_BLOCK)
+        return;
+
+    block.magic = CAPTURE_MAGIC;
+    block.type = type;
+    block.version = CAPTURE_VERSION;
+    block.addr = (uint32_t)(uintptr_t)data;
+    block.size = size;
+
+    emit(&block, sizeof(block));
+    emit(data, size);
+    emit(pad, (4 - (size & 3)) & 3);
+}
+
+static void emit_acpi(const void *table, uint32_t length, void *ctx)
+{
+    (void)ctx;
+    emit_block(CAPTURE_ACPI, table, length);
+}
+
+/* SMBIOS 2.x (_SM_) and 3.x (_SM3_) entry points and their tables */
+static void emit_smbios(const uint8_t *ep)
+{
+    if (!memcmp(ep, "_SM3_", 5)) {
+        emit_block(CAPTURE_SMBIOS_EP, ep, ep[6]);
+        if (*(uint64_t *)(ep + 0x10) <= 0xffffffff)
+            emit_block(CAPTURE_SMBIOS_TABLE, (void *)(uintptr_t)*(uint64_t *)(ep + 0x10), *(uint32_t *)(ep + 0x0C));
+    } else if (!memcmp(ep, "_SM_", 4)) {
+        emit_block(CAPTURE_SMBIOS_EP, ep, ep[5]);
+        emit_block(CAPTURE_SMBIOS_TABLE, (void *)(uintptr_t)*(uint32_t *)(ep + 0x18), *(uint16_t *)(ep + 0x16));
+    }
+}
+
+/*
+ * capture: print the boot args, the EFI memory map, the configuration
+ * table and the ACPI and SMBIOS tables it points to as CAPTURE: lines
+ * (offset, then hex). Best used with console=debugcon or serial; the log
+ * can be replayed on the host with tools/capreplay.c.
+ */
+void capture_dump(void)
+{
+    efi_guid_t acpi_guid = ACPI_TABLE_GUID;
+    efi_guid_t acpi2_guid = ACPI_20_TABLE_GUID;
+    efi_guid_t smbios_guid = SMBIOS_TABLE_GUID;
+    efi_guid_t smbios3_guid = SMBIOS3_TABLE_GUID;
+    efi_system_table_t *st = (efi_system_table_t *) gBA->efi_sys_tbl;
+    const void *rsdp = NULL;
+    capture_block_t end;
+
+    memset(&out, 0, sizeof(out));
+    out.sum = 1;
+
+    emit_block(CAPTURE_BOOT_ARGS, gBA, sizeof(mach_boot_args_t));
+    emit_block(CAPTURE_EFI_MEMMAP, (void *)gBA->efi_mem_map_ptr, gBA->efi_mem_map_size);
+
+    if (st != NULL) {
+        emit_block(CAPTURE_EFI_SYSTAB, st, sizeof(efi_system_table_t));
+        emit_block(CAPTURE_EFI_CONFIG, st->ConfigurationTable,
+                   st->NumberOfTableEntries * sizeof(efi_configuration_table_t));
+
+        for (uint32_t i = 0; i < st->NumberOfTableEntries; i++) {
+            efi_configuration_table_t *table = st->ConfigurationTable + i;
+
+            // ACPI 2.0 wins over 1.0, as in copy_rsdt.
+            if (!efi_guidcmp(table->VendorGuid, acpi2_guid))
+                rsdp = table->VendorTable;
+            else if (!efi_guidcmp(table->VendorGuid, acpi_guid) && rsdp == NULL)
+                rsdp = table->VendorTable;
+            else if (!efi_guidcmp(table->VendorGuid, smbios_guid) ||
+                     !efi_guidcmp(table->VendorGuid, smbios3_guid))
+                emit_smbios(table->VendorTable);
+        }
+
+        acpi_walk_tables(rsdp, emit_acpi, NULL);
+    }
+
+    end.magic = CAPTURE_MAGIC;
+    end.type = CAPTURE_END;
+    end.version = CAPTURE_VERSION;
+    end.addr = out.sum;
+    end.size = 0;
+    emit(&end, sizeof(end));
+    emit_flush();
+
+    printf("CAPTURE: end, %d bytes, checksum %08x\n", out.offset, end.addr);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the firmware handoff capture and replay format.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+/*
+ * A capture is a stream of blocks, each a capture_block_t followed by
+ * `size` bytes padded to 4, starting with a CAPTURE_BOOT_ARGS block and
+ * ending with a CAPTURE_END block whose `addr` is the checksum of all
+ * bytes before it. Every block records the 32-bit physical address it was
+ * copied from, so the pointers inside the data stay valid on replay.
+ */
+#define CAPTURE_MAGIC           0x50414357  /* "WCAP" */
+#define CAPTURE_VERSION         1
+
+#define CAPTURE_END             0
+#define CAPTURE_BOOT_ARGS       1
+#define CAPTURE_EFI_MEMMAP      2
+#define CAPTURE_EFI_SYSTAB      3
+#define CAPTURE_EFI_CONFIG      4
+#define CAPTURE_ACPI            5   /* RSDP or any table reachable from it */
+#define CAPTURE_SMBIOS_EP       6
+#define CAPTURE_SMBIOS_TABLE    7
+
+/* Bytes per CAPTURE: line on the console */
+#define CAPTURE_LINE_BYTES      32
+/* Larger blocks are assumed to be garbage and skipped */
+#define CAPTURE_MAX_BLOCK       0x100000
+
+#pragma pack(1)
+typedef struct _capture_block_t
+{
+    uint32_t    magic;
+    uint16_t    type;
+    uint16_t    version;
+    uint32_t    addr;
+    uint32_t    size;
+} capture_block_t;
+#pragma pack()
+
+/* Functions */
+extern void capture_dump(void);
+extern uint32_t capture_checksum(uint32_t sum, const void *data, uint32_t size);
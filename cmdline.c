@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Boot command line parsing.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+
+/*
+ * The command line is a space separated list of `key` or `key=value`
+ * tokens, coming from the boot-args NVRAM variable or com.apple.Boot.plist.
+ */
+static const char *cmdline_find(const char *key)
+{
+    const char *p;
+    size_t key_len = strlen(key);
+
+    if (!gBA)
+        return NULL;
+
+    p = gBA->cmdline;
+    while (p < gBA->cmdline + MACH_CMDLINE && *p) {
+        while (*p == ' ')
+            p++;
+
+        if (!strncmp(p, key, key_len) && (p[key_len] == '=' || p[key_len] == ' ' || p[key_len] == '\0'))
+            return p + key_len;
+
+        while (*p && *p != ' ')
+            p++;
+    }
+
+    return NULL;
+}
+
+boolean_t cmdline_has(const char *key)
+{
+    return cmdline_find(key) != NULL;
+}
+
+/*
+ * Copy the value of `key` into `value`. A bare `key` yields an empty string.
+ */
+boolean_t cmdline_get(const char *key, char *value, size_t value_len)
+{
+    const char *p = cmdline_find(key);
+    size_t n = 0;
+
+    if (!p)
+        return false;
+
+    if (*p == '=')
+        p++;
+    else
+        p = "";
+
+    while (p[n] && p[n] != ' ' && n + 1 < value_len) {
+        value[n] = p[n];
+        n++;
+    }
+    if (value_len)
+        value[n] = '\0';
+
+    return true;
+}
+
+boolean_t parse_uint(const char *str, uint32_t *value, const char **end)
+{
+    uint32_t base = 10;
+    uint32_t result = 0;
+    const char *p = str;
+
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        base = 16;
+        p += 2;
+    }
+
+    if (!isxdigit(*p))
+        return false;
+
+    for (; *p; p++) {
+        uint32_t digit;
+
+        if (isdigit(*p))
+            digit = *p - '0';
+        else if (base == 16 && isxdigit(*p))
+            digit = (tolower(*p) - 'a') + 10;
+        else
+            break;
+
+        result = result * base + digit;
+    }
+
+    if (p == str)
+        return false;
+
+    *value = result;
+    if (end)
+        *end = p;
+    return true;
+}
+
+uint32_t cmdline_get_uint(const char *key, uint32_t fallback)
+{
+    char buf[16];
+    uint32_t value;
+
+    if (!cmdline_get(key, buf, sizeof(buf)) || !parse_uint(buf, &value, NULL))
+        return fallback;
+
+    return value;
+}
+
+/*
+ * Check whether `item` appears in a comma separated `list`.
+ */
+boolean_t cmdline_list_has(const char *list, const char *item)
+{
+    size_t item_len = strlen(item);
+    const char *p = list;
+
+    while (*p) {
+        if (!strncmp(p, item, item_len) && (p[item_len] == ',' || p[item_len] == '\0'))
+            return true;
+
+        while (*p && *p != ',')
+            p++;
+        if (*p == ',')
+            p++;
+    }
+
+    return false;
+}
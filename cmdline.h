@@ -0,0 +1,14 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for boot command line parsing.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+/* Functions */
+extern boolean_t cmdline_get(const char *key, char *value, size_t value_len);
+extern boolean_t cmdline_has(const char *key);
+extern uint32_t cmdline_get_uint(const char *key, uint32_t fallback);
+extern boolean_t cmdline_list_has(const char *list, const char *item);
+extern boolean_t parse_uint(const char *str, uint32_t *value, const char **end);
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Console backend selection and output fan-out.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+
+// The framebuffer is always available and enabled by default, so that
+// output keeps working before (and without) a console= argument.
+static cons_backend_t backends[] = {
+    { "fb",         NULL,           cons_print_char,    true },
+    { "debugcon",   debugcon_init,  debugcon_putc,      false },
+    { "serial",     serial_init,    serial_putc,        false },
+};
+
+#define NUM_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+void cons_putc(void *p, char c)
+{
+    for (uint32_t i = 0; i < NUM_BACKENDS; i++) {
+        if (backends[i].enabled)
+            backends[i].putc(p, c);
+    }
+}
+
+/*
+ * Pick the backends from `console=<name>[,<name>...]` on the boot command
+ * line, e.g. `console=debugcon` to skip framebuffer rendering entirely.
+ */
+void cons_select_backends(void)
+{
+    char list[64];
+
+    if (!cmdline_get("console", list, sizeof(list)) || !list[0])
+        return;
+
+    for (uint32_t i = 0; i < NUM_BACKENDS; i++) {
+        boolean_t wanted = cmdline_list_has(list, backends[i].name);
+
+        if (wanted && !backends[i].enabled && backends[i].init)
+            wanted = backends[i].init();
+
+        backends[i].enabled = wanted;
+    }
+}
@@ -43,12 +43,70 @@ typedef struct _console_priv_t
 
 #define PRINT_BUFFER_SIZE 1024
 
+/*
+ * Convert a 0xRRGGBBAA color to the framebuffer's native pixel value,
+ * dropping the low bits of channels narrower than 8 bits.
+ *
+ * Every framebuffer we have seen on the Apple TV is 32bpp XRGB8888. The
+ * release build bakes that in so the pixel conversion folds to constants.
+ */
+#ifdef CONFIG_FB_XRGB8888
+#define FB_DEPTH            32
+#define FB_RED_SHIFT        16
+#define FB_GREEN_SHIFT      8
+#define FB_BLUE_SHIFT       0
+#define FB_RESERVED_SHIFT   24
+
+#define FB_BYTES_PER_PIXEL(fb)  (FB_DEPTH >> 3)
+
 #define RGBA_TO_NATIVE(fb, color) \
-    (((color >> 24) & 0xFF) << fb.red_shift) | \
-    (((color >> 16) & 0xFF) << fb.green_shift) | \
-    (((color >> 8) & 0xFF) << fb.blue_shift) | \
-    (((color) & 0xFF) << fb.reserved_shift)
+    ((((color >> 24) & 0xFF) << FB_RED_SHIFT) | \
+    (((color >> 16) & 0xFF) << FB_GREEN_SHIFT) | \
+    (((color >> 8) & 0xFF) << FB_BLUE_SHIFT) | \
+    (((color) & 0xFF) << FB_RESERVED_SHIFT))
+#else
+#define FB_BYTES_PER_PIXEL(fb)  ((fb).depth >> 3)
+
+#define RGBA_CHANNEL(fb, color, pos, ch) \
+    (((((color) >> (pos)) & 0xFF) >> (8 - fb.ch##_size)) << fb.ch##_shift)
+
+#define RGBA_TO_NATIVE(fb, color) \
+    (RGBA_CHANNEL(fb, color, 24, red) | \
+    RGBA_CHANNEL(fb, color, 16, green) | \
+    RGBA_CHANNEL(fb, color, 8, blue) | \
+    RGBA_CHANNEL(fb, color, 0, reserved))
+#endif
+
+/*
+ * Console backends. Every character printed through printf is fanned out to
+ * each enabled backend; `init` is called once when the backend is selected.
+ */
+typedef struct _cons_backend_t
+{
+    const char  *name;
+    boolean_t   (*init)(void);
+    void        (*putc)(void *p, char c);
+    boolean_t   enabled;
+} cons_backend_t;
+
+#define DEBUGCON_PORT       0xE9
+
+#define SERIAL_DEFAULT_PORT 0x3F8
+#define SERIAL_DEFAULT_BAUD 115200
 
 /* Functions */
 extern boolean_t cons_init(void *video_params, uint32_t fg_color, uint32_t bg_color);
-extern void cons_clear_screen(uint32_t color);
\ No newline at end of file
+extern void cons_clear_screen(uint32_t color);
+extern void cons_print_char(void *p, char c);
+extern void video_print_char(char c, uint32_t x, uint32_t y, uint32_t fg_color, uint32_t bg_color);
+extern void video_move_cells(uint32_t dst_row, uint32_t src_row, uint32_t col, uint32_t cols, uint32_t rows);
+extern void video_fill_cells(uint32_t col, uint32_t row, uint32_t cols, uint32_t rows, uint32_t color);
+extern boolean_t video_grid_fits(uint32_t cols, uint32_t rows);
+
+extern void cons_putc(void *p, char c);
+extern void cons_select_backends(void);
+
+extern boolean_t debugcon_init(void);
+extern void debugcon_putc(void *p, char c);
+extern boolean_t serial_init(void);
+extern void serial_putc(void *p, char c);
\ No newline at end of file
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Inline helpers for x86 port I/O, MSRs and control registers.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#define CPUID_FEATURE_MTRR      (1 << 12)   /* CPUID.1:EDX */
+
+#define CR0_NW                  (1 << 29)
+#define CR0_CD                  (1 << 30)
+
+#define EFLAGS_IF               (1 << 9)
+
+static inline void
+outb(int port, uint8_t data)
+{
+    asm volatile("outb %0,%w1" : : "a" (data), "d" (port));
+}
+
+static inline uint8_t
+inb(int port)
+{
+    uint8_t data;
+    asm volatile("inb %w1,%0" : "=a" (data) : "d" (port));
+    return data;
+}
+
+static inline void
+outw(int port, uint16_t data)
+{
+    asm volatile("outw %0,%w1" : : "a" (data), "d" (port));
+}
+
+static inline uint16_t
+inw(int port)
+{
+    uint16_t data;
+    asm volatile("inw %w1,%0" : "=a" (data) : "d" (port));
+    return data;
+}
+
+static inline void
+outl(int port, uint32_t data)
+{
+    asm volatile("outl %0,%w1" : : "a" (data), "d" (port));
+}
+
+static inline uint32_t
+inl(int port)
+{
+    uint32_t data;
+    asm volatile("inl %w1,%0" : "=a" (data) : "d" (port));
+    return data;
+}
+
+static inline uint64_t
+rdmsr(uint32_t msr)
+{
+    uint64_t val;
+    asm volatile("rdmsr" : "=A" (val) : "c" (msr));
+    return val;
+}
+
+static inline void
+wrmsr(uint32_t msr, uint64_t val)
+{
+    asm volatile("wrmsr" : : "c" (msr), "A" (val) : "memory");
+}
+
+static inline void
+cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+    asm volatile("cpuid"
+                 : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+                 : "a" (leaf), "c" (0));
+}
+
+static inline uint64_t
+rdtsc(void)
+{
+    uint64_t val;
+    asm volatile("rdtsc" : "=A" (val));
+    return val;
+}
+
+static inline uint32_t
+read_cr0(void)
+{
+    uint32_t val;
+    asm volatile("mov %%cr0, %0" : "=r" (val));
+    return val;
+}
+
+static inline void
+write_cr0(uint32_t val)
+{
+    asm volatile("mov %0, %%cr0" : : "r" (val) : "memory");
+}
+
+static inline void
+wbinvd(void)
+{
+    asm volatile("wbinvd" : : : "memory");
+}
+
+/* Word sized push/pop, so the host tests can build code that uses these */
+static inline uint32_t
+save_flags_cli(void)
+{
+    unsigned long flags;
+    asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+    return flags;
+}
+
+static inline void
+restore_flags(uint32_t flags)
+{
+    unsigned long value = flags;
+    asm volatile("push %0; popf" : : "r" (value) : "memory", "cc");
+}
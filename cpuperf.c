@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Run the CPU at its highest Enhanced SpeedStep operating point.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "cpu.h"
+#include "cpuperf.h"
+
+static uint64_t msr_read(uint32_t msr)
+{
+    return rdmsr(msr);
+}
+
+static void msr_write(uint32_t msr, uint64_t value)
+{
+    wrmsr(msr, value);
+}
+
+static const cpuperf_msr_ops_t hw_msr_ops =
+{
+    .read   = msr_read,
+    .write  = msr_write,
+};
+
+static const cpuperf_msr_ops_t *msr_ops = &hw_msr_ops;
+
+/* Result of the last cpuperf_measure_mhz */
+static uint32_t last_mhz;
+
+void cpuperf_set_msr_ops(const cpuperf_msr_ops_t *ops)
+{
+    msr_ops = ops ? ops : &hw_msr_ops;
+}
+
+/*
+ * Switch to the highest ratio/VID pair IA32_PERF_STATUS advertises.
+ * Enables Enhanced SpeedStep first if the firmware left it off and did not
+ * lock it. Returns 0 once the status register reports the new pair.
+ */
+int cpuperf_set_max(cpuperf_state_t *before, cpuperf_state_t *after)
+{
+    uint64_t status, misc;
+    uint32_t max;
+
+    status = msr_ops->read(MSR_IA32_PERF_STATUS);
+    before->ratio = PERF_RATIO(status);
+    before->vid = PERF_VID(status);
+
+    max = PERF_STATUS_MAX(status);
+    after->ratio = PERF_RATIO(max);
+    after->vid = PERF_VID(max);
+
+    if (after->ratio == 0)
+        return -1;
+
+    misc = msr_ops->read(MSR_IA32_MISC_ENABLE);
+    if (!(misc & MISC_ENABLE_EIST)) {
+        if (misc & MISC_ENABLE_EIST_LOCK)
+            return -1;
+        msr_ops->write(MSR_IA32_MISC_ENABLE, misc | MISC_ENABLE_EIST);
+    }
+
+    if (before->ratio == after->ratio && before->vid == after->vid)
+        return 0;
+
+    // Only the low half of IA32_PERF_CTL is ours to change.
+    msr_ops->write(MSR_IA32_PERF_CTL,
+                   (msr_ops->read(MSR_IA32_PERF_CTL) & ~0xFFFFULL) | PERF_VALUE(after->ratio, after->vid));
+
+    for (uint32_t i = 0; i < CPUPERF_TRANSITION_POLLS; i++) {
+        status = msr_ops->read(MSR_IA32_PERF_STATUS);
+        if (PERF_RATIO(status) == after->ratio && PERF_VID(status) == after->vid)
+            return 0;
+    }
+
+    return -1;
+}
+
+/*
+ * Count TSC ticks over a CPUPERF_CALIBRATE_MS one-shot of PIT channel 2.
+ * The Pentium M TSC runs at the core clock, so this is the actual speed.
+ * Returns 0 if OUT2 does not go high within CPUPERF_PIT_POLLS reads.
+ */
+uint32_t cpuperf_measure_mhz(void)
+{
+    uint32_t latch = PIT_HZ / (1000 / CPUPERF_CALIBRATE_MS);
+    uint32_t flags, polls;
+    uint8_t gate;
+    uint64_t start, end;
+
+    flags = save_flags_cli();
+
+    gate = inb(PIT_GATE_PORT);
+    outb(PIT_GATE_PORT, (gate & ~PIT_GATE_SPEAKER) & ~PIT_GATE_CH2);
+
+    // Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+    outb(PIT_CMD_PORT, 0xB0);
+    outb(PIT_CH2_PORT, (uint8_t)latch);
+    outb(PIT_CH2_PORT, (uint8_t)(latch >> 8));
+
+    outb(PIT_GATE_PORT, (gate & ~PIT_GATE_SPEAKER) | PIT_GATE_CH2);
+    start = rdtsc();
+    for (polls = 0; polls < CPUPERF_PIT_POLLS; polls++) {
+        if (inb(PIT_GATE_PORT) & PIT_GATE_OUT2)
+            break;
+    }
+    end = rdtsc();
+
+    outb(PIT_GATE_PORT, gate);
+    restore_flags(flags);
+
+    // No PIT (or a gate that never fires): the speed is unknown.
+    if (polls == CPUPERF_PIT_POLLS)
+        return 0;
+
+    last_mhz = (uint32_t)(end - start) / (CPUPERF_CALIBRATE_MS * 1000);
+    return last_mhz;
+}
+
+/* The last measurement, so reports do not have to wait for the PIT again */
+uint32_t cpuperf_current_mhz(void)
+{
+    return last_mhz ? last_mhz : cpuperf_measure_mhz();
+}
+
+/*
+ * Legacy OSes have no P-state driver, so whatever we leave behind is what
+ * they run at. cpuperf=off keeps the firmware's choice.
+ */
+void cpuperf_init(void)
+{
+    char value[8];
+    uint32_t eax, ebx, ecx, edx;
+    cpuperf_state_t before, after;
+    uint32_t mhz_before, mhz_after;
+
+    if (cmdline_get("cpuperf", value, sizeof(value)) && !strcmp(value, "off"))
+        return;
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(ecx & CPUID_FEATURE_EST)) {
+        printf("CPUPERF: Enhanced SpeedStep not supported\n");
+        return;
+    }
+
+    mhz_before = cpuperf_measure_mhz();
+    if (cpuperf_set_max(&before, &after) != 0) {
+        printf("CPUPERF: cannot switch to ratio %d VID %x (now ratio %d VID %x)\n",
+               after.ratio, after.vid, before.ratio, before.vid);
+        return;
+    }
+    mhz_after = cpuperf_measure_mhz();
+
+    printf("CPUPERF: ratio %d VID %x, %d MHz -> ratio %d VID %x, %d MHz\n",
+           before.ratio, before.vid, mhz_before, after.ratio, after.vid, mhz_after);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for Enhanced SpeedStep P-state selection.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#define CPUID_FEATURE_EST       (1 << 7)    /* CPUID.1:ECX */
+
+#define MSR_IA32_PERF_STATUS    0x198
+#define MSR_IA32_PERF_CTL       0x199
+#define MSR_IA32_MISC_ENABLE    0x1A0
+
+#define MISC_ENABLE_EIST        (1 << 16)
+#define MISC_ENABLE_EIST_LOCK   (1 << 20)
+
+/* IA32_PERF_STATUS/IA32_PERF_CTL: bus ratio in 15:8, VID in 7:0 */
+#define PERF_RATIO(v)           (((uint32_t)(v) >> 8) & 0x1F)
+#define PERF_VID(v)             ((uint32_t)(v) & 0x3F)
+#define PERF_VALUE(ratio, vid)  (((ratio) << 8) | (vid))
+/* Highest supported operating point, in the upper half of IA32_PERF_STATUS */
+#define PERF_STATUS_MAX(v)      ((uint32_t)((v) >> 32) & 0x1FFF)
+
+/* Polls of IA32_PERF_STATUS before a transition is considered stuck */
+#define CPUPERF_TRANSITION_POLLS    100000
+
+/* PIT channel 2 gate used for TSC calibration */
+#define PIT_HZ                  1193182
+#define PIT_CH2_PORT            0x42
+#define PIT_CMD_PORT            0x43
+#define PIT_GATE_PORT           0x61
+#define PIT_GATE_CH2            (1 << 0)
+#define PIT_GATE_SPEAKER        (1 << 1)
+#define PIT_GATE_OUT2           (1 << 5)
+#define CPUPERF_CALIBRATE_MS    10
+/* A port 0x61 read takes about 1 us, so give up on OUT2 after about a second */
+#define CPUPERF_PIT_POLLS       1000000
+
+/*
+ * MSR access goes through these so the P-state logic can run against a
+ * simulated CPU.
+ */
+typedef struct _cpuperf_msr_ops_t
+{
+    uint64_t    (*read)(uint32_t msr);
+    void        (*write)(uint32_t msr, uint64_t value);
+} cpuperf_msr_ops_t;
+
+typedef struct _cpuperf_state_t
+{
+    uint32_t    ratio;
+    uint32_t    vid;
+} cpuperf_state_t;
+
+/* Functions */
+extern void cpuperf_set_msr_ops(const cpuperf_msr_ops_t *ops);
+extern int cpuperf_set_max(cpuperf_state_t *before, cpuperf_state_t *after);
+extern uint32_t cpuperf_measure_mhz(void);
+extern uint32_t cpuperf_current_mhz(void);
+extern void cpuperf_init(void);
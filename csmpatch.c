@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Verify and apply load-time patches to the embedded CSM16 image.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "csmpatch.h"
+
+/*
+ * SeaBIOS reads its boot time settings with romfile_loadint(name, default),
+ * called as `mov edx, default; xor ecx, ecx; mov eax, name`. With no
+ * fw_cfg or CBFS behind the CSM, the defaults are what it uses, so the
+ * patches change the immediate in edx.
+ */
+#define LOADINT(def, name) \
+    0xBA, (uint8_t)(def), (uint8_t)((def) >> 8), (uint8_t)((def) >> 16), (uint8_t)((def) >> 24), \
+    0x31, 0xC9, 0xB8, (uint8_t)(name), (uint8_t)((name) >> 8), (uint8_t)((name) >> 16), (uint8_t)((name) >> 24)
+
+#define ROMFILE(off)        (CSMPATCH_ROM_BASE + (off))
+
+static const csmpatch_t patches[] =
+{
+    {
+        "no-bootmenu", "do not offer the boot menu",
+        0x8181, 12,
+        { LOADINT(1, ROMFILE(0x129BC)) },
+        { LOADINT(0, ROMFILE(0x129BC)) },
+        "etc/show-boot-menu", 0x129BC,
+    },
+    {
+        "no-menuwait", "offer the boot menu without waiting for ESC",
+        0x81C8, 12,
+        { LOADINT(2500, ROMFILE(0x12A00)) },
+        { LOADINT(0, ROMFILE(0x12A00)) },
+        "etc/boot-menu-wait", 0x12A00,
+    },
+    {
+        "usb-attach", "give up on empty USB ports after 10 ms instead of 100 ms",
+        0xB113, 12,
+        { LOADINT(100, ROMFILE(0x136DA)) },
+        { LOADINT(10, ROMFILE(0x136DA)) },
+        "etc/usb-time-sigatt", 0x136DA,
+    },
+};
+
+#define NUM_PATCHES (sizeof(patches) / sizeof(patches[0]))
+
+/* Patches that were asked for and whose signature matched */
+static boolean_t verified[NUM_PATCHES];
+
+static boolean_t csmpatch_verify(const csmpatch_t *patch, const uint8_t *rom, uint32_t rom_size)
+{
+    uint32_t len = strlen(patch->romfile) + 1;
+
+    if (patch->offset + patch->size > rom_size || patch->romfile_offset + len > rom_size)
+        return false;
+
+    return !memcmp(rom + patch->offset, patch->match, patch->size) &&
+           !memcmp(rom + patch->romfile_offset, patch->romfile, len);
+}
+
+/*
+ * Check the patches listed in `csmpatch=<name>[,<name>...]` (or `all`)
+ * against the image we carry and report each one. Nothing is changed yet;
+ * csmpatch_apply patches the copy in the ROM window.
+ */
+int csmpatch_init(struct csmwrap_priv *priv)
+{
+    uint32_t rom_size = BIOSROM_END - priv->csm_bin_base;
+    char list[96];
+    int count = 0;
+
+    memset(verified, 0, sizeof(verified));
+
+    if (!cmdline_get("csmpatch", list, sizeof(list)) || !list[0])
+        return 0;
+
+    if (priv->csm_bin_base != CSMPATCH_ROM_BASE) {
+        printf("CSMPATCH: image loads at %x, patches are for %x\n",
+               (uint32_t)priv->csm_bin_base, CSMPATCH_ROM_BASE);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < NUM_PATCHES; i++) {
+        const csmpatch_t *patch = &patches[i];
+
+        if (!cmdline_list_has(list, "all") && !cmdline_list_has(list, patch->name))
+            continue;
+
+        if (!csmpatch_verify(patch, priv->csm_bin, rom_size)) {
+            printf("CSMPATCH: %s: signature mismatch, skipped\n", patch->name);
+            continue;
+        }
+
+        verified[i] = true;
+        count++;
+        printf("CSMPATCH: %s: %s\n", patch->name, patch->description);
+    }
+
+    printf("CSMPATCH: %d patches to apply\n", count);
+    return count;
+}
+
+/* Called right after the image is copied into place, on every boot */
+void csmpatch_apply(struct csmwrap_priv *priv)
+{
+    uint8_t *rom = (uint8_t *)priv->csm_bin_base;
+
+    for (uint32_t i = 0; i < NUM_PATCHES; i++) {
+        if (verified[i])
+            memcpy(rom + patches[i].offset, patches[i].replace, patches[i].size);
+    }
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the load-time patches to the embedded CSM16 image.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#define CSMPATCH_MAX_BYTES      16
+#define CSMPATCH_MAX_NAME       24
+
+/* Where the image expects to run, so its code refers to absolute addresses */
+#define CSMPATCH_ROM_BASE       0xE0000
+
+/*
+ * One patch: `match` is the signature, the bytes expected at `offset` in
+ * the image, and `replace` what goes there instead. `romfile` is the name
+ * the patched code loads, which must be found at `romfile_offset` as well;
+ * the signature refers to it by address, so both have to agree.
+ */
+typedef struct _csmpatch_t
+{
+    const char  *name;
+    const char  *description;
+    uint32_t    offset;
+    uint32_t    size;
+    uint8_t     match[CSMPATCH_MAX_BYTES];
+    uint8_t     replace[CSMPATCH_MAX_BYTES];
+    const char  *romfile;
+    uint32_t    romfile_offset;
+} csmpatch_t;
+
+/* Functions */
+extern int csmpatch_init(struct csmwrap_priv *priv);
+extern void csmpatch_apply(struct csmwrap_priv *priv);
@@ -6,6 +6,23 @@
 */
 
 #include "csmwrapple.h"
+#include "capture.h"
+#include "cmdline.h"
+#include "cpu.h"
+#include "cpuperf.h"
+#include "csmpatch.h"
+#include "fastint10.h"
+#include "int13cache.h"
+#include "lowmem.h"
+#include "membench.h"
+#include "mtrr.h"
+#include "pci.h"
+#include "pmc.h"
+#include "profile.h"
+#include "rthunk.h"
+#include "timing.h"
+#include "trace.h"
+#include "warmboot.h"
 #include "edk2/LegacyBios.h"
 
 // Generated by: xxd -i Csm16.bin >> Csm16.h
@@ -22,12 +39,6 @@ struct csmwrap_priv priv = {
 
 mach_boot_args_t *gBA;
 
-static inline void
-outb(int port, uint8_t data)
-{
-    asm volatile("outb %0,%w1" : : "a" (data), "d" (port));
-}
-
 static
 int test_bios_region_rw()
 {
@@ -40,14 +51,14 @@ int test_bios_region_rw()
         backup = *ptr;
         *ptr = 0xdeadbeef;
         if (*ptr != 0xdeadbeef) {
-            printf("Unable to write to BIOS region\n");
+            log_err("Unable to write to BIOS region\n");
             return -1;
         }
         *ptr = backup;
         ptr++;
     }
 
-    printf("Success\n");
+    log_debug("Success\n");
 
     return 0;
 }
@@ -71,47 +82,30 @@ static void *find_table(uint32_t signature, uint8_t *csm_bin_base, size_t size)
     return Table;
 }
 
-static int set_smbios_table()
+/*
+ * Pick the display controller whose option ROM the VGA BIOS stands in for.
+ * Prefer a VGA compatible controller, then any display controller.
+ */
+static void find_vga_device(void)
 {
-    int i;
-    efi_guid_t smbiosGuid = SMBIOS_TABLE_GUID;
-    efi_guid_t smbios3Guid = SMBIOS3_TABLE_GUID;
-    boolean_t found = false;
-    uintptr_t table_addr = 0;
-
-    efi_system_table_t *sys_tbl = (efi_system_table_t *) gBA->efi_sys_tbl;
-
-    for (i = 0; i < sys_tbl->NumberOfTableEntries; i++) {
-        efi_configuration_table_t *table;
-        table = sys_tbl->ConfigurationTable + i;
-
-        if (!efi_guidcmp(table->VendorGuid, smbiosGuid)) {
-            printf("Found SMBIOS Table at %lx\n", (uintptr_t)table->VendorTable);
-            table_addr = (uintptr_t)table->VendorTable;
-            found = true;
-            break;
-        }
-
-        if (!efi_guidcmp(table->VendorGuid, smbios3Guid)) {
-            printf("Found SMBIOS 3.0 Table at %lx\n", (uintptr_t)table->VendorTable);
-            table_addr = (uintptr_t)table->VendorTable;
-            found = true;
-            break;
-        }
+    struct pci_device *dev;
+
+    dev = pci_find_class(PCI_CLASS_DISPLAY, PCI_SUBCLASS_DISPLAY_VGA, NULL);
+    if (dev == NULL)
+        dev = pci_find_class(PCI_CLASS_DISPLAY, 0xFF, NULL);
+
+    if (dev == NULL) {
+        /* NVIDIA card at 01:00.0 */
+        log_warn("No display controller found, assuming 01:00.0\n");
+        priv.vga_pci_bus = 0x01;
+        priv.vga_pci_devfn = PCI_DEVFN(0x00, 0x0);
+        return;
     }
 
-    if (found) {
-        if (table_addr > 0xffffffff) {
-            printf("SMBIOS table address too high\n");
-            return -1;
-        }
-        priv.low_stub->boot_table.SmbiosTable = table_addr;
-        return 0;
-    }
-
-    printf("No SMBIOS table found\n");
-
-    return -1;
+    log_info("Display controller %04x:%04x at %02x:%02x.%x\n", dev->vendor_id, dev->device_id,
+           dev->bus, PCI_SLOT(dev->devfn), PCI_FUNC(dev->devfn));
+    priv.vga_pci_bus = dev->bus;
+    priv.vga_pci_devfn = dev->devfn;
 }
 
 static uintptr_t find_HiPmm(void)
@@ -134,143 +128,244 @@ static uintptr_t find_HiPmm(void)
     return HiPmm;
 }
 
+/*
+ * Copy the ROMs into place and run the Legacy16 sequence up to and
+ * including Legacy16Boot. The low stub and the thunk must be ready. This is
+ * shared by the first boot and by the warm reboot path.
+ */
+noreturn void legacy16_boot(struct csmwrap_priv *priv)
+{
+    EFI_IA32_REGISTER_SET Regs;
+
+    /* Disable external interrupts */
+    asm volatile ("cli");
+
+    /* Disable 8259 PIC */
+    outb(0x21, 0xff);
+    outb(0xa1, 0xff);
+    outb(0x43, 0x36);
+    /* Program PIT to default */
+    outb(0x40, 0x00);
+    outb(0x40, 0x00);
+
+    /* Copy ROM to location, as late as possible */
+    memcpy((void*)priv->csm_bin_base, Csm16_bin, sizeof(Csm16_bin));
+    csmpatch_apply(priv);
+    memcpy((void*)VGABIOS_START, vgabios_bin, sizeof(vgabios_bin));
+    timing_mark("rom copy");
+
+    memset(&Regs, 0, sizeof(EFI_IA32_REGISTER_SET));
+    Regs.X.AX = Legacy16InitializeYourself;
+    Regs.X.ES = EFI_SEGMENT(&priv->low_stub->init_table);
+    Regs.X.BX = EFI_OFFSET(&priv->low_stub->init_table);
+
+    LegacyBiosFarCall86(priv->csm_efi_table->Compatibility16CallSegment,
+                        priv->csm_efi_table->Compatibility16CallOffset,
+                        &Regs,
+                        NULL,
+                        0);
+    timing_mark("Legacy16InitializeYourself");
+
+    // The CSM can hand out F segment space now.
+    if (lowmem.fseg_tables)
+        lowmem_move_tables(priv);
+
+    memset(&Regs, 0, sizeof(EFI_IA32_REGISTER_SET));
+    Regs.X.AX = Legacy16DispatchOprom;
+    Regs.X.ES = EFI_SEGMENT(&priv->low_stub->vga_oprom_table);
+    Regs.X.BX = EFI_OFFSET(&priv->low_stub->vga_oprom_table);
+    LegacyBiosFarCall86(priv->csm_efi_table->Compatibility16CallSegment,
+                        priv->csm_efi_table->Compatibility16CallOffset,
+                        &Regs,
+                        NULL,
+                        0);
+    timing_mark("Legacy16DispatchOprom");
+
+    memset(&Regs, 0, sizeof(EFI_IA32_REGISTER_SET));
+    Regs.X.AX = Legacy16UpdateBbs;
+    Regs.X.ES = EFI_SEGMENT(&priv->low_stub->boot_table);
+    Regs.X.BX = EFI_OFFSET(&priv->low_stub->boot_table);
+
+    LegacyBiosFarCall86(priv->csm_efi_table->Compatibility16CallSegment,
+                        priv->csm_efi_table->Compatibility16CallOffset,
+                        &Regs,
+                        NULL,
+                        0);
+    if (Regs.X.AX != 0)
+        log_warn("Legacy16UpdateBbs returned %x\n", Regs.X.AX);
+    timing_mark("Legacy16UpdateBbs");
+
+    memset(&Regs, 0, sizeof(EFI_IA32_REGISTER_SET));
+    Regs.X.AX = Legacy16PrepareToBoot;
+    Regs.X.ES = EFI_SEGMENT(&priv->low_stub->boot_table);
+    Regs.X.BX = EFI_OFFSET(&priv->low_stub->boot_table);
+
+    LegacyBiosFarCall86(priv->csm_efi_table->Compatibility16CallSegment,
+                        priv->csm_efi_table->Compatibility16CallOffset,
+                        &Regs,
+                        NULL,
+                        0);
+    timing_mark("Legacy16PrepareToBoot");
+
+    memset(&Regs, 0, sizeof(EFI_IA32_REGISTER_SET));
+    Regs.X.AX = Legacy16Boot;
+    // No arguments?
+
+    // Hook reboots only now; Legacy16Boot goes through INT 19h itself.
+    warmboot_install(priv);
+    rthunk_reset();
+    fastint10_install(priv);
+    int13cache_install(priv);
+    trace_install(priv);
+    profile_install(priv);
+
+    timing_report();
+
+    LegacyBiosFarCall86(priv->csm_efi_table->Compatibility16CallSegment,
+                        priv->csm_efi_table->Compatibility16CallOffset,
+                        &Regs,
+                        NULL,
+                        0);
+
+    while (1);
+}
+
 noreturn void csmwrapple_init(mach_boot_args_t *ba)
 {
     uintptr_t HiPmm;
     uintptr_t csm_bin_base;
-    EFI_IA32_REGISTER_SET Regs;
 
     gBA = ba;
 
-    cons_init(&ba->video, 0xFFFFFFFF, 0x00000000);
+    pmc_init();
+    timing_init();
+
+    boolean_t have_fb = cons_init(&ba->video, 0xFFFFFFFF, 0x00000000);
+    cons_select_backends();
+    if (!have_fb)
+        log_warn("Cannot draw on the %dbpp framebuffer, no console output there\n", ba->video.depth);
 
     boolean_t verbose = (ba->video.display_mode == DISPLAY_MODE_TEXT);
     if (verbose)
         cons_clear_screen(0x00000000);
 
     printf("CSMWrapple for Apple TV 1st Gen initializing...\n");
+    timing_mark("console");
+
+    // Leave the CPU at full speed for everything that follows.
+    cpuperf_init();
+    timing_mark("cpuperf");
+
+    // Record the firmware handoff before we look at any of it.
+    if (cmdline_has("capture"))
+        capture_dump();
 
     csm_bin_base = (uintptr_t)BIOSROM_END - sizeof(Csm16_bin);
     priv.csm_bin_base = csm_bin_base;
-    printf("csm_bin_base: 0x%lx\n", csm_bin_base);
+    log_debug("csm_bin_base: 0x%lx\n", csm_bin_base);
     if (csm_bin_base < VGABIOS_END) {
-        printf("Illegal csm_bin size \n");
+        log_err("Illegal csm_bin size \n");
         goto hang;
     }
 
     priv.csm_efi_table = find_table(EFI_COMPATIBILITY16_TABLE_SIGNATURE, Csm16_bin, sizeof(Csm16_bin));
     if (priv.csm_efi_table == NULL) {
-        printf("EFI_COMPATIBILITY16_TABLE not found\n");
+        log_err("EFI_COMPATIBILITY16_TABLE not found\n");
         goto hang;
     }
 
+    csmpatch_init(&priv);
+
     priv.vga_table = find_table(CSM_VGA_TABLE_SIGNATURE, vgabios_bin, sizeof(vgabios_bin));
     if (priv.vga_table == NULL) {
-        printf("VGA Table not found\n");
+        log_err("VGA Table not found\n");
         goto hang;
     }
 
     // Set up ACPI
     copy_rsdt(&priv);
+
+    // Enumerate PCI once; later stages query the cache.
+    pci_ecam_init();
+    pci_scan();
+    pci_dump();
+    if (cmdline_has("pcibench"))
+        pci_bench();
+    find_vga_device();
+    timing_mark("pci");
+
     // Set up video
     csmwrap_video_init(&priv);
+    timing_mark("video");
 
-    // Set up low stub.
+    // Set up low stub. It holds the E820 map, so the rest of the low
+    // memory layout is planned once the map is built.
     priv.low_stub = (struct low_stub *) LOW_STUB_BASE;
-    memset((void *) LOW_STUB_BASE, 0, CONVEN_END - LOW_STUB_BASE);
+    /*
+     * Only clear what is live. The thunk buffer is cleared when the thunk is
+     * installed, and LowPmm belongs to the CSM, whose allocations carry no
+     * defined contents; whoever allocates from it initializes it.
+     */
+    memset(priv.low_stub, 0, sizeof(struct low_stub));
+    timing_mark("low stub");
 
     // Set up SMBIOS
-    set_smbios_table();
+    set_smbios_table(&priv);
 
     // Build E820 map
     build_e820_map(&priv);
+    if (lowmem_plan(&priv) != 0)
+        goto hang;
+    lowmem_report();
+    warmboot_setup(&priv);
+    fastint10_setup(&priv);
+    timing_mark("e820");
 
     // Now we need to figure out the highest memory address.
     HiPmm = find_HiPmm();
-    printf("HiPmm = %lx\n", HiPmm);
+    log_debug("HiPmm = %lx\n", HiPmm);
+    int13cache_setup(&priv, HiPmm);
 
     uintptr_t e820_low = (uintptr_t)&priv.low_stub->e820_map;
     priv.csm_efi_table->E820Pointer = e820_low;
     priv.csm_efi_table->E820Length = sizeof(struct e820_entry) * priv.low_stub->e820_entries;
     priv.low_stub->boot_table.AcpiTable = priv.csm_efi_table->AcpiRsdPtrPointer;
 
-    uintptr_t pmm_base = LegacyBiosInitializeThunkAndTable(LOW_STUB_BASE, sizeof(struct low_stub));
-    pmm_base += LOW_STACK_SIZE;
+    // Describe the disks so the CSM does not have to discover them.
+    build_bbs_table(&priv);
 
-    printf("Init Thunk pmm: %lx\n", (uintptr_t)pmm_base);
+    LegacyBiosInitializeThunk(lowmem.thunk, LOWMEM_THUNK_SIZE);
+    timing_mark("thunk");
 
-    priv.low_stub->init_table.BiosLessThan1MB = 0x00080000; // Whole EBDA
-    priv.low_stub->init_table.ThunkStart = (uint32_t)(uintptr_t)priv.low_stub;
-    priv.low_stub->init_table.ThunkSizeInBytes = sizeof(struct low_stub);
-    priv.low_stub->init_table.LowPmmMemory = (uint32_t)pmm_base;
-    priv.low_stub->init_table.LowPmmMemorySizeInBytes = (uint32_t)CONVEN_END - (uint32_t)pmm_base;
+    priv.low_stub->init_table.BiosLessThan1MB = (uint32_t)lowmem.ebda;
+    priv.low_stub->init_table.ThunkStart = (uint32_t)lowmem.thunk;
+    priv.low_stub->init_table.ThunkSizeInBytes = LOWMEM_THUNK_SIZE;
+    priv.low_stub->init_table.LowPmmMemory = (uint32_t)lowmem.pmm;
+    priv.low_stub->init_table.LowPmmMemorySizeInBytes = lowmem.pmm_size;
     priv.low_stub->init_table.HiPmmMemorySizeInBytes = HIPMM_SIZE;
     priv.low_stub->init_table.HiPmmMemory = HiPmm;
 
     priv.low_stub->vga_oprom_table.OpromSegment = EFI_SEGMENT(VGABIOS_START);
-    /* NVIDIA card at 01:00.0 */
-    priv.low_stub->vga_oprom_table.PciBus = 0x01;
-    priv.low_stub->vga_oprom_table.PciDeviceFunction = (uint8_t)(0x00 << 3 | 0x0);
+    priv.low_stub->vga_oprom_table.PciBus = priv.vga_pci_bus;
+    priv.low_stub->vga_oprom_table.PciDeviceFunction = priv.vga_pci_devfn;
 
-    printf("CALL16 %x:%x\n", priv.csm_efi_table->Compatibility16CallSegment,
+    log_debug("CALL16 %x:%x\n", priv.csm_efi_table->Compatibility16CallSegment,
            priv.csm_efi_table->Compatibility16CallOffset);
 
-    /* Disable external interrupts */
-    asm volatile ("cli");
-
-    /* Disable 8259 PIC */
-    outb(0x21, 0xff);
-    outb(0xa1, 0xff);
-    outb(0x43, 0x36);
-    /* Program PIT to default */
-    outb(0x40, 0x00);
-    outb(0x40, 0x00);
-
-    /* Copy ROM to location, as late as possible */
-    memcpy((void*)csm_bin_base, Csm16_bin, sizeof(Csm16_bin));
-    memcpy((void*)VGABIOS_START, vgabios_bin, sizeof(vgabios_bin));
-
-    memset(&Regs, 0, sizeof(EFI_IA32_REGISTER_SET));
-    Regs.X.AX = Legacy16InitializeYourself;
-    Regs.X.ES = EFI_SEGMENT(&priv.low_stub->init_table);
-    Regs.X.BX = EFI_OFFSET(&priv.low_stub->init_table);
-
-    LegacyBiosFarCall86(priv.csm_efi_table->Compatibility16CallSegment,
-                        priv.csm_efi_table->Compatibility16CallOffset,
-                        &Regs,
-                        NULL,
-                        0);
-
-    memset(&Regs, 0, sizeof(EFI_IA32_REGISTER_SET));
-    Regs.X.AX = Legacy16DispatchOprom;
-    Regs.X.ES = EFI_SEGMENT(&priv.low_stub->vga_oprom_table);
-    Regs.X.BX = EFI_OFFSET(&priv.low_stub->vga_oprom_table);
-    LegacyBiosFarCall86(priv.csm_efi_table->Compatibility16CallSegment,
-                        priv.csm_efi_table->Compatibility16CallOffset,
-                        &Regs,
-                        NULL,
-                        0);
-
-    memset(&Regs, 0, sizeof(EFI_IA32_REGISTER_SET));
-    Regs.X.AX = Legacy16PrepareToBoot;
-    Regs.X.ES = EFI_SEGMENT(&priv.low_stub->boot_table);
-    Regs.X.BX = EFI_OFFSET(&priv.low_stub->boot_table);
-
-    LegacyBiosFarCall86(priv.csm_efi_table->Compatibility16CallSegment,
-                        priv.csm_efi_table->Compatibility16CallOffset,
-                        &Regs,
-                        NULL,
-                        0);
-
-    memset(&Regs, 0, sizeof(EFI_IA32_REGISTER_SET));
-    Regs.X.AX = Legacy16Boot;
-    // No arguments?
+    /* Make sure the legacy regions are cacheable before we run from them */
+    if (mtrr_init()) {
+        mtrr_dump();
+        if (cmdline_has("membench"))
+            membench_run(HiPmm);
+        if (mtrr_setup_legacy(MTRR_TYPE_UC) == 0) {
+            printf("MTRR: legacy regions reprogrammed\n");
+            mtrr_dump();
+        }
+    }
+    timing_mark("mtrr");
 
-    LegacyBiosFarCall86(priv.csm_efi_table->Compatibility16CallSegment,
-                        priv.csm_efi_table->Compatibility16CallOffset,
-                        &Regs,
-                        NULL,
-                        0);
+    warmboot_save(&priv);
+    legacy16_boot(&priv);
 
 hang:
     while (1);
@@ -12,6 +12,7 @@
 #include "baselibc_string.h"
 #include "boot_args.h"
 #include "tinyprintf.h"
+#include "log.h"
 #include "efi.h"
 #include "x86thunk.h"
 
@@ -42,7 +43,15 @@ extern int unlock_bios_region();
 extern int csmwrap_video_init(struct csmwrap_priv *priv);
 extern int csmwrap_video_fallback(struct csmwrap_priv *priv);
 extern int copy_rsdt(struct csmwrap_priv *priv);
+extern int set_smbios_table(struct csmwrap_priv *priv);
+extern void *acpi_find_table(uint32_t signature);
+typedef void (*acpi_visit_t)(const void *table, uint32_t length, void *ctx);
+extern void acpi_walk_tables(const void *rsdp, acpi_visit_t visit, void *ctx);
 int build_e820_map(struct csmwrap_priv *priv);
+int e820_reserve(struct csmwrap_priv *priv, uint64_t addr, uint64_t size);
+int e820_reserve_kernel(struct csmwrap_priv *priv);
+int build_bbs_table(struct csmwrap_priv *priv);
+extern noreturn void legacy16_boot(struct csmwrap_priv *priv);
 
 
 static inline int
@@ -60,13 +69,15 @@ struct e820_entry {
 #pragma pack()
 #define E820_MAX_ENTRIES 32
 
+/* Floppy + master/slave for every IDE channel, laid out like EDK2 */
+#define BBS_MAX_ENTRIES (1 + MAX_IDE_CONTROLLER * 2)
+
 #pragma pack(1)
 struct low_stub {
-    LOW_MEMORY_THUNK thunk;
-
     EFI_TO_COMPATIBILITY16_INIT_TABLE init_table;
     EFI_TO_COMPATIBILITY16_BOOT_TABLE boot_table;
     EFI_DISPATCH_OPROM_TABLE vga_oprom_table;
+    BBS_TABLE bbs_table[BBS_MAX_ENTRIES];
 
     /* E820 memory map */
     int e820_entries;
@@ -79,7 +90,7 @@ struct low_stub {
 #define CONVEN_START    0x00007E00
 /* We may have some stack here */
 #define LOW_STUB_BASE  0x00020000
-/* Thunk + PMM */
+/* Thunk + PMM, see lowmem.c for the actual layout */
 #define CONVEN_END      0x00080000
 #define EBDA_BASE       CONVEN_END
 #define VGABIOS_START   0x000C0000
@@ -1,102 +1,124 @@
 #include "csmwrapple.h"
+#include "e820.h"
 
 /* 
  * E820 memory map definitions
  * Based on the legacy BIOS E820 memory mapping interface
  */
 
-/* 
- * Convert UEFI memory types to E820 types 
- */
-static uint32_t convert_memory_type(efi_memory_type_t type)
-{
-    switch (type) {
-        case EfiACPIReclaimMemory:
-            return E820_ACPI;
-        case EfiRuntimeServicesCode:
-        case EfiRuntimeServicesData:
-        case EfiMemoryMappedIO:
-        case EfiMemoryMappedIOPortSpace:
-        case EfiPalCode:
-            return E820_RESERVED;
-        case EfiLoaderCode:
-        case EfiLoaderData:
-        case EfiBootServicesCode:
-        case EfiBootServicesData:
-        case EfiConventionalMemory:
-            return E820_RAM;
-        case EfiACPIMemoryNVS:
-            return E820_NVS;
-        case EfiUnusableMemory:
-            return E820_UNUSABLE;
-        case EfiReservedMemoryType:
-            return E820_RESERVED;
-        default:
-            printf("we should not get here\n");
-            return E820_RESERVED;
-    }
-}
-
 /*
  * Build E820 memory map based on UEFI GetMemoryMap
  * Return the number of entries in the E820 map
  */
 int build_e820_map(struct csmwrap_priv *priv)
 {
-    efi_memory_descriptor_t *memory_map = (efi_memory_descriptor_t *) gBA->efi_mem_map_ptr;
-    efi_memory_descriptor_t *memory_map_end = (efi_memory_descriptor_t *) gBA->efi_mem_map_ptr + gBA->efi_mem_map_size;
-    efi_memory_descriptor_t *memory_map_ptr;
-    struct e820_entry *e820_map;
-    uintn_t memory_map_size = gBA->efi_mem_map_size;
-    uintn_t descriptor_size = gBA->efi_mem_desc_size;
-    uint32_t e820_entries = 0;
-    
-    /* Initialize the E820 map in the low_stub */
-    e820_map = priv->low_stub->e820_map;
-    memory_map_end = (efi_memory_descriptor_t *)((uint8_t *)memory_map + memory_map_size);
-    
-    /* Process each memory descriptor and convert to E820 format */
-    for (memory_map_ptr = memory_map; 
-         memory_map_ptr < memory_map_end && e820_entries < E820_MAX_ENTRIES; 
-         memory_map_ptr = NextMemoryDescriptor(memory_map_ptr, descriptor_size)) {
-        
-        uint64_t start = memory_map_ptr->PhysicalStart;
-        uint64_t end = start + (memory_map_ptr->NumberOfPages * EFI_PAGE_SIZE);
-        uint32_t type = convert_memory_type(memory_map_ptr->Type);
-        
-        /* Skip zero-length regions */
-        if (start == end)
-            continue;
-        
-        /* Try to merge with previous entry if possible */
-        if (e820_entries > 0 && 
-            e820_map[e820_entries - 1].addr + e820_map[e820_entries - 1].size == start &&
-            e820_map[e820_entries - 1].type == type) {
-            /* Extend the previous entry */
-            e820_map[e820_entries - 1].size += (end - start);
-        } else {
-            /* Create a new entry */
-            e820_map[e820_entries].addr = start;
-            e820_map[e820_entries].size = end - start;
-            e820_map[e820_entries].type = type;
-            e820_entries++;
-        }
-    }
-    
+    static e820_point_t points[E820_MAX_POINTS];
+    e820_conv_t conv;
+    int problems;
+
+    conv.map = priv->low_stub->e820_map;
+    conv.max_entries = E820_MAX_ENTRIES;
+    conv.points = points;
+    conv.max_points = E820_MAX_POINTS;
+
+    e820_convert((void *)gBA->efi_mem_map_ptr, gBA->efi_mem_map_size, gBA->efi_mem_desc_size, &conv);
+
     /* Save the number of entries in the low_stub */
-    priv->low_stub->e820_entries = e820_entries;
+    priv->low_stub->e820_entries = conv.entries;
+
+    if (conv.truncated)
+        log_warn("E820: map truncated to %d entries, memory above %x is missing\n", conv.entries,
+               conv.entries ? (uint32_t)(conv.map[conv.entries - 1].addr + conv.map[conv.entries - 1].size) : 0);
+
+    problems = e820_check((void *)gBA->efi_mem_map_ptr, gBA->efi_mem_map_size, gBA->efi_mem_desc_size,
+                          conv.map, conv.entries);
+    if (problems && !conv.truncated)
+        log_warn("E820: %d problems in the converted map\n", problems);
 
 #if 0
-    printf("E820 memory map created with %d entries\n", e820_entries);
-    
+    printf("E820 memory map created with %d entries\n", conv.entries);
+
     /* Print the E820 map entries for debugging */
-    for (int i = 0; i < e820_entries; i++) {
+    for (int i = 0; i < conv.entries; i++) {
         printf("E820: [%x-%x] type %d\n",
-               (unsigned int) e820_map[i].addr,
-               (unsigned int) (e820_map[i].addr + e820_map[i].size - 1),
-               e820_map[i].type);
+               (unsigned int) conv.map[i].addr,
+               (unsigned int) (conv.map[i].addr + conv.map[i].size - 1),
+               conv.map[i].type);
     }
 #endif
-    
-    return e820_entries;
+
+    return conv.entries;
+}
+
+/*
+ * Mark [addr, addr + size) reserved, splitting the RAM entries it overlaps.
+ * The map is expected to be sorted, as build_e820_map produces it.
+ */
+int e820_reserve(struct csmwrap_priv *priv, uint64_t addr, uint64_t size)
+{
+    struct e820_entry *e820_map = priv->low_stub->e820_map;
+    uint64_t end = addr + size;
+
+    for (int i = 0; i < priv->low_stub->e820_entries; i++) {
+        struct e820_entry *entry = &e820_map[i];
+        uint64_t entry_end = entry->addr + entry->size;
+        uint64_t cut_start, cut_end;
+        int pieces;
+
+        if (entry->type != E820_RAM || entry_end <= addr || entry->addr >= end)
+            continue;
+
+        cut_start = entry->addr > addr ? entry->addr : addr;
+        cut_end = entry_end < end ? entry_end : end;
+
+        /* RAM below the cut, the cut itself, RAM above the cut */
+        pieces = 1 + (cut_start > entry->addr) + (cut_end < entry_end);
+        if (priv->low_stub->e820_entries + pieces - 1 > E820_MAX_ENTRIES) {
+            printf("E820: no room to reserve %x-%x\n", (uint32_t)addr, (uint32_t)(end - 1));
+            return -1;
+        }
+
+        memmove(&e820_map[i + pieces], &e820_map[i + 1],
+                (priv->low_stub->e820_entries - i - 1) * sizeof(struct e820_entry));
+        priv->low_stub->e820_entries += pieces - 1;
+
+        if (cut_start > entry->addr) {
+            e820_map[i].size = cut_start - entry->addr;
+            i++;
+        }
+
+        e820_map[i].addr = cut_start;
+        e820_map[i].size = cut_end - cut_start;
+        e820_map[i].type = E820_RESERVED;
+
+        if (cut_end < entry_end) {
+            i++;
+            e820_map[i].addr = cut_end;
+            e820_map[i].size = entry_end - cut_end;
+            e820_map[i].type = E820_RAM;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Keep the kernel image away from the OS. Needed by everything that runs
+ * our code after Legacy16Boot; safe to call more than once.
+ */
+int e820_reserve_kernel(struct csmwrap_priv *priv)
+{
+    static boolean_t reserved;
+    uint32_t size;
+
+    if (reserved)
+        return 0;
+
+    size = (gBA->kernel_size + EFI_PAGE_SIZE - 1) & ~(EFI_PAGE_SIZE - 1);
+    if (e820_reserve(priv, gBA->kernel_base, size) != 0)
+        return -1;
+
+    printf("E820: reserved kernel image %x-%x\n", gBA->kernel_base, gBA->kernel_base + size - 1);
+    reserved = true;
+    return 0;
 }
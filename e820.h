@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the EFI to E820 memory map conversion.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+/* Boundaries the conversion can track for the firmware's map */
+#define E820_MAX_POINTS         1024
+
+/* Start or end of one EFI descriptor, sorted by address during conversion */
+typedef struct _e820_point_t
+{
+    uint64_t    addr;
+    uint32_t    type;
+    int32_t     delta;      /* +1 at the start, -1 at the end */
+} e820_point_t;
+
+/* Output and scratch for e820_convert */
+typedef struct _e820_conv_t
+{
+    struct e820_entry   *map;
+    uint32_t            max_entries;
+    e820_point_t        *points;
+    uint32_t            max_points;
+
+    uint32_t            entries;
+    boolean_t           truncated;  /* Descriptors or entries did not fit */
+} e820_conv_t;
+
+/* Functions */
+extern int e820_convert(const void *efi_map, uint32_t map_size, uint32_t desc_size, e820_conv_t *conv);
+extern int e820_check(const void *efi_map, uint32_t map_size, uint32_t desc_size,
+                      const struct e820_entry *map, uint32_t entries);
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: EFI to E820 memory map conversion. Touches no hardware and no
+ *          globals, so it also builds on the host (see tests/test_e820.c).
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "e820.h"
+
+/* 
+ * Convert UEFI memory types to E820 types 
+ */
+static uint32_t convert_memory_type(efi_memory_type_t type)
+{
+    switch (type) {
+        case EfiACPIReclaimMemory:
+            return E820_ACPI;
+        case EfiRuntimeServicesCode:
+        case EfiRuntimeServicesData:
+        case EfiMemoryMappedIO:
+        case EfiMemoryMappedIOPortSpace:
+        case EfiPalCode:
+            return E820_RESERVED;
+        case EfiLoaderCode:
+        case EfiLoaderData:
+        case EfiBootServicesCode:
+        case EfiBootServicesData:
+        case EfiConventionalMemory:
+            return E820_RAM;
+        case EfiACPIMemoryNVS:
+            return E820_NVS;
+        case EfiUnusableMemory:
+            return E820_UNUSABLE;
+        case EfiReservedMemoryType:
+            return E820_RESERVED;
+        default:
+            printf("we should not get here\n");
+            return E820_RESERVED;
+    }
+}
+
+/*
+ * When EFI descriptors overlap, the most restrictive type wins. E820 type
+ * numbers do not follow that order (ACPI reclaim is above reserved).
+ */
+static uint32_t e820_rank(uint32_t type)
+{
+    switch (type) {
+        case E820_RAM:
+            return 1;
+        case E820_ACPI:
+            return 2;
+        case E820_NVS:
+            return 3;
+        case E820_RESERVED:
+            return 4;
+        case E820_UNUSABLE:
+            return 5;
+        default:
+            return 0;
+    }
+}
+
+#define E820_RANKS      6
+
+static const uint32_t rank_type[E820_RANKS] = {
+    0, E820_RAM, E820_ACPI, E820_NVS, E820_RESERVED, E820_UNUSABLE
+};
+
+static boolean_t point_before(const e820_point_t *a, const e820_point_t *b)
+{
+    return a->addr < b->addr;
+}
+
+/* In place heap sort; maps can be unsorted and much larger than usual. */
+static void sort_points(e820_point_t *points, uint32_t count)
+{
+    e820_point_t tmp;
+
+    for (uint32_t i = count / 2; i-- > 0;) {
+        for (uint32_t root = i, child; (child = 2 * root + 1) < count; root = child) {
+            if (child + 1 < count && point_before(&points[child], &points[child + 1]))
+                child++;
+            if (!point_before(&points[root], &points[child]))
+                break;
+            tmp = points[root]; points[root] = points[child]; points[child] = tmp;
+        }
+    }
+
+    for (uint32_t end = count; end-- > 1;) {
+        tmp = points[0]; points[0] = points[end]; points[end] = tmp;
+        for (uint32_t root = 0, child; (child = 2 * root + 1) < end; root = child) {
+            if (child + 1 < end && point_before(&points[child], &points[child + 1]))
+                child++;
+            if (!point_before(&points[root], &points[child]))
+                break;
+            tmp = points[root]; points[root] = points[child]; points[child] = tmp;
+        }
+    }
+}
+
+/*
+ * Convert an EFI memory map in any order, with any descriptor stride and
+ * with overlapping descriptors, into a sorted E820 map without overlaps
+ * where adjacent entries of the same type are merged. Sweeps over the
+ * sorted descriptor boundaries, keeping a count of open descriptors per
+ * type. Returns the number of entries.
+ */
+int e820_convert(const void *efi_map, uint32_t map_size, uint32_t desc_size, e820_conv_t *conv)
+{
+    const uint8_t *desc = efi_map;
+    uint32_t open[E820_RANKS] = { 0 };
+    uint32_t count = 0;
+    uint32_t current = 0;
+
+    conv->entries = 0;
+    conv->truncated = false;
+
+    if (desc_size < sizeof(efi_memory_descriptor_t))
+        return 0;
+
+    for (uint32_t off = 0; off + desc_size <= map_size; off += desc_size) {
+        const efi_memory_descriptor_t *d = (const efi_memory_descriptor_t *)(desc + off);
+        uint64_t start = d->PhysicalStart;
+        uint64_t end = start + d->NumberOfPages * EFI_PAGE_SIZE;
+
+        // Skip empty regions and ones that wrap around.
+        if (end <= start)
+            continue;
+
+        if (count + 2 > conv->max_points) {
+            conv->truncated = true;
+            break;
+        }
+
+        conv->points[count].addr = start;
+        conv->points[count].type = e820_rank(convert_memory_type(d->Type));
+        conv->points[count].delta = 1;
+        conv->points[count + 1].addr = end;
+        conv->points[count + 1].type = conv->points[count].type;
+        conv->points[count + 1].delta = -1;
+        count += 2;
+    }
+
+    sort_points(conv->points, count);
+
+    for (uint32_t i = 0; i < count;) {
+        uint64_t addr = conv->points[i].addr;
+        uint32_t rank = 0;
+
+        // Apply every boundary at this address before looking at the result.
+        for (; i < count && conv->points[i].addr == addr; i++)
+            open[conv->points[i].type] += conv->points[i].delta;
+
+        for (uint32_t r = E820_RANKS - 1; r > 0; r--) {
+            if (open[r]) {
+                rank = r;
+                break;
+            }
+        }
+
+        if (rank == current)
+            continue;
+
+        if (current)
+            conv->map[conv->entries - 1].size = addr - conv->map[conv->entries - 1].addr;
+
+        if (rank) {
+            if (conv->entries >= conv->max_entries) {
+                conv->truncated = true;
+                break;
+            }
+            conv->map[conv->entries].addr = addr;
+            conv->map[conv->entries].size = 0;
+            conv->map[conv->entries].type = rank_type[rank];
+            conv->entries++;
+        }
+
+        current = rank;
+    }
+
+    return (int)conv->entries;
+}
+
+/* First entry that ends above `addr` */
+static uint32_t e820_lookup(const struct e820_entry *map, uint32_t entries, uint64_t addr)
+{
+    uint32_t lo = 0, hi = entries;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (map[mid].addr + map[mid].size <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/*
+ * Check an E820 map against the EFI map it came from: sorted, no overlaps,
+ * no empty entries, neighbours of the same type merged, every descriptor
+ * fully covered (no RAM lost) and nothing turned into a less restrictive
+ * type (no reserved memory handed out as RAM). Returns the number of
+ * problems found.
+ */
+int e820_check(const void *efi_map, uint32_t map_size, uint32_t desc_size,
+               const struct e820_entry *map, uint32_t entries)
+{
+    int problems = 0;
+
+    for (uint32_t i = 0; i < entries; i++) {
+        if (map[i].size == 0)
+            problems++;
+        if (i > 0 && map[i - 1].addr + map[i - 1].size > map[i].addr)
+            problems++;
+        if (i > 0 && map[i - 1].addr + map[i - 1].size == map[i].addr && map[i - 1].type == map[i].type)
+            problems++;
+    }
+
+    for (uint32_t off = 0; off + desc_size <= map_size; off += desc_size) {
+        const efi_memory_descriptor_t *d = (const efi_memory_descriptor_t *)((const uint8_t *)efi_map + off);
+        uint64_t start = d->PhysicalStart;
+        uint64_t end = start + d->NumberOfPages * EFI_PAGE_SIZE;
+        uint32_t rank = e820_rank(convert_memory_type(d->Type));
+        uint64_t cursor = start;
+
+        if (end <= start)
+            continue;
+
+        for (uint32_t i = e820_lookup(map, entries, start); i < entries && map[i].addr < end; i++) {
+            if (map[i].addr > cursor || e820_rank(map[i].type) < rank)
+                break;
+            cursor = map[i].addr + map[i].size;
+        }
+
+        if (cursor < end)
+            problems++;
+    }
+
+    return problems;
+}
@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Serve INT 10h text output from 32-bit code on the linear framebuffer.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "rthunk.h"
+#include "fastint10.h"
+
+#define BDA_BYTE(off)           (*(volatile uint8_t *)(uintptr_t)(off))
+#define BDA_WORD(off)           (*(volatile uint16_t *)(uintptr_t)(off))
+
+/* Default text attributes, 0xRRGGBBAA like the rest of the console code */
+static const uint32_t cga_palette[16] =
+{
+    0x00000000, 0x0000AA00, 0x00AA0000, 0x00AAAA00,
+    0xAA000000, 0xAA00AA00, 0xAA550000, 0xAAAAAA00,
+    0x55555500, 0x5555FF00, 0x55FF5500, 0x55FFFF00,
+    0xFF555500, 0xFF55FF00, 0xFFFF5500, 0xFFFFFF00,
+};
+
+static const uint8_t fast_functions[] =
+{
+    INT10_SCROLL_UP, INT10_SCROLL_DOWN, INT10_WRITE_CHAR_ATTR, INT10_TELETYPE,
+};
+
+/*
+ * SeaVGABIOS keeps no attribute memory on a framebuffer, so remember what
+ * we drew. Cells drawn by the VGA BIOS itself read back as the default.
+ */
+static struct
+{
+    boolean_t   enabled;
+    uint8_t     mode;
+    uint32_t    cols;
+    uint32_t    rows;
+    uint32_t    handled;
+    uint32_t    chained;
+    uint8_t     attr[FASTINT10_MAX_ROWS][FASTINT10_MAX_COLS];
+} fast;
+
+static
+void fast_put(uint32_t col, uint32_t row, char c, uint8_t attr)
+{
+    fast.attr[row][col] = attr;
+    video_print_char(c, col, row, cga_palette[attr & 0xF], cga_palette[attr >> 4]);
+}
+
+static
+void fast_fill(uint32_t col, uint32_t row, uint32_t cols, uint32_t rows, uint8_t attr)
+{
+    for (uint32_t y = row; y < row + rows; y++)
+        memset(&fast.attr[y][col], attr, cols);
+    video_fill_cells(col, row, cols, rows, cga_palette[attr >> 4]);
+}
+
+static
+void fast_move(uint32_t dst_row, uint32_t src_row, uint32_t col, uint32_t cols, uint32_t rows)
+{
+    if (dst_row <= src_row) {
+        for (uint32_t y = 0; y < rows; y++)
+            memcpy(&fast.attr[dst_row + y][col], &fast.attr[src_row + y][col], cols);
+    } else {
+        for (uint32_t y = rows; y-- > 0;)
+            memcpy(&fast.attr[dst_row + y][col], &fast.attr[src_row + y][col], cols);
+    }
+    video_move_cells(dst_row, src_row, col, cols, rows);
+}
+
+/*
+ * Only the 80/132 column text modes on page 0 are ours, and only while the
+ * grid fits the framebuffer the VGA BIOS was set up with. A mode change
+ * (AH=00h goes to the VGA BIOS) resets the attribute shadow.
+ */
+static
+boolean_t fast_usable(void)
+{
+    uint8_t mode = BDA_BYTE(BDA_VIDEO_MODE) & 0x7F;
+    uint32_t cols = BDA_WORD(BDA_VIDEO_COLS);
+    uint32_t rows = BDA_BYTE(BDA_VIDEO_ROWS) + 1;
+
+    if ((mode != 0x02 && mode != 0x03) || BDA_BYTE(BDA_ACTIVE_PAGE) != 0)
+        return false;
+
+    if (rows == 1)
+        rows = 25;
+
+    if (cols == 0 || cols > FASTINT10_MAX_COLS || rows > FASTINT10_MAX_ROWS ||
+        !video_grid_fits(cols, rows))
+        return false;
+
+    if (mode != fast.mode || cols != fast.cols || rows != fast.rows) {
+        fast.mode = mode;
+        fast.cols = cols;
+        fast.rows = rows;
+        memset(fast.attr, FASTINT10_DEFAULT_ATTR, sizeof(fast.attr));
+    }
+
+    return true;
+}
+
+static
+uint32_t fast_teletype(rthunk_regs_t *regs)
+{
+    uint16_t pos = BDA_WORD(BDA_CURSOR_POS);
+    uint32_t col = pos & 0xFF;
+    uint32_t row = pos >> 8;
+    char c = (char)RTHUNK_AL(regs);
+
+    // The VGA BIOS beeps through the speaker, leave that to it.
+    if (c == '\a')
+        return RTHUNK_CHAIN;
+
+    if (col >= fast.cols || row >= fast.rows)
+        return RTHUNK_CHAIN;
+
+    switch (c)
+    {
+        case '\b':
+            if (col > 0)
+                col--;
+            break;
+        case '\r':
+            col = 0;
+            break;
+        case '\n':
+            row++;
+            break;
+        default:
+            // Teletype output keeps the attribute of the cell in text modes.
+            fast_put(col, row, c, fast.attr[row][col]);
+            col++;
+            break;
+    }
+
+    if (col >= fast.cols) {
+        col = 0;
+        row++;
+    }
+
+    if (row >= fast.rows) {
+        row = fast.rows - 1;
+        fast_move(0, 1, 0, fast.cols, fast.rows - 1);
+        fast_fill(0, row, fast.cols, 1, fast.attr[row][col]);
+    }
+
+    BDA_WORD(BDA_CURSOR_POS) = (uint16_t)((row << 8) | col);
+    return RTHUNK_DONE;
+}
+
+static
+uint32_t fast_write_char_attr(rthunk_regs_t *regs)
+{
+    uint16_t pos = BDA_WORD(BDA_CURSOR_POS);
+    uint32_t col = pos & 0xFF;
+    uint32_t row = pos >> 8;
+    uint32_t count = (uint16_t)regs->ecx;
+
+    if (RTHUNK_BH(regs) != 0 || col >= fast.cols || row >= fast.rows)
+        return RTHUNK_CHAIN;
+
+    // The cursor does not move; long runs continue on the next rows.
+    while (count-- && row < fast.rows) {
+        fast_put(col, row, (char)RTHUNK_AL(regs), RTHUNK_BL(regs));
+        if (++col >= fast.cols) {
+            col = 0;
+            row++;
+        }
+    }
+
+    return RTHUNK_DONE;
+}
+
+static
+uint32_t fast_scroll(rthunk_regs_t *regs, boolean_t up)
+{
+    uint32_t top = RTHUNK_CH(regs);
+    uint32_t left = RTHUNK_CL(regs);
+    uint32_t bottom = RTHUNK_DH(regs);
+    uint32_t right = RTHUNK_DL(regs);
+    uint32_t lines = RTHUNK_AL(regs);
+    uint8_t attr = RTHUNK_BH(regs);
+    uint32_t height, width;
+
+    if (bottom >= fast.rows)
+        bottom = fast.rows - 1;
+    if (right >= fast.cols)
+        right = fast.cols - 1;
+    if (top > bottom || left > right)
+        return RTHUNK_DONE;
+
+    height = bottom - top + 1;
+    width = right - left + 1;
+
+    // AL = 0 and anything at least as tall as the window clear it.
+    if (lines == 0 || lines >= height) {
+        fast_fill(left, top, width, height, attr);
+        return RTHUNK_DONE;
+    }
+
+    if (up) {
+        fast_move(top, top + lines, left, width, height - lines);
+        fast_fill(left, bottom - lines + 1, width, lines, attr);
+    } else {
+        fast_move(top + lines, top, left, width, height - lines);
+        fast_fill(left, top, width, lines, attr);
+    }
+
+    return RTHUNK_DONE;
+}
+
+/*
+ * Called from RThunk16.nasm with interrupts disabled. Anything we do not
+ * handle is passed on to the VGA BIOS unchanged.
+ */
+static
+uint32_t fast_int10(rthunk_regs_t *regs)
+{
+    uint32_t action = RTHUNK_CHAIN;
+
+    if (fast_usable()) {
+        switch (RTHUNK_AH(regs))
+        {
+            case INT10_TELETYPE:
+                action = fast_teletype(regs);
+                break;
+            case INT10_WRITE_CHAR_ATTR:
+                action = fast_write_char_attr(regs);
+                break;
+            case INT10_SCROLL_UP:
+                action = fast_scroll(regs, true);
+                break;
+            case INT10_SCROLL_DOWN:
+                action = fast_scroll(regs, false);
+                break;
+        }
+    }
+
+    if (action == RTHUNK_DONE)
+        fast.handled++;
+    else
+        fast.chained++;
+
+    return action;
+}
+
+/*
+ * fastint10: the handler runs from the kernel image after Legacy16Boot, so
+ * keep it out of the OS's memory map. Has to run after build_e820_map.
+ */
+int fastint10_setup(struct csmwrap_priv *priv)
+{
+    if (!cmdline_has("fastint10"))
+        return 0;
+
+    if (e820_reserve_kernel(priv) != 0)
+        return -1;
+
+    fast.enabled = true;
+    return 0;
+}
+
+/*
+ * Hook INT 10h. Must run after Legacy16PrepareToBoot so the VGA BIOS
+ * vector is in place, and before trace_install so traced calls include
+ * the fast path.
+ */
+int fastint10_install(struct csmwrap_priv *priv)
+{
+    if (!fast.enabled)
+        return 0;
+
+    fast.mode = 0xFF;
+    fast.handled = 0;
+    fast.chained = 0;
+
+    if (rthunk_hook(priv, 0x10, fast_functions, sizeof(fast_functions), fast_int10) != 0) {
+        printf("FASTINT10: cannot hook INT 10h\n");
+        return -1;
+    }
+
+    printf("FASTINT10: serving AH=06h/07h/09h/0Eh in protected mode\n");
+    return 0;
+}
+
+void fastint10_dump(void)
+{
+    if (!fast.enabled)
+        return;
+
+    printf("FASTINT10: %d calls handled, %d passed to the VGA BIOS\n", fast.handled, fast.chained);
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the 32-bit INT 10h text output fast path.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+/* INT 10h functions served in protected mode */
+#define INT10_SCROLL_UP         0x06
+#define INT10_SCROLL_DOWN       0x07
+#define INT10_WRITE_CHAR_ATTR   0x09
+#define INT10_TELETYPE          0x0E
+
+/* BIOS data area fields used by the video services */
+#define BDA_VIDEO_MODE          0x449
+#define BDA_VIDEO_COLS          0x44A
+#define BDA_CURSOR_POS          0x450   /* One word per page, row in the high byte */
+#define BDA_ACTIVE_PAGE         0x462
+#define BDA_VIDEO_ROWS          0x484   /* Rows minus one */
+
+/* Largest text grid the attribute shadow covers */
+#define FASTINT10_MAX_COLS      132
+#define FASTINT10_MAX_ROWS      60
+
+/* Attribute of cells nobody has written through the fast path yet */
+#define FASTINT10_DEFAULT_ATTR  0x07
+
+/* Functions */
+extern int fastint10_setup(struct csmwrap_priv *priv);
+extern int fastint10_install(struct csmwrap_priv *priv);
+extern void fastint10_dump(void);
@@ -0,0 +1,477 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Resident INT 13h sector cache in reserved high memory.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "rmhook.h"
+#include "rthunk.h"
+#include "int13cache.h"
+
+#define BDA_BYTE(off)           (*(volatile uint8_t *)(uintptr_t)(off))
+
+static const uint8_t cache_functions[] =
+{
+    INT13_READ, INT13_WRITE, INT13_FORMAT, INT13_WRITE_LONG, INT13_EXT_READ, INT13_EXT_WRITE,
+};
+
+/* A decoded read or write */
+typedef struct _int13_req_t
+{
+    uint8_t     drive;
+    uint32_t    lba;
+    uint32_t    count;
+    uint8_t     *buffer;
+    int13_dap_t *dap;       /* Extended calls only */
+} int13_req_t;
+
+static struct
+{
+    boolean_t           enabled;
+    uintptr_t           base;
+    uint32_t            size;
+    uint32_t            sectors;
+
+    int13cache_hdr_t    *hdr;
+    int13cache_entry_t  *entry;
+    uint32_t            *hash;
+    uint8_t             *data;
+    uint32_t            lru_head;
+    uint32_t            lru_tail;
+
+    /* rthunk_v86_calls when the cache was last known to be in sync */
+    uint32_t            v86_calls;
+
+    /* Request passed on with RTHUNK_CHAIN_POST, completed in phase 1 */
+    boolean_t           pending;
+    boolean_t           pending_write;
+    int13_req_t         req;
+} cache;
+
+static
+uint32_t cache_hash(uint8_t drive, uint32_t lba)
+{
+    return ((lba * 2654435761u) ^ drive) & (cache.hdr->hash_size - 1);
+}
+
+static
+void lru_unlink(uint32_t idx)
+{
+    int13cache_entry_t *e = &cache.entry[idx];
+
+    if (e->prev != INT13CACHE_NIL)
+        cache.entry[e->prev].next = e->next;
+    else
+        cache.lru_head = e->next;
+
+    if (e->next != INT13CACHE_NIL)
+        cache.entry[e->next].prev = e->prev;
+    else
+        cache.lru_tail = e->prev;
+}
+
+static
+void lru_push_front(uint32_t idx)
+{
+    int13cache_entry_t *e = &cache.entry[idx];
+
+    e->prev = INT13CACHE_NIL;
+    e->next = cache.lru_head;
+    if (cache.lru_head != INT13CACHE_NIL)
+        cache.entry[cache.lru_head].prev = idx;
+    else
+        cache.lru_tail = idx;
+    cache.lru_head = idx;
+}
+
+static
+void lru_push_back(uint32_t idx)
+{
+    int13cache_entry_t *e = &cache.entry[idx];
+
+    e->next = INT13CACHE_NIL;
+    e->prev = cache.lru_tail;
+    if (cache.lru_tail != INT13CACHE_NIL)
+        cache.entry[cache.lru_tail].next = idx;
+    else
+        cache.lru_head = idx;
+    cache.lru_tail = idx;
+}
+
+static
+uint32_t cache_lookup(uint8_t drive, uint32_t lba)
+{
+    uint32_t idx = cache.hash[cache_hash(drive, lba)];
+
+    while (idx != INT13CACHE_NIL) {
+        if (cache.entry[idx].lba == lba && cache.entry[idx].drive == drive)
+            return idx;
+        idx = cache.entry[idx].hash_next;
+    }
+
+    return INT13CACHE_NIL;
+}
+
+static
+void hash_unlink(uint32_t idx)
+{
+    uint32_t *link = &cache.hash[cache_hash(cache.entry[idx].drive, cache.entry[idx].lba)];
+
+    while (*link != INT13CACHE_NIL) {
+        if (*link == idx) {
+            *link = cache.entry[idx].hash_next;
+            return;
+        }
+        link = &cache.entry[*link].hash_next;
+    }
+}
+
+/* Drop one entry and make it the next one to be reused */
+static
+void cache_forget(uint32_t idx)
+{
+    hash_unlink(idx);
+    cache.entry[idx].valid = 0;
+    lru_unlink(idx);
+    lru_push_back(idx);
+}
+
+static
+void cache_store(uint8_t drive, uint32_t lba, const uint8_t *src)
+{
+    uint32_t idx = cache_lookup(drive, lba);
+
+    if (idx == INT13CACHE_NIL) {
+        idx = cache.lru_tail;
+        if (cache.entry[idx].valid)
+            hash_unlink(idx);
+
+        cache.entry[idx].drive = drive;
+        cache.entry[idx].lba = lba;
+        cache.entry[idx].valid = 1;
+        cache.entry[idx].hash_next = cache.hash[cache_hash(drive, lba)];
+        cache.hash[cache_hash(drive, lba)] = idx;
+    }
+
+    memcpy(cache.data + idx * DISK_SECTOR_SIZE, src, DISK_SECTOR_SIZE);
+    lru_unlink(idx);
+    lru_push_front(idx);
+}
+
+static
+void cache_drop_drive(uint8_t drive)
+{
+    for (uint32_t idx = 0; idx < cache.sectors; idx++) {
+        if (cache.entry[idx].valid && cache.entry[idx].drive == drive)
+            cache_forget(idx);
+    }
+    cache.hdr->invalidations++;
+}
+
+/*
+ * CHS calls are translated with the logical geometry SeaBIOS publishes in
+ * the fixed disk parameter tables, so they share entries with LBA calls.
+ * Those only exist for the first two hard disks.
+ */
+static
+boolean_t decode_chs(rthunk_regs_t *regs, int13_req_t *req)
+{
+    uint32_t fdpt;
+    const uint8_t *table;
+    uint32_t heads, spt;
+    uint32_t cylinder = RTHUNK_CH(regs) | ((uint32_t)(RTHUNK_CL(regs) & 0xC0) << 2);
+    uint32_t sector = RTHUNK_CL(regs) & 0x3F;
+    uint32_t head = RTHUNK_DH(regs);
+
+    if (req->drive == 0x80)
+        fdpt = rmhook_get_vector(INT13_FDPT0_VECTOR);
+    else if (req->drive == 0x81)
+        fdpt = rmhook_get_vector(INT13_FDPT1_VECTOR);
+    else
+        return false;
+
+    if (fdpt == 0)
+        return false;
+
+    table = (const uint8_t *)RM_FARPTR_FLAT(fdpt);
+    heads = table[2];
+    spt = table[14];
+
+    if (heads == 0 || spt == 0 || spt > 63 || head >= heads || sector == 0 || sector > spt)
+        return false;
+
+    req->lba = (cylinder * heads + head) * spt + sector - 1;
+    req->count = RTHUNK_AL(regs);
+    req->buffer = RTHUNK_FLAT(regs->es, regs->ebx);
+    req->dap = NULL;
+    return req->count != 0;
+}
+
+static
+boolean_t decode_ext(rthunk_regs_t *regs, int13_req_t *req)
+{
+    int13_dap_t *dap = RTHUNK_FLAT(regs->ds, regs->esi);
+
+    // 64-bit LBAs and flat 64-bit buffers are left to the CSM.
+    if (dap->size < 0x10 || (dap->lba >> 32) != 0 || dap->count == 0 ||
+        (dap->segment == 0xFFFF && dap->offset == 0xFFFF))
+        return false;
+
+    req->lba = (uint32_t)dap->lba;
+    req->count = dap->count;
+    req->buffer = RTHUNK_FLAT(dap->segment, dap->offset);
+    req->dap = dap;
+    return req->count <= 0xFFFFFFFF - req->lba;
+}
+
+static
+boolean_t decode(rthunk_regs_t *regs, int13_req_t *req)
+{
+    req->drive = RTHUNK_DL(regs);
+
+    switch (RTHUNK_AH(regs))
+    {
+        case INT13_READ:
+        case INT13_WRITE:
+            return decode_chs(regs, req);
+        case INT13_EXT_READ:
+        case INT13_EXT_WRITE:
+            return decode_ext(regs, req);
+    }
+
+    return false;
+}
+
+static
+boolean_t cache_serve(rthunk_regs_t *regs, const int13_req_t *req)
+{
+    uint32_t idx;
+
+    for (uint32_t i = 0; i < req->count; i++) {
+        if (cache_lookup(req->drive, req->lba + i) == INT13CACHE_NIL)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < req->count; i++) {
+        idx = cache_lookup(req->drive, req->lba + i);
+        memcpy(req->buffer + i * DISK_SECTOR_SIZE, cache.data + idx * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE);
+        lru_unlink(idx);
+        lru_push_front(idx);
+    }
+
+    // Same results as the disk driver: AH = 0, CF clear, AL = sectors for CHS.
+    if (req->dap == NULL)
+        RTHUNK_SET_AL(regs, req->count);
+    RTHUNK_SET_AH(regs, 0);
+    regs->flags &= ~RTHUNK_FLAG_CF;
+    BDA_BYTE(BDA_DISK_STATUS) = 0;
+
+    cache.hdr->hits += req->count;
+    return true;
+}
+
+/* Phase 1: the CSM has done the transfer, regs hold its results */
+static
+uint32_t cache_complete(rthunk_regs_t *regs)
+{
+    int13_req_t *req = &cache.req;
+    uint32_t done;
+
+    if (!cache.pending)
+        return RTHUNK_DONE;
+    cache.pending = false;
+
+    if (regs->flags & RTHUNK_FLAG_CF)
+        return RTHUNK_DONE;
+
+    done = req->dap ? req->dap->count : RTHUNK_AL(regs);
+    if (done == 0 || done > req->count)
+        done = req->count;
+
+    for (uint32_t i = 0; i < done; i++)
+        cache_store(req->drive, req->lba + i, req->buffer + i * DISK_SECTOR_SIZE);
+
+    if (cache.pending_write)
+        cache.hdr->writes += done;
+    else
+        cache.hdr->misses += done;
+
+    return RTHUNK_DONE;
+}
+
+/*
+ * Called from RThunk16.nasm with interrupts disabled. Reads that are fully
+ * cached never reach the CSM; everything else is passed on, and reads and
+ * writes come back in phase 1 to fill the cache.
+ */
+static
+uint32_t int13_cache(rthunk_regs_t *regs)
+{
+    uint8_t drive = RTHUNK_DL(regs);
+    boolean_t write;
+
+    if (regs->phase)
+        return cache_complete(regs);
+
+    // Writes made from V86 mode went past us; nothing cached can be trusted.
+    if (rthunk_v86_calls(0x13) != cache.v86_calls) {
+        cache.v86_calls = rthunk_v86_calls(0x13);
+        for (uint32_t idx = 0; idx < cache.sectors; idx++) {
+            if (cache.entry[idx].valid)
+                cache_forget(idx);
+        }
+        cache.hdr->invalidations++;
+    }
+
+    if (drive < 0x80 || drive > 0x8F) {
+        cache.hdr->uncached++;
+        return RTHUNK_CHAIN;
+    }
+
+    switch (RTHUNK_AH(regs))
+    {
+        case INT13_READ:
+        case INT13_EXT_READ:
+            write = false;
+            break;
+        case INT13_WRITE:
+        case INT13_EXT_WRITE:
+            write = true;
+            break;
+        default:
+            // Format and long writes change sectors we cannot follow.
+            cache_drop_drive(drive);
+            return RTHUNK_CHAIN;
+    }
+
+    if (!decode(regs, &cache.req)) {
+        if (write)
+            cache_drop_drive(drive);
+        cache.hdr->uncached++;
+        return RTHUNK_CHAIN;
+    }
+
+    if (write) {
+        // Nothing stale survives a failed write.
+        for (uint32_t i = 0; i < cache.req.count; i++) {
+            uint32_t idx = cache_lookup(drive, cache.req.lba + i);
+            if (idx != INT13CACHE_NIL)
+                cache_forget(idx);
+        }
+    } else if (cache_serve(regs, &cache.req)) {
+        return RTHUNK_DONE;
+    }
+
+    cache.pending = true;
+    cache.pending_write = write;
+    return RTHUNK_CHAIN_POST;
+}
+
+/*
+ * int13cache[=<KiB>]: carve the cache out of the RAM right below HiPmm and
+ * reserve it, together with the kernel image the handler runs from. Has to
+ * run after build_e820_map and before the map is handed to the CSM.
+ */
+int int13cache_setup(struct csmwrap_priv *priv, uintptr_t hipmm)
+{
+    uint32_t kb, sectors, hash_size, size;
+    uintptr_t base;
+    struct e820_entry *ram;
+
+    if (!cmdline_has("int13cache"))
+        return 0;
+
+    kb = cmdline_get_uint("int13cache", INT13CACHE_DEFAULT_KB);
+    if (kb < INT13CACHE_MIN_KB)
+        kb = INT13CACHE_MIN_KB;
+
+    sectors = kb * (1024 / DISK_SECTOR_SIZE);
+    for (hash_size = 1; hash_size < sectors; hash_size <<= 1)
+        ;
+
+    size = sizeof(int13cache_hdr_t) + sectors * sizeof(int13cache_entry_t) +
+           hash_size * sizeof(uint32_t) + sectors * DISK_SECTOR_SIZE;
+    size = (size + EFI_PAGE_SIZE - 1) & ~(EFI_PAGE_SIZE - 1);
+
+    // The cache goes right below HiPmm, in the same RAM entry.
+    ram = NULL;
+    for (int i = 0; i < priv->low_stub->e820_entries; i++) {
+        struct e820_entry *e = &priv->low_stub->e820_map[i];
+
+        if (e->type == E820_RAM && e->addr <= hipmm && hipmm < e->addr + e->size)
+            ram = e;
+    }
+
+    base = (hipmm - size) & ~(EFI_PAGE_SIZE - 1);
+    if (ram == NULL || hipmm < size || base < ram->addr) {
+        printf("INT13CACHE: no room for %d KiB below HiPmm\n", kb);
+        return -1;
+    }
+
+    if (e820_reserve(priv, base, size) != 0 || e820_reserve_kernel(priv) != 0)
+        return -1;
+
+    cache.base = base;
+    cache.size = size;
+    cache.sectors = sectors;
+    cache.hdr = (int13cache_hdr_t *)base;
+    cache.hdr->hash_size = hash_size;
+    cache.enabled = true;
+
+    printf("INT13CACHE: %d sectors at %x-%x\n", sectors, (uint32_t)base, (uint32_t)(base + size - 1));
+    return 0;
+}
+
+/*
+ * Start with an empty cache and hook INT 13h. Must run after
+ * Legacy16PrepareToBoot, once the CSM's disk driver is in the IVT.
+ */
+int int13cache_install(struct csmwrap_priv *priv)
+{
+    uint32_t hash_size;
+
+    if (!cache.enabled)
+        return 0;
+
+    hash_size = cache.hdr->hash_size;
+    memset(cache.hdr, 0, sizeof(int13cache_hdr_t));
+    cache.hdr->signature = INT13CACHE_SIGNATURE;
+    cache.hdr->sectors = cache.sectors;
+    cache.hdr->hash_size = hash_size;
+
+    cache.entry = (int13cache_entry_t *)(cache.hdr + 1);
+    cache.hash = (uint32_t *)(cache.entry + cache.sectors);
+    cache.data = (uint8_t *)(cache.hash + hash_size);
+    cache.lru_head = INT13CACHE_NIL;
+    cache.lru_tail = INT13CACHE_NIL;
+    cache.pending = false;
+    cache.v86_calls = 0;
+
+    memset(cache.hash, 0xFF, hash_size * sizeof(uint32_t));
+    for (uint32_t idx = 0; idx < cache.sectors; idx++) {
+        cache.entry[idx].valid = 0;
+        lru_push_back(idx);
+    }
+
+    if (rthunk_hook(priv, 0x13, cache_functions, sizeof(cache_functions), int13_cache) != 0) {
+        printf("INT13CACHE: cannot hook INT 13h\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void int13cache_dump(void)
+{
+    int13cache_hdr_t *hdr = cache.hdr;
+
+    if (!cache.enabled || hdr->signature != INT13CACHE_SIGNATURE)
+        return;
+
+    printf("INT13CACHE: %d hits, %d misses, %d written through (sectors)\n",
+           hdr->hits, hdr->misses, hdr->writes);
+    printf("INT13CACHE: %d drive invalidations, %d requests passed on\n",
+           hdr->invalidations, hdr->uncached);
+}
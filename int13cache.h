@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the resident INT 13h sector cache.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#define INT13CACHE_SIGNATURE    0x33314942  /* "BI13" */
+
+/* int13cache=<KiB>, rounded to whole sectors */
+#define INT13CACHE_DEFAULT_KB   4096
+#define INT13CACHE_MIN_KB       64
+
+#define DISK_SECTOR_SIZE        512
+
+/* INT 13h functions */
+#define INT13_READ              0x02
+#define INT13_WRITE             0x03
+#define INT13_FORMAT            0x05
+#define INT13_WRITE_LONG        0x0B
+#define INT13_EXT_READ          0x42
+#define INT13_EXT_WRITE         0x43
+
+/* Last hard disk operation status in the BDA */
+#define BDA_DISK_STATUS         0x474
+
+/* Hard disk parameter tables of drives 80h and 81h */
+#define INT13_FDPT0_VECTOR      0x41
+#define INT13_FDPT1_VECTOR      0x46
+
+/* Linked list and hash terminator */
+#define INT13CACHE_NIL          0xFFFFFFFF
+
+#pragma pack(1)
+/* INT 13h extensions disk address packet */
+typedef struct _int13_dap_t
+{
+    uint8_t     size;
+    uint8_t     reserved;
+    uint16_t    count;
+    uint16_t    offset;
+    uint16_t    segment;
+    uint64_t    lba;
+} int13_dap_t;
+#pragma pack()
+
+/* One cached sector; `prev`/`next` order the LRU list, most recent first */
+typedef struct _int13cache_entry_t
+{
+    uint32_t    lba;
+    uint8_t     drive;
+    uint8_t     valid;
+    uint16_t    reserved;
+    uint32_t    prev;
+    uint32_t    next;
+    uint32_t    hash_next;
+} int13cache_entry_t;
+
+/*
+ * Start of the reserved region, followed by the entries, the hash heads and
+ * the sector data. The counters are in sectors.
+ */
+typedef struct _int13cache_hdr_t
+{
+    uint32_t    signature;
+    uint32_t    sectors;        /* Cache capacity */
+    uint32_t    hash_size;
+    uint32_t    hits;           /* Served from the cache */
+    uint32_t    misses;         /* Read from the disk and filled in */
+    uint32_t    writes;         /* Written through */
+    uint32_t    invalidations;  /* Writes we could not follow, whole drive dropped */
+    uint32_t    uncached;       /* Requests passed on as they were */
+} int13cache_hdr_t;
+
+/* Functions */
+extern int int13cache_setup(struct csmwrap_priv *priv, uintptr_t hipmm);
+extern int int13cache_install(struct csmwrap_priv *priv);
+extern void int13cache_dump(void);
@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Log levels, compiled out below CONFIG_LOG_LEVEL.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#define LOG_LEVEL_ERR       1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_INFO      3
+#define LOG_LEVEL_DEBUG     4
+
+/* Set from the Makefile, LOG_LEVEL=<n> */
+#ifndef CONFIG_LOG_LEVEL
+#define CONFIG_LOG_LEVEL    LOG_LEVEL_DEBUG
+#endif
+
+/*
+ * The level check is a constant, so messages below CONFIG_LOG_LEVEL and
+ * their format strings never make it into the image, even at -O0. The
+ * arguments are still checked against the format.
+ */
+#define LOG_AT(level, ...) \
+    do { if ((level) <= CONFIG_LOG_LEVEL) printf(__VA_ARGS__); } while (0)
+
+#define log_err(...)        LOG_AT(LOG_LEVEL_ERR, __VA_ARGS__)
+#define log_warn(...)       LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define log_info(...)       LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define log_debug(...)      LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
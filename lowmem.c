@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Plan the below 1MiB memory layout handed to the CSM.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "lowmem.h"
+#include "edk2/LegacyBios.h"
+
+#define ALIGN_UP(x, a)          (((x) + (a) - 1) & ~((uintptr_t)(a) - 1))
+#define SEGMENT_SIZE            0x10000
+
+lowmem_layout_t lowmem;
+
+/*
+ * The tables are passed to the CSM as EFI_SEGMENT:EFI_OFFSET and the thunk
+ * runs with a 64K aligned stack segment, so neither may cross a 64K boundary.
+ */
+static uintptr_t place(uintptr_t addr, uint32_t size, uint32_t align)
+{
+    addr = ALIGN_UP(addr, align);
+    if ((addr & ~(SEGMENT_SIZE - 1)) != ((addr + size - 1) & ~(SEGMENT_SIZE - 1)))
+        addr = ALIGN_UP(addr, SEGMENT_SIZE);
+
+    return addr;
+}
+
+/*
+ * Pack the thunk right after the low stub and give everything between it
+ * and the EBDA to the CSM as LowPmm. The EBDA only gets what ebda= asks for
+ * instead of everything above CONVEN_END, and sits at the top of the RAM
+ * the low stub is in, which can end below LOWMEM_END. Runs once
+ * build_e820_map has filled in the map in the low stub.
+ * Nothing is cleared here; see csmwrapple_init for what gets initialized.
+ */
+int lowmem_plan(struct csmwrap_priv *priv)
+{
+    struct e820_entry *ram = NULL;
+    char mode[8];
+    uint32_t ebda_size;
+    uintptr_t ram_end;
+
+    ebda_size = cmdline_get_uint("ebda", EBDA_DEFAULT_SIZE);
+    if (ebda_size > LOWMEM_END)
+        ebda_size = LOWMEM_END;
+    ebda_size = ALIGN_UP(ebda_size, EBDA_MIN_SIZE);
+    if (ebda_size < EBDA_MIN_SIZE)
+        ebda_size = EBDA_MIN_SIZE;
+
+    memset(&lowmem, 0, sizeof(lowmem));
+
+    lowmem.stub = (uintptr_t)priv->low_stub;
+    lowmem.thunk = place(lowmem.stub + sizeof(struct low_stub), LOWMEM_THUNK_SIZE, EFI_PAGE_SIZE);
+    lowmem.end = lowmem.thunk + LOWMEM_THUNK_SIZE;
+
+    for (int i = 0; i < priv->low_stub->e820_entries; i++) {
+        struct e820_entry *entry = &priv->low_stub->e820_map[i];
+
+        if (entry->type == E820_RAM && entry->addr <= lowmem.stub && entry->addr + entry->size > lowmem.stub)
+            ram = entry;
+    }
+    if (ram == NULL || ram->addr + ram->size < lowmem.end) {
+        printf("LOWMEM: stub and thunk at %05x-%05x are not in RAM\n", (uint32_t)lowmem.stub,
+               (uint32_t)(lowmem.end - 1));
+        return -1;
+    }
+
+    ram_end = ram->addr + ram->size < LOWMEM_END ? (uintptr_t)(ram->addr + ram->size) : LOWMEM_END;
+    lowmem.pmm = ALIGN_UP(lowmem.end, EFI_PAGE_SIZE);
+    if (ram_end < ebda_size || ram_end - ebda_size <= lowmem.pmm) {
+        printf("LOWMEM: EBDA of %d bytes leaves no room for LowPmm below %05x\n", ebda_size, (uint32_t)ram_end);
+        return -1;
+    }
+
+    lowmem.ebda = ram_end - ebda_size;
+    lowmem.ebda_size = ebda_size;
+    lowmem.pmm_size = (uint32_t)(lowmem.ebda - lowmem.pmm);
+    lowmem.fseg_tables = cmdline_get("lowmem", mode, sizeof(mode)) && !strcmp(mode, "fseg");
+    return 0;
+}
+
+void lowmem_report(void)
+{
+    printf("LOWMEM: stub    %05x-%05x\n", (uint32_t)lowmem.stub,
+           (uint32_t)(lowmem.stub + sizeof(struct low_stub) - 1));
+    printf("LOWMEM: thunk   %05x-%05x\n", (uint32_t)lowmem.thunk, (uint32_t)(lowmem.end - 1));
+    printf("LOWMEM: LowPmm  %05x-%05x (%d KiB)\n", (uint32_t)lowmem.pmm,
+           (uint32_t)(lowmem.ebda - 1), lowmem.pmm_size / 1024);
+    printf("LOWMEM: EBDA    %05x-%05x\n", (uint32_t)lowmem.ebda, (uint32_t)(lowmem.ebda + lowmem.ebda_size - 1));
+    printf("LOWMEM: %d KiB of conventional memory left below the EBDA\n",
+           (uint32_t)lowmem.ebda / 1024);
+}
+
+/*
+ * Ask the CSM for memory it keeps reserved after boot. LEGACY16_REGION_F000
+ * is the F segment; LEGACY16_REGION_E000 is SeaBIOS' low zone (EBDA or
+ * upper memory), which has more room. Only valid once
+ * Legacy16InitializeYourself has run. Returns the flat address or 0.
+ */
+uintptr_t lowmem_csm_alloc(struct csmwrap_priv *priv, uint16_t region, uint16_t size, uint16_t align)
+{
+    EFI_IA32_REGISTER_SET Regs;
+
+    memset(&Regs, 0, sizeof(EFI_IA32_REGISTER_SET));
+    Regs.X.AX = Legacy16GetTableAddress;
+    Regs.X.BX = region;
+    Regs.X.CX = size;
+    Regs.X.DX = align;
+
+    LegacyBiosFarCall86(priv->csm_efi_table->Compatibility16CallSegment,
+                        priv->csm_efi_table->Compatibility16CallOffset,
+                        &Regs,
+                        NULL,
+                        0);
+
+    if (Regs.X.AX != 0) {
+        printf("LOWMEM: Legacy16GetTableAddress(%d) failed: %x\n", size, Regs.X.AX);
+        return 0;
+    }
+
+    return ((uintptr_t)Regs.X.DS << 4) + Regs.X.BX;
+}
+
+/*
+ * lowmem=fseg: move the E820 map and the BBS table out of conventional
+ * memory into the F segment, so they stay resident after the OS takes over
+ * the low stub. The CSM reads E820Pointer from its own copy of the
+ * compatibility table, which lives in the ROM window by now.
+ */
+int lowmem_move_tables(struct csmwrap_priv *priv)
+{
+    EFI_COMPATIBILITY16_TABLE *table;
+    uint32_t e820_size;
+    uint32_t bbs_size;
+    uintptr_t e820;
+    uintptr_t bbs;
+
+    table = (EFI_COMPATIBILITY16_TABLE *)(priv->csm_bin_base +
+                                          ((uint8_t *)priv->csm_efi_table - priv->csm_bin));
+
+    e820_size = sizeof(struct e820_entry) * priv->low_stub->e820_entries;
+    e820 = lowmem_csm_alloc(priv, LEGACY16_REGION_F000, e820_size, 16);
+    if (e820 == 0)
+        return -1;
+
+    memcpy((void *)e820, priv->low_stub->e820_map, e820_size);
+    table->E820Pointer = (uint32_t)e820;
+    table->E820Length = e820_size;
+    printf("LOWMEM: E820 map moved to %05x\n", (uint32_t)e820);
+
+    bbs_size = sizeof(BBS_TABLE) * priv->low_stub->boot_table.NumberBbsEntries;
+    if (bbs_size == 0)
+        return 0;
+
+    bbs = lowmem_csm_alloc(priv, LEGACY16_REGION_F000, bbs_size, 16);
+    if (bbs == 0)
+        return -1;
+
+    memcpy((void *)bbs, priv->low_stub->bbs_table, bbs_size);
+    priv->low_stub->boot_table.BbsTable = (uint32_t)bbs;
+    printf("LOWMEM: BBS table moved to %05x\n", (uint32_t)bbs);
+
+    return 0;
+}
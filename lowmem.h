@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the below 1MiB memory layout planner.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+/* Top of conventional memory */
+#define LOWMEM_END              0x000A0000
+/* Reserved below LOWMEM_END for the EBDA unless overridden with ebda= */
+#define EBDA_DEFAULT_SIZE       0x8000
+#define EBDA_MIN_SIZE           0x400
+/* Code page of the real mode thunk, followed by its stack */
+#define LOWMEM_THUNK_SIZE       (EFI_PAGE_SIZE + LOW_STACK_SIZE)
+
+/* Legacy16GetTableAddress allocation regions (BX) */
+#define LEGACY16_REGION_ANY     0x00
+#define LEGACY16_REGION_F000    0x01
+#define LEGACY16_REGION_E000    0x02
+
+typedef struct _lowmem_layout_t
+{
+    uintptr_t   stub;           /* struct low_stub */
+    uintptr_t   thunk;          /* Real mode thunk code and stack */
+    uintptr_t   end;            /* First byte after our own structures */
+    uintptr_t   pmm;            /* LowPmm handed to the CSM */
+    uint32_t    pmm_size;
+    uintptr_t   ebda;           /* BiosLessThan1MB */
+    uint32_t    ebda_size;
+    boolean_t   fseg_tables;    /* lowmem=fseg */
+} lowmem_layout_t;
+
+extern lowmem_layout_t lowmem;
+
+/* Functions */
+extern int lowmem_plan(struct csmwrap_priv *priv);
+extern void lowmem_report(void);
+extern uintptr_t lowmem_csm_alloc(struct csmwrap_priv *priv, uint16_t region, uint16_t size, uint16_t align);
+extern int lowmem_move_tables(struct csmwrap_priv *priv);
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Measure memory bandwidth and latency per region and MTRR type.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cpu.h"
+#include "cpuperf.h"
+#include "lowmem.h"
+#include "membench.h"
+#include "mtrr.h"
+
+static const uint8_t bench_types[] =
+{
+    MTRR_TYPE_UC, MTRR_TYPE_WC, MTRR_TYPE_WT, MTRR_TYPE_WP, MTRR_TYPE_WB,
+};
+
+static membench_result_t    results[MEMBENCH_MAX_RESULTS];
+static uint32_t             num_results;
+
+/* Reads are not something the console or the ROM copy do in bulk */
+static uint32_t bench_read(const uint32_t *p, uint32_t size)
+{
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < size / sizeof(uint32_t); i += 4)
+        sum += p[i] + p[i + 1] + p[i + 2] + p[i + 3];
+
+    return sum;
+}
+
+static uint32_t chase_seed = 0x2545F491;
+
+static uint32_t chase_random(void)
+{
+    // xorshift32
+    chase_seed ^= chase_seed << 13;
+    chase_seed ^= chase_seed >> 17;
+    chase_seed ^= chase_seed << 5;
+    return chase_seed;
+}
+
+/*
+ * Link every cache line of the window into one cycle in a random order so
+ * the prefetchers cannot follow, then walk it.
+ */
+static uint32_t bench_chase(uint8_t *base, uint32_t size)
+{
+    uint32_t lines = size / MEMBENCH_LINE_SIZE;
+    void *volatile *p;
+    uint64_t start;
+
+    // Every line starts out pointing at itself. Sattolo's shuffle of those
+    // pointers leaves a single cycle through all of them.
+    for (uint32_t i = 0; i < lines; i++)
+        *(void **)(base + i * MEMBENCH_LINE_SIZE) = base + i * MEMBENCH_LINE_SIZE;
+
+    for (uint32_t i = lines - 1; i > 0; i--) {
+        uint32_t j = chase_random() % i;
+        void **a = (void **)(base + i * MEMBENCH_LINE_SIZE);
+        void **b = (void **)(base + j * MEMBENCH_LINE_SIZE);
+        void *tmp = *a;
+
+        *a = *b;
+        *b = tmp;
+    }
+
+    p = (void *volatile *)base;
+    start = rdtsc();
+    for (uint32_t i = 0; i < MEMBENCH_CHASE_LOADS; i++)
+        p = (void *volatile *)*p;
+
+    return (uint32_t)(rdtsc() - start) / MEMBENCH_CHASE_LOADS;
+}
+
+static void bench_window(const char *region, uint8_t *base, uint32_t size, uint8_t type, boolean_t current)
+{
+    membench_result_t *r;
+    uint32_t kib = size >> 10;
+    uint32_t sink = 0;
+    uint64_t start;
+
+    if (num_results >= MEMBENCH_MAX_RESULTS)
+        return;
+    r = &results[num_results++];
+    r->region = region;
+    r->type = type;
+    r->current = current;
+
+    // The same kernels the console (memset, memmove) and ROM copy (memcpy) use.
+    start = rdtsc();
+    for (uint32_t pass = 0; pass < MEMBENCH_PASSES; pass++)
+        memset(base, (int)pass, size);
+    r->write = (uint32_t)(rdtsc() - start) / (MEMBENCH_PASSES * kib);
+
+    start = rdtsc();
+    for (uint32_t pass = 0; pass < MEMBENCH_PASSES; pass++)
+        sink += bench_read((const uint32_t *)base, size);
+    r->read = (uint32_t)(rdtsc() - start) / (MEMBENCH_PASSES * kib);
+
+    start = rdtsc();
+    for (uint32_t pass = 0; pass < MEMBENCH_PASSES; pass++)
+        memcpy(base + size / 2, base, size / 2);
+    r->copy = (uint32_t)(rdtsc() - start) / (MEMBENCH_PASSES * (kib / 2));
+
+    r->latency = bench_chase(base, size);
+
+    // Keep the read loop from being optimized away.
+    asm volatile("" : : "r" (sink));
+}
+
+/* Regions below 1 MiB, retyped through the fixed range MTRRs */
+static void bench_fixed(const char *region, uint8_t *base, uint32_t start, uint32_t end)
+{
+    uint64_t saved[MTRR_NUM_FIXED];
+
+    mtrr_fixed_save(saved);
+    bench_window(region, base, MEMBENCH_LOW_SIZE, 0xFF, true);
+
+    for (uint32_t i = 0; i < sizeof(bench_types); i++) {
+        if (!mtrr_type_supported(bench_types[i]))
+            continue;
+        if (mtrr_set_fixed(start, end, bench_types[i]) || mtrr_commit())
+            break;
+        bench_window(region, base, MEMBENCH_LOW_SIZE, bench_types[i], false);
+    }
+
+    mtrr_fixed_restore(saved);
+}
+
+/*
+ * Regions above 1 MiB get a temporary variable range. Overlapping ranges
+ * are only well defined when one of them is UC, or WT over WB, so an
+ * already covered window is only tried with those.
+ */
+static void bench_variable(const char *region, uint8_t *base, uint32_t size)
+{
+    uint8_t existing = mtrr_var_type((uintptr_t)base, size);
+
+    bench_window(region, base, size, existing, true);
+
+    for (uint32_t i = 0; i < sizeof(bench_types); i++) {
+        uint8_t type = bench_types[i];
+        int slot;
+
+        if (!mtrr_type_supported(type))
+            continue;
+        if (existing != 0xFF && type != MTRR_TYPE_UC &&
+            !(type == MTRR_TYPE_WT && existing == MTRR_TYPE_WB))
+            continue;
+
+        slot = mtrr_var_claim((uintptr_t)base, size, type);
+        if (slot < 0) {
+            printf("MEMBENCH: no free variable MTRR for %s\n", region);
+            return;
+        }
+        bench_window(region, base, size, type, false);
+        mtrr_var_release(slot);
+    }
+}
+
+static void print_rate(uint32_t mhz, uint32_t cycles_per_kib)
+{
+    // 1 KiB per `cycles_per_kib` cycles at `mhz` million cycles per second
+    if (mhz && cycles_per_kib)
+        printf(" %6d", 1024 * mhz / cycles_per_kib);
+    else
+        printf(" %6s", "-");
+}
+
+/*
+ * membench: runs while nothing lives in the scratch windows yet (LowPmm,
+ * the E segment before the ROM copy, HiPmm, and the framebuffer, which is
+ * cleared afterwards). Must run after mtrr_init and before the legacy
+ * MTRR setup, which stays as it was.
+ */
+void membench_run(uintptr_t hipmm)
+{
+    uint32_t mhz = cpuperf_measure_mhz();
+    uintptr_t high;
+    uint32_t fb_size;
+
+    num_results = 0;
+
+    if (lowmem.pmm_size >= MEMBENCH_LOW_SIZE)
+        bench_fixed("conv", (uint8_t *)lowmem.pmm, 0x00000, 0xA0000);
+    bench_fixed("rom", (uint8_t *)MEMBENCH_ROM_BASE, MEMBENCH_ROM_BASE, MEMBENCH_ROM_BASE + MEMBENCH_LOW_SIZE);
+
+    high = (hipmm + MEMBENCH_HIGH_SIZE - 1) & ~(MEMBENCH_HIGH_SIZE - 1);
+    if (hipmm && high + MEMBENCH_HIGH_SIZE <= hipmm + HIPMM_SIZE)
+        bench_variable("hipmm", (uint8_t *)high, MEMBENCH_HIGH_SIZE);
+
+    // Largest power of two window the framebuffer holds, up to 1 MiB.
+    fb_size = MEMBENCH_HIGH_SIZE;
+    while (fb_size > MEMBENCH_LOW_SIZE && fb_size > gBA->video.pitch * gBA->video.height)
+        fb_size >>= 1;
+    if (fb_size <= gBA->video.pitch * gBA->video.height && !(gBA->video.base_addr & (fb_size - 1))) {
+        bench_variable("fb", (uint8_t *)(uintptr_t)gBA->video.base_addr, fb_size);
+        cons_clear_screen(0x00000000);
+    }
+
+    printf("MEMBENCH: %d MHz, MB/s for read/write/copy, cycles per dependent load\n", mhz);
+    printf("MEMBENCH: region type   read  write   copy latency\n");
+    for (uint32_t i = 0; i < num_results; i++) {
+        membench_result_t *r = &results[i];
+
+        printf("MEMBENCH: %-6s %s%s", r->region,
+               r->type == 0xFF ? "--" : mtrr_type_name(r->type), r->current ? "*" : " ");
+        print_rate(mhz, r->read);
+        print_rate(mhz, r->write);
+        print_rate(mhz, r->copy);
+        printf(" %7d\n", r->latency);
+    }
+    printf("MEMBENCH: * = type as found\n");
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the memory bandwidth and latency probe.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+/* Scratch windows; the low ones must match fixed MTRR granularity */
+#define MEMBENCH_LOW_SIZE       0x10000
+#define MEMBENCH_ROM_BASE       0xE0000     /* Overwritten by the Csm16 copy later */
+#define MEMBENCH_HIGH_SIZE      0x100000
+
+/* Bandwidth passes over each window, pointer chase loads */
+#define MEMBENCH_PASSES         4
+#define MEMBENCH_CHASE_LOADS    4096
+#define MEMBENCH_LINE_SIZE      64
+
+#define MEMBENCH_MAX_RESULTS    24
+
+typedef struct _membench_result_t
+{
+    const char  *region;
+    uint8_t     type;
+    boolean_t   current;    /* Type the firmware left, not one we set */
+    uint32_t    read;       /* Cycles per KiB */
+    uint32_t    write;
+    uint32_t    copy;
+    uint32_t    latency;    /* Cycles per dependent load */
+} membench_result_t;
+
+/* Functions */
+extern void membench_run(uintptr_t hipmm);
@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: MTRR inspection and fixed-range programming for the legacy regions.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cpu.h"
+#include "mtrr.h"
+
+/*
+ * Layout of the fixed-range MTRRs. Each MSR holds eight one-byte memory
+ * types, one for every `unit` sized chunk starting at `base`.
+ */
+static const struct {
+    uint32_t    msr;
+    uint32_t    base;
+    uint32_t    unit;
+} fixed_mtrrs[MTRR_NUM_FIXED] = {
+    { MSR_MTRR_FIX_64K_00000,       0x00000, 0x10000 },
+    { MSR_MTRR_FIX_16K_80000,       0x80000, 0x4000 },
+    { MSR_MTRR_FIX_16K_A0000,       0xA0000, 0x4000 },
+    { MSR_MTRR_FIX_4K_C0000 + 0,    0xC0000, 0x1000 },
+    { MSR_MTRR_FIX_4K_C0000 + 1,    0xC8000, 0x1000 },
+    { MSR_MTRR_FIX_4K_C0000 + 2,    0xD0000, 0x1000 },
+    { MSR_MTRR_FIX_4K_C0000 + 3,    0xD8000, 0x1000 },
+    { MSR_MTRR_FIX_4K_C0000 + 4,    0xE0000, 0x1000 },
+    { MSR_MTRR_FIX_4K_C0000 + 5,    0xE8000, 0x1000 },
+    { MSR_MTRR_FIX_4K_C0000 + 6,    0xF0000, 0x1000 },
+    { MSR_MTRR_FIX_4K_C0000 + 7,    0xF8000, 0x1000 },
+};
+
+static struct {
+    boolean_t   present;
+    uint64_t    cap;
+    uint64_t    def_type;
+    /* Shadow copy of the fixed-range MSRs, written back by mtrr_commit(). */
+    uint64_t    fixed[MTRR_NUM_FIXED];
+    boolean_t   dirty;
+} mtrr;
+
+const char *mtrr_type_name(uint8_t type)
+{
+    switch (type) {
+        case MTRR_TYPE_UC:
+            return "UC";
+        case MTRR_TYPE_WC:
+            return "WC";
+        case MTRR_TYPE_WT:
+            return "WT";
+        case MTRR_TYPE_WP:
+            return "WP";
+        case MTRR_TYPE_WB:
+            return "WB";
+        default:
+            return "??";
+    }
+}
+
+static uint8_t fixed_type_at(uint32_t addr)
+{
+    for (int i = MTRR_NUM_FIXED - 1; i >= 0; i--) {
+        if (addr >= fixed_mtrrs[i].base) {
+            uint32_t slot = (addr - fixed_mtrrs[i].base) / fixed_mtrrs[i].unit;
+            return (uint8_t)(mtrr.fixed[i] >> (slot * 8));
+        }
+    }
+
+    return MTRR_TYPE_UC;
+}
+
+boolean_t mtrr_init(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+
+    memset(&mtrr, 0, sizeof(mtrr));
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_FEATURE_MTRR)) {
+        printf("MTRR: not supported by this CPU\n");
+        return false;
+    }
+
+    mtrr.cap = rdmsr(MSR_MTRR_CAP);
+    mtrr.def_type = rdmsr(MSR_MTRR_DEF_TYPE);
+
+    if (!(mtrr.cap & MTRR_CAP_FIX)) {
+        printf("MTRR: fixed-range MTRRs not supported\n");
+        return false;
+    }
+
+    for (int i = 0; i < MTRR_NUM_FIXED; i++)
+        mtrr.fixed[i] = rdmsr(fixed_mtrrs[i].msr);
+
+    mtrr.present = true;
+    return true;
+}
+
+void mtrr_dump(void)
+{
+    uint32_t vcnt;
+    uint32_t run_start;
+    uint8_t run_type;
+
+    if (!mtrr.present)
+        return;
+
+    vcnt = (uint32_t)(mtrr.cap & MTRR_CAP_VCNT_MASK);
+
+    printf("MTRR: default %s, %s, fixed %s, %d variable\n",
+           mtrr_type_name((uint8_t)(mtrr.def_type & MTRR_DEF_TYPE_MASK)),
+           (mtrr.def_type & MTRR_DEF_TYPE_E) ? "enabled" : "disabled",
+           (mtrr.def_type & MTRR_DEF_TYPE_FE) ? "enabled" : "disabled",
+           vcnt);
+
+    // Print the fixed ranges as runs of identical type to keep it readable.
+    run_start = 0;
+    run_type = fixed_type_at(0);
+    for (uint32_t addr = 0x1000; addr <= MTRR_FIXED_END; addr += 0x1000) {
+        uint8_t type = (addr < MTRR_FIXED_END) ? fixed_type_at(addr) : 0xFF;
+        if (type != run_type) {
+            printf("MTRR: fixed [%05x-%05x] %s\n", run_start, addr - 1, mtrr_type_name(run_type));
+            run_start = addr;
+            run_type = type;
+        }
+    }
+
+    for (uint32_t i = 0; i < vcnt; i++) {
+        uint64_t base = rdmsr(MSR_MTRR_PHYS_BASE(i));
+        uint64_t mask = rdmsr(MSR_MTRR_PHYS_MASK(i));
+
+        if (!(mask & MTRR_PHYS_MASK_VALID))
+            continue;
+
+        printf("MTRR: var%d base %08x mask %08x %s\n", i,
+               (uint32_t)(base & ~0xFFFULL), (uint32_t)(mask & ~0xFFFULL),
+               mtrr_type_name((uint8_t)(base & 0xFF)));
+    }
+}
+
+/*
+ * Update the shadow copy for [start, end). Both ends must fall on the
+ * granularity of the fixed range MSRs they touch.
+ */
+int mtrr_set_fixed(uint32_t start, uint32_t end, uint8_t type)
+{
+    if (!mtrr.present)
+        return -1;
+
+    if (end > MTRR_FIXED_END || start >= end)
+        return -1;
+
+    for (int i = 0; i < MTRR_NUM_FIXED; i++) {
+        for (uint32_t slot = 0; slot < 8; slot++) {
+            uint32_t chunk = fixed_mtrrs[i].base + slot * fixed_mtrrs[i].unit;
+            uint32_t chunk_end = chunk + fixed_mtrrs[i].unit;
+
+            if (chunk_end <= start || chunk >= end)
+                continue;
+
+            if (chunk < start || chunk_end > end) {
+                printf("MTRR: [%05x-%05x] is not aligned to fixed ranges\n", start, end - 1);
+                return -1;
+            }
+
+            mtrr.fixed[i] &= ~(0xFFULL << (slot * 8));
+            mtrr.fixed[i] |= (uint64_t)type << (slot * 8);
+        }
+    }
+
+    mtrr.dirty = true;
+    return 0;
+}
+
+/*
+ * MTRR update sequence from the Intel SDM (11.11.7.2): disable caching,
+ * flush, disable MTRRs, update, flush, enable.
+ */
+static uint32_t mtrr_update_begin(uint32_t *cr0)
+{
+    uint32_t flags = save_flags_cli();
+
+    *cr0 = read_cr0();
+    write_cr0((*cr0 | CR0_CD) & ~CR0_NW);
+    wbinvd();
+
+    wrmsr(MSR_MTRR_DEF_TYPE, mtrr.def_type & ~(uint64_t)(MTRR_DEF_TYPE_E | MTRR_DEF_TYPE_FE));
+    return flags;
+}
+
+static void mtrr_update_end(uint32_t cr0, uint32_t flags)
+{
+    wbinvd();
+
+    mtrr.def_type |= MTRR_DEF_TYPE_E | MTRR_DEF_TYPE_FE;
+    wrmsr(MSR_MTRR_DEF_TYPE, mtrr.def_type);
+
+    write_cr0(cr0);
+    restore_flags(flags);
+}
+
+/* Write the shadow copy of the fixed ranges back. */
+int mtrr_commit(void)
+{
+    uint32_t flags;
+    uint32_t cr0;
+
+    if (!mtrr.present)
+        return -1;
+
+    if (!mtrr.dirty)
+        return 0;
+
+    if (!(mtrr.def_type & MTRR_DEF_TYPE_E))
+        printf("MTRR: MTRRs were disabled, enabling with default %s\n",
+               mtrr_type_name((uint8_t)(mtrr.def_type & MTRR_DEF_TYPE_MASK)));
+
+    flags = mtrr_update_begin(&cr0);
+
+    for (int i = 0; i < MTRR_NUM_FIXED; i++)
+        wrmsr(fixed_mtrrs[i].msr, mtrr.fixed[i]);
+
+    mtrr_update_end(cr0, flags);
+
+    mtrr.dirty = false;
+    return 0;
+}
+
+/* Save and restore the fixed range shadow around temporary changes. */
+void mtrr_fixed_save(uint64_t saved[MTRR_NUM_FIXED])
+{
+    memcpy(saved, mtrr.fixed, sizeof(mtrr.fixed));
+}
+
+int mtrr_fixed_restore(const uint64_t saved[MTRR_NUM_FIXED])
+{
+    memcpy(mtrr.fixed, saved, sizeof(mtrr.fixed));
+    mtrr.dirty = true;
+    return mtrr_commit();
+}
+
+static uint64_t mtrr_phys_mask(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t width = 36;
+
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000008) {
+        cpuid(0x80000008, &eax, &ebx, &ecx, &edx);
+        width = eax & 0xFF;
+    }
+
+    return (1ULL << width) - 1;
+}
+
+/*
+ * Type of the first valid variable range overlapping [base, base + size),
+ * or 0xFF if none does.
+ */
+uint8_t mtrr_var_type(uint64_t base, uint64_t size)
+{
+    uint32_t vcnt = (uint32_t)(mtrr.cap & MTRR_CAP_VCNT_MASK);
+    uint64_t addr_mask = mtrr_phys_mask() & ~0xFFFULL;
+
+    if (!mtrr.present)
+        return 0xFF;
+
+    for (uint32_t i = 0; i < vcnt; i++) {
+        uint64_t raw = rdmsr(MSR_MTRR_PHYS_BASE(i));
+        uint64_t vmask = rdmsr(MSR_MTRR_PHYS_MASK(i));
+        uint64_t vbase, vsize;
+
+        if (!(vmask & MTRR_PHYS_MASK_VALID))
+            continue;
+
+        vbase = raw & addr_mask;
+        vsize = (~(vmask & addr_mask) & addr_mask) + 0x1000;
+        if (vbase < base + size && base < vbase + vsize)
+            return (uint8_t)(raw & 0xFF);
+    }
+
+    return 0xFF;
+}
+
+/*
+ * Claim a free variable range for [base, base + size). The size must be a
+ * power of two of at least 4 KiB and the base aligned to it. Returns the
+ * slot for mtrr_var_release, or -1.
+ */
+int mtrr_var_claim(uint64_t base, uint64_t size, uint8_t type)
+{
+    uint32_t vcnt = (uint32_t)(mtrr.cap & MTRR_CAP_VCNT_MASK);
+    uint32_t flags, cr0;
+
+    if (!mtrr.present || size < 0x1000 || (size & (size - 1)) || (base & (size - 1)))
+        return -1;
+
+    for (uint32_t i = 0; i < vcnt; i++) {
+        if (rdmsr(MSR_MTRR_PHYS_MASK(i)) & MTRR_PHYS_MASK_VALID)
+            continue;
+
+        flags = mtrr_update_begin(&cr0);
+        wrmsr(MSR_MTRR_PHYS_BASE(i), base | type);
+        wrmsr(MSR_MTRR_PHYS_MASK(i), (~(size - 1) & mtrr_phys_mask()) | MTRR_PHYS_MASK_VALID);
+        mtrr_update_end(cr0, flags);
+        return (int)i;
+    }
+
+    return -1;
+}
+
+void mtrr_var_release(int slot)
+{
+    uint32_t flags, cr0;
+
+    if (slot < 0)
+        return;
+
+    flags = mtrr_update_begin(&cr0);
+    wrmsr(MSR_MTRR_PHYS_MASK(slot), 0);
+    wrmsr(MSR_MTRR_PHYS_BASE(slot), 0);
+    mtrr_update_end(cr0, flags);
+}
+
+boolean_t mtrr_type_supported(uint8_t type)
+{
+    return type != MTRR_TYPE_WC || (mtrr.cap & MTRR_CAP_WC);
+}
+
+/*
+ * Conventional memory and the ROM shadow are plain RAM and want WB. The
+ * legacy VGA window is device memory, so it gets whatever the caller asks
+ * for (UC unless the CPU supports WC and the caller wants it).
+ */
+int mtrr_setup_legacy(uint8_t vga_type)
+{
+    if (!mtrr.present)
+        return -1;
+
+    if (vga_type == MTRR_TYPE_WC && !(mtrr.cap & MTRR_CAP_WC))
+        vga_type = MTRR_TYPE_UC;
+
+    if (mtrr_set_fixed(0x00000, 0xA0000, MTRR_TYPE_WB) ||
+        mtrr_set_fixed(0xA0000, VGABIOS_START, vga_type) ||
+        mtrr_set_fixed(VGABIOS_START, BIOSROM_END, MTRR_TYPE_WB))
+        return -1;
+
+    return mtrr_commit();
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for MTRR inspection and programming.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#define MSR_MTRR_CAP            0x0FE
+#define MSR_MTRR_DEF_TYPE       0x2FF
+#define MSR_MTRR_PHYS_BASE(n)   (0x200 + 2 * (n))
+#define MSR_MTRR_PHYS_MASK(n)   (0x201 + 2 * (n))
+#define MSR_MTRR_FIX_64K_00000  0x250
+#define MSR_MTRR_FIX_16K_80000  0x258
+#define MSR_MTRR_FIX_16K_A0000  0x259
+#define MSR_MTRR_FIX_4K_C0000   0x268 /* Followed by 7 more 4K MSRs up to 0xF8000 */
+
+#define MTRR_CAP_VCNT_MASK      0xFF
+#define MTRR_CAP_FIX            (1 << 8)
+#define MTRR_CAP_WC             (1 << 10)
+
+#define MTRR_DEF_TYPE_MASK      0xFF
+#define MTRR_DEF_TYPE_FE        (1 << 10)
+#define MTRR_DEF_TYPE_E         (1 << 11)
+
+#define MTRR_PHYS_MASK_VALID    (1 << 11)
+
+#define MTRR_TYPE_UC            0
+#define MTRR_TYPE_WC            1
+#define MTRR_TYPE_WT            4
+#define MTRR_TYPE_WP            5
+#define MTRR_TYPE_WB            6
+
+/* The fixed-range MTRRs cover the whole first megabyte. */
+#define MTRR_FIXED_END          0x00100000
+#define MTRR_NUM_FIXED          11
+
+/* Functions */
+extern boolean_t mtrr_init(void);
+extern void mtrr_dump(void);
+extern int mtrr_set_fixed(uint32_t start, uint32_t end, uint8_t type);
+extern int mtrr_commit(void);
+extern int mtrr_setup_legacy(uint8_t vga_type);
+extern const char *mtrr_type_name(uint8_t type);
+extern void mtrr_fixed_save(uint64_t saved[MTRR_NUM_FIXED]);
+extern int mtrr_fixed_restore(const uint64_t saved[MTRR_NUM_FIXED]);
+extern uint8_t mtrr_var_type(uint64_t base, uint64_t size);
+extern int mtrr_var_claim(uint64_t base, uint64_t size, uint8_t type);
+extern void mtrr_var_release(int slot);
+extern boolean_t mtrr_type_supported(uint8_t type);
@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: PCI configuration access and a one-pass device cache.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cpu.h"
+#include "pci.h"
+
+static struct pci_device    pci_devices[PCI_MAX_DEVICES];
+static uint32_t             pci_num_devices;
+
+/* ACPI MCFG table: header, 8 reserved bytes, then allocation entries. */
+#pragma pack(1)
+struct mcfg_allocation {
+    uint64_t    base_address;
+    uint16_t    segment;
+    uint8_t     start_bus;
+    uint8_t     end_bus;
+    uint32_t    reserved;
+};
+
+struct mcfg_table {
+    EFI_ACPI_DESCRIPTION_HEADER header;
+    uint64_t                    reserved;
+    struct mcfg_allocation      allocations[];
+};
+#pragma pack()
+
+/* Memory mapped configuration space for segment 0, if the firmware has one. */
+static struct {
+    uintptr_t   base;
+    uint8_t     start_bus;
+    uint8_t     end_bus;
+} ecam;
+
+boolean_t pci_ecam_init(void)
+{
+    struct mcfg_table *mcfg;
+    uint32_t count;
+
+    memset(&ecam, 0, sizeof(ecam));
+
+    mcfg = acpi_find_table(SIGNATURE_32('M', 'C', 'F', 'G'));
+    if (mcfg == NULL) {
+        printf("PCI: no MCFG table, using port I/O config access\n");
+        return false;
+    }
+
+    if (mcfg->header.Length < sizeof(struct mcfg_table)) {
+        printf("PCI: MCFG table too short, using port I/O config access\n");
+        return false;
+    }
+
+    count = (mcfg->header.Length - sizeof(struct mcfg_table)) / sizeof(struct mcfg_allocation);
+    for (uint32_t i = 0; i < count; i++) {
+        struct mcfg_allocation *alloc = &mcfg->allocations[i];
+
+        if (alloc->segment != 0 || alloc->base_address > 0xffffffff)
+            continue;
+
+        ecam.base = (uintptr_t)alloc->base_address;
+        ecam.start_bus = alloc->start_bus;
+        ecam.end_bus = alloc->end_bus;
+
+        printf("PCI: ECAM at %x for buses %02x-%02x\n", (uint32_t)ecam.base, ecam.start_bus, ecam.end_bus);
+        return true;
+    }
+
+    printf("PCI: MCFG has no usable segment 0 window\n");
+    return false;
+}
+
+static inline volatile void *pci_ecam_address(uint8_t bus, uint8_t devfn, uint16_t reg)
+{
+    if (ecam.base == 0 || bus < ecam.start_bus || bus > ecam.end_bus)
+        return NULL;
+
+    // The MCFG base address is where bus 0 would be, even if the window starts later.
+    return (volatile void *)(ecam.base +
+                             ((uintptr_t)bus << PCI_ECAM_BUS_SHIFT) +
+                             ((uintptr_t)devfn << PCI_ECAM_DEVFN_SHIFT) + reg);
+}
+
+static inline uint32_t pci_cfg_address(uint8_t bus, uint8_t devfn, uint16_t reg)
+{
+    return 0x80000000 | ((uint32_t)bus << 16) | ((uint32_t)devfn << 8) | (reg & 0xFC);
+}
+
+static uint32_t pci_io_read32(uint8_t bus, uint8_t devfn, uint16_t reg)
+{
+    outl(PCI_CONFIG_ADDRESS, pci_cfg_address(bus, devfn, reg));
+    return inl(PCI_CONFIG_DATA);
+}
+
+uint32_t pci_cfg_read32(uint8_t bus, uint8_t devfn, uint16_t reg)
+{
+    volatile uint32_t *mmio = pci_ecam_address(bus, devfn, reg & ~3);
+
+    if (mmio)
+        return *mmio;
+
+    return pci_io_read32(bus, devfn, reg);
+}
+
+uint16_t pci_cfg_read16(uint8_t bus, uint8_t devfn, uint16_t reg)
+{
+    volatile uint16_t *mmio = pci_ecam_address(bus, devfn, reg & ~1);
+
+    if (mmio)
+        return *mmio;
+
+    outl(PCI_CONFIG_ADDRESS, pci_cfg_address(bus, devfn, reg));
+    return inw(PCI_CONFIG_DATA + (reg & 2));
+}
+
+uint8_t pci_cfg_read8(uint8_t bus, uint8_t devfn, uint16_t reg)
+{
+    volatile uint8_t *mmio = pci_ecam_address(bus, devfn, reg);
+
+    if (mmio)
+        return *mmio;
+
+    outl(PCI_CONFIG_ADDRESS, pci_cfg_address(bus, devfn, reg));
+    return inb(PCI_CONFIG_DATA + (reg & 3));
+}
+
+void pci_cfg_write32(uint8_t bus, uint8_t devfn, uint16_t reg, uint32_t value)
+{
+    volatile uint32_t *mmio = pci_ecam_address(bus, devfn, reg & ~3);
+
+    if (mmio) {
+        *mmio = value;
+        return;
+    }
+
+    outl(PCI_CONFIG_ADDRESS, pci_cfg_address(bus, devfn, reg));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+static void pci_add_device(uint8_t bus, uint8_t devfn, uint32_t id)
+{
+    struct pci_device *dev;
+    uint32_t class_rev;
+    uint32_t num_bars;
+
+    if (pci_num_devices >= PCI_MAX_DEVICES) {
+        printf("PCI: device table full, ignoring %02x:%02x.%x\n", bus, PCI_SLOT(devfn), PCI_FUNC(devfn));
+        return;
+    }
+
+    dev = &pci_devices[pci_num_devices++];
+    memset(dev, 0, sizeof(*dev));
+
+    class_rev = pci_cfg_read32(bus, devfn, PCI_CLASS_REVISION);
+
+    dev->bus = bus;
+    dev->devfn = devfn;
+    dev->vendor_id = (uint16_t)id;
+    dev->device_id = (uint16_t)(id >> 16);
+    dev->class_code = (uint8_t)(class_rev >> 24);
+    dev->subclass = (uint8_t)(class_rev >> 16);
+    dev->prog_if = (uint8_t)(class_rev >> 8);
+    dev->header_type = pci_cfg_read8(bus, devfn, PCI_HEADER_TYPE) & PCI_HEADER_TYPE_MASK;
+
+    num_bars = (dev->header_type == PCI_HEADER_TYPE_BRIDGE) ? 2 : PCI_NUM_BARS;
+    for (uint32_t i = 0; i < num_bars; i++)
+        dev->bar[i] = pci_cfg_read32(bus, devfn, PCI_BASE_ADDRESS_0 + i * 4);
+
+    if (dev->header_type == PCI_HEADER_TYPE_BRIDGE) {
+        dev->rom_bar = pci_cfg_read32(bus, devfn, PCI_ROM_ADDRESS1);
+        dev->secondary_bus = pci_cfg_read8(bus, devfn, PCI_SECONDARY_BUS);
+    } else {
+        dev->rom_bar = pci_cfg_read32(bus, devfn, PCI_ROM_ADDRESS);
+    }
+}
+
+/*
+ * Walk the hierarchy from bus 0, following PCI-to-PCI bridges instead of
+ * probing all 256 buses. The bus numbers were assigned by the firmware.
+ */
+int pci_scan(void)
+{
+    uint8_t pending[PCI_MAX_BUSES];
+    uint8_t seen[PCI_MAX_BUSES / 8];
+    uint32_t head = 0, tail = 0;
+
+    pci_num_devices = 0;
+    memset(seen, 0, sizeof(seen));
+
+    pending[tail++] = 0;
+    seen[0] |= 1;
+
+    while (head < tail) {
+        uint8_t bus = pending[head++];
+
+        for (uint8_t dev = 0; dev < 32; dev++) {
+            uint8_t num_funcs = 1;
+
+            for (uint8_t fn = 0; fn < num_funcs; fn++) {
+                uint8_t devfn = PCI_DEVFN(dev, fn);
+                uint32_t id = pci_cfg_read32(bus, devfn, PCI_VENDOR_ID);
+                uint32_t first = pci_num_devices;
+
+                if ((id & 0xFFFF) == 0xFFFF || (id & 0xFFFF) == 0x0000)
+                    continue;
+
+                if (fn == 0 && (pci_cfg_read8(bus, devfn, PCI_HEADER_TYPE) & PCI_HEADER_MULTI_FUNC))
+                    num_funcs = 8;
+
+                pci_add_device(bus, devfn, id);
+                if (pci_num_devices == first)
+                    continue;
+
+                uint8_t secondary = pci_devices[first].secondary_bus;
+                if (pci_devices[first].header_type == PCI_HEADER_TYPE_BRIDGE &&
+                    secondary != 0 && !(seen[secondary / 8] & (1 << (secondary % 8)))) {
+                    seen[secondary / 8] |= 1 << (secondary % 8);
+                    pending[tail++] = secondary;
+                }
+            }
+        }
+    }
+
+    return (int)pci_num_devices;
+}
+
+uint32_t pci_device_count(void)
+{
+    return pci_num_devices;
+}
+
+struct pci_device *pci_get_device(uint32_t index)
+{
+    if (index >= pci_num_devices)
+        return NULL;
+
+    return &pci_devices[index];
+}
+
+/*
+ * Find the next cached device with the given class after `from` (or from the
+ * start if `from` is NULL). A subclass of 0xFF matches any subclass.
+ */
+struct pci_device *pci_find_class(uint8_t class_code, uint8_t subclass, struct pci_device *from)
+{
+    uint32_t i = from ? (uint32_t)(from - pci_devices) + 1 : 0;
+
+    for (; i < pci_num_devices; i++) {
+        if (pci_devices[i].class_code == class_code &&
+            (subclass == 0xFF || pci_devices[i].subclass == subclass))
+            return &pci_devices[i];
+    }
+
+    return NULL;
+}
+
+void pci_dump(void)
+{
+    for (uint32_t i = 0; i < pci_num_devices; i++) {
+        struct pci_device *dev = &pci_devices[i];
+
+        printf("PCI: %02x:%02x.%x %04x:%04x class %02x%02x%02x rom %08x\n",
+               dev->bus, PCI_SLOT(dev->devfn), PCI_FUNC(dev->devfn),
+               dev->vendor_id, dev->device_id,
+               dev->class_code, dev->subclass, dev->prog_if,
+               dev->rom_bar);
+    }
+}
+
+/*
+ * Compare config read throughput of port I/O and ECAM by reading the ID
+ * register of every cached device until PCI_BENCH_READS reads are done.
+ * Enabled with `pcibench` on the command line.
+ */
+void pci_bench(void)
+{
+    uint32_t reads = 0;
+    uint64_t start;
+    uint32_t io_cycles, ecam_cycles = 0;
+
+    if (pci_num_devices == 0)
+        return;
+
+    start = rdtsc();
+    while (reads < PCI_BENCH_READS) {
+        struct pci_device *dev = &pci_devices[reads % pci_num_devices];
+        pci_io_read32(dev->bus, dev->devfn, PCI_VENDOR_ID);
+        reads++;
+    }
+    io_cycles = (uint32_t)(rdtsc() - start);
+
+    printf("PCIBENCH: io %u cycles/read\n", io_cycles / PCI_BENCH_READS);
+
+    if (ecam.base == 0)
+        return;
+
+    reads = 0;
+    start = rdtsc();
+    while (reads < PCI_BENCH_READS) {
+        struct pci_device *dev = &pci_devices[reads % pci_num_devices];
+        pci_cfg_read32(dev->bus, dev->devfn, PCI_VENDOR_ID);
+        reads++;
+    }
+    ecam_cycles = (uint32_t)(rdtsc() - start);
+
+    printf("PCIBENCH: ecam %u cycles/read\n", ecam_cycles / PCI_BENCH_READS);
+}
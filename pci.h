@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for PCI configuration access and the device cache.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#define PCI_CONFIG_ADDRESS      0xCF8
+#define PCI_CONFIG_DATA         0xCFC
+
+#define PCI_ECAM_BUS_SHIFT      20
+#define PCI_ECAM_DEVFN_SHIFT    12
+
+#define PCI_BENCH_READS         4096
+
+#define PCI_DEVFN(dev, fn)      ((uint8_t)(((dev) << 3) | (fn)))
+#define PCI_SLOT(devfn)         (((devfn) >> 3) & 0x1F)
+#define PCI_FUNC(devfn)         ((devfn) & 0x07)
+
+/* Configuration space registers */
+#define PCI_VENDOR_ID           0x00
+#define PCI_DEVICE_ID           0x02
+#define PCI_COMMAND             0x04
+#define PCI_CLASS_REVISION      0x08
+#define PCI_HEADER_TYPE         0x0E
+#define PCI_BASE_ADDRESS_0      0x10
+#define PCI_PRIMARY_BUS         0x18
+#define PCI_SECONDARY_BUS       0x19
+#define PCI_ROM_ADDRESS         0x30
+#define PCI_ROM_ADDRESS1        0x38 /* Type 1 header */
+
+#define PCI_HEADER_TYPE_MASK    0x7F
+#define PCI_HEADER_TYPE_NORMAL  0x00
+#define PCI_HEADER_TYPE_BRIDGE  0x01
+#define PCI_HEADER_MULTI_FUNC   0x80
+
+#define PCI_CLASS_STORAGE       0x01
+#define PCI_CLASS_DISPLAY       0x03
+#define PCI_CLASS_BRIDGE        0x06
+
+#define PCI_SUBCLASS_STORAGE_IDE    0x01
+#define PCI_SUBCLASS_STORAGE_SATA   0x06
+#define PCI_SUBCLASS_DISPLAY_VGA    0x00
+#define PCI_SUBCLASS_BRIDGE_PCI     0x04
+
+#define PCI_MAX_BUSES           256
+#define PCI_MAX_DEVICES         64
+#define PCI_NUM_BARS            6
+
+struct pci_device {
+    uint8_t     bus;
+    uint8_t     devfn;
+    uint16_t    vendor_id;
+    uint16_t    device_id;
+    uint8_t     class_code;
+    uint8_t     subclass;
+    uint8_t     prog_if;
+    uint8_t     header_type;
+    uint8_t     secondary_bus; /* Bridges only */
+    uint32_t    bar[PCI_NUM_BARS];
+    uint32_t    rom_bar;
+};
+
+/* Functions */
+extern boolean_t pci_ecam_init(void);
+extern void pci_bench(void);
+extern uint32_t pci_cfg_read32(uint8_t bus, uint8_t devfn, uint16_t reg);
+extern uint16_t pci_cfg_read16(uint8_t bus, uint8_t devfn, uint16_t reg);
+extern uint8_t pci_cfg_read8(uint8_t bus, uint8_t devfn, uint16_t reg);
+extern void pci_cfg_write32(uint8_t bus, uint8_t devfn, uint16_t reg, uint32_t value);
+
+extern int pci_scan(void);
+extern uint32_t pci_device_count(void);
+extern struct pci_device *pci_get_device(uint32_t index);
+extern struct pci_device *pci_find_class(uint8_t class_code, uint8_t subclass, struct pci_device *from);
+extern void pci_dump(void);
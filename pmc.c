@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Count P6 family hardware events per boot stage and per thunk call.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "cpu.h"
+#include "pmc.h"
+
+/*
+ * Only two general purpose counters exist, so events are picked in pairs.
+ * BUS_TRAN_ANY minus BUS_TRAN_BURST is the number of partial (uncached or
+ * write combined) bus transactions.
+ */
+static const pmc_group_t pmc_groups[] =
+{
+    { "bus",   { P6_EVENT_BUS_TRAN_ANY, P6_EVENT_BUS_TRAN_BURST },  { "bus_tran", "bus_burst" } },
+    { "cache", { P6_EVENT_L2_LINES_IN, P6_EVENT_DCU_LINES_IN },     { "l2_lines_in", "dcu_lines_in" } },
+    { "tlb",   { P6_EVENT_ITLB_MISS, P6_EVENT_IFU_MEM_STALL },      { "itlb_miss", "ifu_stall" } },
+    { "ipc",   { P6_EVENT_INST_RETIRED, P6_EVENT_DATA_MEM_REFS },   { "inst_retired", "mem_refs" } },
+};
+
+static const pmc_group_t    *pmc_group;
+static pmc_sample_t         thunk_start;
+static pmc_sample_t         thunk_total;
+static uint32_t             thunk_calls;
+
+boolean_t pmc_enabled(void)
+{
+    return pmc_group != NULL;
+}
+
+const char *pmc_label(uint32_t counter)
+{
+    return pmc_group ? pmc_group->label[counter] : "";
+}
+
+void pmc_read(pmc_sample_t *sample)
+{
+    sample->count[0] = rdmsr(MSR_P6_PERFCTR0) & PMC_COUNTER_MASK;
+    sample->count[1] = rdmsr(MSR_P6_PERFCTR1) & PMC_COUNTER_MASK;
+}
+
+/*
+ * pmc[=<group>]: count one of the event pairs above in both rings from now
+ * on. Runs before timing_init so the first mark already has counts; it
+ * prints nothing since the console is not up yet.
+ */
+boolean_t pmc_init(void)
+{
+    char name[16];
+    uint32_t eax, ebx, ecx, edx;
+
+    if (!cmdline_has("pmc"))
+        return false;
+
+    if (!cmdline_get("pmc", name, sizeof(name)) || !name[0])
+        strcpy(name, PMC_DEFAULT_GROUP);
+
+    // Architectural family 6 counters; Intel only.
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (ebx != 0x756E6547)  /* "Genu" */
+        return false;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (((eax >> 8) & 0xF) != 6)
+        return false;
+
+    for (uint32_t i = 0; i < sizeof(pmc_groups) / sizeof(pmc_groups[0]); i++) {
+        if (!strcmp(name, pmc_groups[i].name))
+            pmc_group = &pmc_groups[i];
+    }
+    if (pmc_group == NULL)
+        return false;
+
+    wrmsr(MSR_P6_EVNTSEL0, 0);
+    wrmsr(MSR_P6_PERFCTR0, 0);
+    wrmsr(MSR_P6_PERFCTR1, 0);
+    wrmsr(MSR_P6_EVNTSEL1, pmc_group->event[1] | P6_EVNTSEL_USR | P6_EVNTSEL_OS);
+    wrmsr(MSR_P6_EVNTSEL0, pmc_group->event[0] | P6_EVNTSEL_USR | P6_EVNTSEL_OS | P6_EVNTSEL_EN);
+    return true;
+}
+
+/* Bracket AsmThunk16, i.e. everything the CSM and the option ROMs do */
+void pmc_thunk_begin(void)
+{
+    if (pmc_group)
+        pmc_read(&thunk_start);
+}
+
+void pmc_thunk_end(void)
+{
+    pmc_sample_t now;
+
+    if (!pmc_group)
+        return;
+
+    pmc_read(&now);
+    for (uint32_t i = 0; i < PMC_COUNTERS; i++)
+        thunk_total.count[i] += (now.count[i] - thunk_start.count[i]) & PMC_COUNTER_MASK;
+    thunk_calls++;
+}
+
+uint32_t pmc_thunk_totals(pmc_sample_t *total)
+{
+    *total = thunk_total;
+    return thunk_calls;
+}
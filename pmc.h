@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for P6 family performance counter instrumentation.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#define MSR_P6_EVNTSEL0         0x186
+#define MSR_P6_EVNTSEL1         0x187
+#define MSR_P6_PERFCTR0         0x0C1
+#define MSR_P6_PERFCTR1         0x0C2
+
+#define P6_EVNTSEL_USR          (1 << 16)
+#define P6_EVNTSEL_OS           (1 << 17)
+#define P6_EVNTSEL_EN           (1 << 22)   /* EVNTSEL0 only, starts both counters */
+
+/* The counters are 40 bits wide */
+#define PMC_COUNTERS            2
+#define PMC_COUNTER_MASK        0xFFFFFFFFFFULL
+
+/* P6 family (and Pentium M) events */
+#define P6_EVENT_L2_LINES_IN    0x24
+#define P6_EVENT_DATA_MEM_REFS  0x43
+#define P6_EVENT_DCU_LINES_IN   0x45
+#define P6_EVENT_BUS_TRAN_BURST 0x6E
+#define P6_EVENT_BUS_TRAN_ANY   0x70
+#define P6_EVENT_ITLB_MISS      0x85
+#define P6_EVENT_IFU_MEM_STALL  0x86
+#define P6_EVENT_INST_RETIRED   0xC0
+
+#define PMC_DEFAULT_GROUP       "bus"
+
+/* A pair of events counted together, selected with pmc=<name> */
+typedef struct _pmc_group_t
+{
+    const char  *name;
+    uint8_t     event[PMC_COUNTERS];
+    const char  *label[PMC_COUNTERS];
+} pmc_group_t;
+
+typedef struct _pmc_sample_t
+{
+    uint64_t    count[PMC_COUNTERS];
+} pmc_sample_t;
+
+/* Functions */
+extern boolean_t pmc_init(void);
+extern boolean_t pmc_enabled(void);
+extern void pmc_read(pmc_sample_t *sample);
+extern const char *pmc_label(uint32_t counter);
+extern void pmc_thunk_begin(void);
+extern void pmc_thunk_end(void);
+extern uint32_t pmc_thunk_totals(pmc_sample_t *total);
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Sample where real mode code spends its time after Legacy16Boot.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "cpu.h"
+#include "lowmem.h"
+#include "profile.h"
+#include "rmhook.h"
+
+/* Prof16.nasm */
+extern const uint8_t  mProf16Start;
+extern const uint16_t mProf16Size;
+extern const uint16_t mProf16Old;
+extern const uint16_t mProf16HistSeg;
+
+static prof_hist_t *prof_hist;
+
+/*
+ * profile[=<divider>]: run the PIT <divider> times faster (a power of two,
+ * 16 by default, so ~291 Hz) and sample the interrupted CS:IP on every tick.
+ * Must run after Legacy16PrepareToBoot, once the CSM owns IRQ 0.
+ */
+int profile_install(struct csmwrap_priv *priv)
+{
+    uint32_t divider;
+    uint32_t count;
+    uint8_t *shim;
+
+    if (!cmdline_has("profile"))
+        return 0;
+
+    divider = cmdline_get_uint("profile", PROF_DEFAULT_DIVIDER);
+    if (divider == 0 || divider > PROF_MAX_DIVIDER || (divider & (divider - 1))) {
+        printf("PROFILE: divider must be a power of two up to %d\n", PROF_MAX_DIVIDER);
+        divider = PROF_DEFAULT_DIVIDER;
+    }
+
+    prof_hist = (prof_hist_t *)lowmem_csm_alloc(priv, LEGACY16_REGION_ANY, sizeof(prof_hist_t), 16);
+    if (prof_hist == NULL)
+        return -1;
+
+    memset(prof_hist, 0, sizeof(prof_hist_t));
+    prof_hist->signature = PROF_SIGNATURE;
+    prof_hist->divider = (uint16_t)divider;
+    prof_hist->countdown = (uint16_t)divider;
+    prof_hist->csm_base = (uint32_t)priv->csm_bin_base;
+
+    shim = rmhook_place(priv, &mProf16Start, mProf16Size);
+    if (shim == NULL)
+        return -1;
+
+    *(uint32_t *)(shim + mProf16Old) = rmhook_get_vector(0x08);
+    *(uint16_t *)(shim + mProf16HistSeg) = RMHOOK_SEGMENT(prof_hist);
+    rmhook_set_vector(0x08, RM_FARPTR(RMHOOK_SEGMENT(shim), 0));
+
+    // Mode 3, lobyte/hibyte. A count of 0 means 65536.
+    count = 0x10000 / divider;
+    outb(PIT_CMD, 0x36);
+    outb(PIT_CH0, count & 0xFF);
+    outb(PIT_CH0, (count >> 8) & 0xFF);
+
+    printf("PROFILE: sampling at %d Hz into %x\n", PIT_HZ / (count ? count : 0x10000),
+           (uint32_t)(uintptr_t)prof_hist);
+    return 0;
+}
+
+/*
+ * The histogram survives a warm reboot, so this is called from the warm
+ * reboot path. tools/rmdump.c prints it from a memory dump instead.
+ */
+void profile_dump(void)
+{
+    if (prof_hist != NULL)
+        profile_print_hist(prof_hist);
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the real mode CS:IP sampling profiler.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#define PROF_SIGNATURE          0x46525042  /* "BPRF" */
+#define PROF_DEFAULT_DIVIDER    16
+#define PROF_MAX_DIVIDER        256
+#define PROF_TOP                24
+
+/* Must match Prof16.nasm */
+#define PROF_LOW_SHIFT          12
+#define PROF_LOW_BUCKETS        (0xA0000 >> PROF_LOW_SHIFT)
+#define PROF_ROM_BASE           0xC0000
+#define PROF_ROM_SHIFT          6
+#define PROF_ROM_BUCKETS        ((0x100000 - PROF_ROM_BASE) >> PROF_ROM_SHIFT)
+
+#define PIT_HZ                  1193182
+#define PIT_CH0                 0x40
+#define PIT_CMD                 0x43
+
+#pragma pack(1)
+typedef struct _prof_hist_t
+{
+    uint32_t    signature;
+    uint32_t    samples;
+    uint16_t    divider;    /* PIT ticks per BIOS tick */
+    uint16_t    countdown;
+    uint32_t    csm_base;   /* Where Csm16 was copied, for the dump */
+    uint16_t    other;      /* Video memory, HMA */
+    uint16_t    reserved2[7];
+    uint16_t    low[PROF_LOW_BUCKETS];
+    uint16_t    rom[PROF_ROM_BUCKETS];
+} prof_hist_t;
+#pragma pack()
+
+/* Functions */
+extern int profile_install(struct csmwrap_priv *priv);
+extern void profile_dump(void);
+extern void profile_print_hist(const prof_hist_t *hist);
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Print the real mode profile histogram. Touches no hardware, so
+ *          it also builds on the host (see tools/rmdump.c).
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "profile.h"
+
+/* Name the image an address in the ROM window belongs to */
+static void print_location(const prof_hist_t *hist, uint32_t addr)
+{
+    if (addr >= VGABIOS_START && addr < VGABIOS_END)
+        printf("vgabios+%05x", addr - VGABIOS_START);
+    else if (addr >= hist->csm_base && addr < BIOSROM_END)
+        printf("csm16+%05x  ", addr - hist->csm_base);
+    else
+        printf("%05x        ", addr);
+}
+
+/*
+ * Print the hottest buckets. Offsets into vgabios and csm16 can be looked up
+ * in the map files of the respective ROM builds.
+ */
+void profile_print_hist(const prof_hist_t *hist)
+{
+    uint32_t total;
+    uint32_t shown = 0;
+    uint32_t last = 0xFFFFFFFF;
+
+    if (hist->signature != PROF_SIGNATURE)
+        return;
+
+    total = hist->samples;
+    printf("PROFILE: %d samples, %d outside conventional memory and ROMs\n", total, hist->other);
+    if (total == 0)
+        return;
+
+    // Repeatedly pick the largest bucket below the previous one.
+    while (shown < PROF_TOP) {
+        uint32_t best = 0;
+
+        for (uint32_t i = 0; i < PROF_LOW_BUCKETS; i++)
+            if (hist->low[i] > best && hist->low[i] < last)
+                best = hist->low[i];
+        for (uint32_t i = 0; i < PROF_ROM_BUCKETS; i++)
+            if (hist->rom[i] > best && hist->rom[i] < last)
+                best = hist->rom[i];
+
+        if (best == 0)
+            break;
+
+        for (uint32_t i = 0; i < PROF_ROM_BUCKETS && shown < PROF_TOP; i++) {
+            if (hist->rom[i] != best)
+                continue;
+            printf("PROFILE: ");
+            print_location(hist, PROF_ROM_BASE + (i << PROF_ROM_SHIFT));
+            printf(" %6d %3d%%\n", best, best * 100 / total);
+            shown++;
+        }
+
+        for (uint32_t i = 0; i < PROF_LOW_BUCKETS && shown < PROF_TOP; i++) {
+            if (hist->low[i] != best)
+                continue;
+            printf("PROFILE: low %05x    %6d %3d%%\n", i << PROF_LOW_SHIFT, best, best * 100 / total);
+            shown++;
+        }
+
+        last = best;
+    }
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Install resident real mode code and hook IVT vectors.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "lowmem.h"
+#include "rmhook.h"
+
+/*
+ * Copy position independent real mode code into the F segment. The code
+ * addresses its own data relative to CS with IP = 0 at its first byte, so
+ * the copy starts on a paragraph. Returns the copy or NULL.
+ */
+uint8_t *rmhook_place(struct csmwrap_priv *priv, const void *code, uint16_t size)
+{
+    uint8_t *copy;
+
+    copy = (uint8_t *)lowmem_csm_alloc(priv, LEGACY16_REGION_F000, size, 16);
+    if (copy == NULL)
+        return NULL;
+
+    memcpy(copy, code, size);
+    return copy;
+}
+
+uint32_t rmhook_get_vector(uint8_t vector)
+{
+    return ((volatile uint32_t *)0)[vector];
+}
+
+void rmhook_set_vector(uint8_t vector, uint32_t farptr)
+{
+    ((volatile uint32_t *)0)[vector] = farptr;
+}
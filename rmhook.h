@@ -0,0 +1,19 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for resident real mode hooks.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+/* Real mode far pointer (segment:offset) as stored in the IVT */
+#define RM_FARPTR(seg, off)     (((uint32_t)(seg) << 16) | (uint16_t)(off))
+#define RM_FARPTR_FLAT(fp)      ((((fp) >> 16) << 4) + ((fp) & 0xFFFF))
+
+/* Hook code is entered with IP = 0 at the start of the copy */
+#define RMHOOK_SEGMENT(code)    ((uint16_t)((uintptr_t)(code) >> 4))
+
+/* Functions */
+extern uint8_t *rmhook_place(struct csmwrap_priv *priv, const void *code, uint16_t size);
+extern uint32_t rmhook_get_vector(uint8_t vector);
+extern void rmhook_set_vector(uint8_t vector, uint32_t farptr);
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Serve real mode BIOS interrupts from 32-bit C code.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "rmhook.h"
+#include "rthunk.h"
+
+/* RThunk16.nasm */
+extern const uint8_t  mRThunk16Start;
+extern const uint16_t mRThunk16Size;
+extern const uint16_t mRThunk16Filter;
+extern const uint16_t mRThunk16Old;
+extern const uint16_t mRThunk16V86Calls;
+extern const uint16_t mRThunk16Handler;
+extern const uint16_t mRThunk16Code16;
+extern const uint16_t mRThunk16Gdtr;
+extern const uint16_t mRThunk16RealSeg;
+extern const uint16_t mRThunk16Target;
+extern const uint16_t mRThunkGdtOffset;
+extern void RThunk32(void);
+
+static struct
+{
+    uint8_t     vector;
+    uint8_t     *copy;
+} hooks[RTHUNK_MAX_HOOKS];
+static uint32_t num_hooks;
+
+/*
+ * Forget every hook. The copies live in memory that legacy16_boot hands
+ * back to the CSM, so this must run before the hooks are installed again
+ * on a warm reboot.
+ */
+void rthunk_reset(void)
+{
+    num_hooks = 0;
+}
+
+/*
+ * Hook `vector` so that calls with AH in `functions` go to `handler`, in
+ * flat protected mode on a private stack with interrupts disabled. Calls
+ * with any other AH never leave real mode. The handler and everything it
+ * touches must stay resident; callers reserve the kernel image with
+ * e820_reserve_kernel.
+ */
+int rthunk_hook(struct csmwrap_priv *priv, uint8_t vector, const uint8_t *functions,
+                uint32_t count, rthunk_handler_t handler)
+{
+    uint8_t *copy;
+    uint8_t *code16;
+    uint32_t base;
+
+    if (num_hooks >= RTHUNK_MAX_HOOKS)
+        return -1;
+
+    copy = rmhook_place(priv, &mRThunk16Start, mRThunk16Size);
+    if (copy == NULL)
+        return -1;
+
+    base = (uint32_t)(uintptr_t)copy;
+
+    for (uint32_t i = 0; i < count; i++)
+        copy[mRThunk16Filter + (functions[i] >> 3)] |= 1 << (functions[i] & 7);
+
+    *(uint32_t *)(copy + mRThunk16Old) = rmhook_get_vector(vector);
+    *(uint32_t *)(copy + mRThunk16Handler) = (uint32_t)(uintptr_t)handler;
+    *(uint32_t *)(copy + mRThunk16Target) = (uint32_t)(uintptr_t)RThunk32;
+    *(uint32_t *)(copy + mRThunk16Gdtr + 2) = base + mRThunkGdtOffset;
+    *(uint16_t *)(copy + mRThunk16RealSeg) = RMHOOK_SEGMENT(copy);
+
+    // Base of the 16-bit code segment used on the way back.
+    code16 = copy + mRThunk16Code16;
+    code16[2] = (uint8_t)base;
+    code16[3] = (uint8_t)(base >> 8);
+    code16[4] = (uint8_t)(base >> 16);
+
+    rmhook_set_vector(vector, RM_FARPTR(RMHOOK_SEGMENT(copy), 0));
+
+    hooks[num_hooks].vector = vector;
+    hooks[num_hooks].copy = copy;
+    num_hooks++;
+    return 0;
+}
+
+/*
+ * Calls to `vector` that arrived in V86 mode (EMM386, QEMM, a Windows DOS
+ * box) and went to the original handler without us seeing them.
+ */
+uint32_t rthunk_v86_calls(uint8_t vector)
+{
+    for (uint32_t i = 0; i < num_hooks; i++) {
+        if (hooks[i].vector == vector)
+            return *(volatile uint32_t *)(hooks[i].copy + mRThunk16V86Calls);
+    }
+
+    return 0;
+}
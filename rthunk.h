@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for real mode to protected mode reverse thunks.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+/* Handler return values, must match RThunk16.nasm */
+#define RTHUNK_DONE             0   /* Return to the caller with the frame */
+#define RTHUNK_CHAIN            1   /* Pass the call on to the original handler */
+#define RTHUNK_CHAIN_POST       2   /* Same, then call the handler again with phase 1 */
+
+/* Vectors hooked at the same time */
+#define RTHUNK_MAX_HOOKS        4
+
+#define RTHUNK_FLAG_CF          (1 << 0)
+#define RTHUNK_FLAG_ZF          (1 << 6)
+
+/* Register frame on the real mode caller's stack, see RThunk16.nasm */
+#pragma pack(1)
+typedef struct _rthunk_regs_t
+{
+    uint32_t    edi;
+    uint32_t    esi;
+    uint32_t    ebp;
+    uint32_t    esp;
+    uint32_t    ebx;
+    uint32_t    edx;
+    uint32_t    ecx;
+    uint32_t    eax;
+    uint16_t    phase;
+    uint16_t    gs;
+    uint16_t    fs;
+    uint16_t    es;
+    uint16_t    ds;
+    /* Pushed by INT */
+    uint16_t    ip;
+    uint16_t    cs;
+    uint16_t    flags;
+} rthunk_regs_t;
+#pragma pack()
+
+#define RTHUNK_AH(regs)         ((uint8_t)((regs)->eax >> 8))
+#define RTHUNK_AL(regs)         ((uint8_t)(regs)->eax)
+#define RTHUNK_BH(regs)         ((uint8_t)((regs)->ebx >> 8))
+#define RTHUNK_BL(regs)         ((uint8_t)(regs)->ebx)
+#define RTHUNK_CH(regs)         ((uint8_t)((regs)->ecx >> 8))
+#define RTHUNK_CL(regs)         ((uint8_t)(regs)->ecx)
+#define RTHUNK_DH(regs)         ((uint8_t)((regs)->edx >> 8))
+#define RTHUNK_DL(regs)         ((uint8_t)(regs)->edx)
+#define RTHUNK_SET_AH(regs, v)  ((regs)->eax = ((regs)->eax & ~0xFF00) | ((uint32_t)(uint8_t)(v) << 8))
+#define RTHUNK_SET_AL(regs, v)  ((regs)->eax = ((regs)->eax & ~0xFF) | (uint8_t)(v))
+
+/* Flat address of a real mode segment:offset */
+#define RTHUNK_FLAT(seg, off)   ((void *)(((uintptr_t)(seg) << 4) + (uint16_t)(off)))
+
+typedef uint32_t (*rthunk_handler_t)(rthunk_regs_t *regs);
+
+/* Functions */
+extern int rthunk_hook(struct csmwrap_priv *priv, uint8_t vector, const uint8_t *functions,
+                       uint32_t count, rthunk_handler_t handler);
+extern uint32_t rthunk_v86_calls(uint8_t vector);
+extern void rthunk_reset(void);
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Polled 16550 UART and QEMU/Bochs debugcon console backends.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "cpu.h"
+
+/* 16550 registers, relative to the base port */
+#define UART_THR        0   /* Transmit holding (DLAB=0) */
+#define UART_DLL        0   /* Divisor latch low (DLAB=1) */
+#define UART_IER        1   /* Interrupt enable (DLAB=0) */
+#define UART_DLM        1   /* Divisor latch high (DLAB=1) */
+#define UART_FCR        2
+#define UART_LCR        3
+#define UART_MCR        4
+#define UART_LSR        5
+#define UART_SCR        7
+
+#define UART_LCR_8N1    0x03
+#define UART_LCR_DLAB   0x80
+#define UART_LSR_THRE   0x20
+#define UART_CLOCK      115200
+
+/* Give up on a stuck transmitter instead of hanging the boot. */
+#define UART_TX_TIMEOUT 100000
+
+static uint16_t serial_port = SERIAL_DEFAULT_PORT;
+
+boolean_t debugcon_init(void)
+{
+    return true;
+}
+
+void debugcon_putc(void *p, char c)
+{
+    (void)(p); // Unused parameter.
+
+    outb(DEBUGCON_PORT, c);
+}
+
+/*
+ * Configure the UART from `serial=<port>[,<baud>]`, defaulting to COM1 at
+ * 115200 8N1. Interrupts stay off; output is polled.
+ */
+boolean_t serial_init(void)
+{
+    char arg[32];
+    uint32_t port = SERIAL_DEFAULT_PORT;
+    uint32_t baud = SERIAL_DEFAULT_BAUD;
+    uint16_t divisor;
+
+    if (cmdline_get("serial", arg, sizeof(arg)) && arg[0]) {
+        const char *end;
+
+        if (parse_uint(arg, &port, &end) && *end == ',')
+            parse_uint(end + 1, &baud, NULL);
+    }
+
+    if (baud == 0 || baud > UART_CLOCK)
+        baud = SERIAL_DEFAULT_BAUD;
+
+    serial_port = (uint16_t)port;
+
+    // Scratch register round trip to see if there is a UART at all.
+    outb(serial_port + UART_SCR, 0x5A);
+    if (inb(serial_port + UART_SCR) != 0x5A)
+        return false;
+
+    divisor = (uint16_t)(UART_CLOCK / baud);
+
+    outb(serial_port + UART_IER, 0x00);
+    outb(serial_port + UART_LCR, UART_LCR_DLAB);
+    outb(serial_port + UART_DLL, divisor & 0xFF);
+    outb(serial_port + UART_DLM, divisor >> 8);
+    outb(serial_port + UART_LCR, UART_LCR_8N1);
+    outb(serial_port + UART_FCR, 0x07); // Enable and clear FIFOs
+    outb(serial_port + UART_MCR, 0x03); // DTR + RTS
+
+    return true;
+}
+
+static void serial_tx(char c)
+{
+    uint32_t timeout = UART_TX_TIMEOUT;
+
+    while (!(inb(serial_port + UART_LSR) & UART_LSR_THRE) && --timeout)
+        ;
+
+    outb(serial_port + UART_THR, c);
+}
+
+void serial_putc(void *p, char c)
+{
+    (void)(p); // Unused parameter.
+
+    if (c == '\n')
+        serial_tx('\r');
+    serial_tx(c);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Hand the firmware's SMBIOS table to the CSM.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+
+int set_smbios_table(struct csmwrap_priv *priv)
+{
+    int i;
+    efi_guid_t smbiosGuid = SMBIOS_TABLE_GUID;
+    efi_guid_t smbios3Guid = SMBIOS3_TABLE_GUID;
+    boolean_t found = false;
+    uintptr_t table_addr = 0;
+
+    efi_system_table_t *sys_tbl = (efi_system_table_t *) gBA->efi_sys_tbl;
+
+    for (i = 0; i < sys_tbl->NumberOfTableEntries; i++) {
+        efi_configuration_table_t *table;
+        table = sys_tbl->ConfigurationTable + i;
+
+        if (!efi_guidcmp(table->VendorGuid, smbiosGuid)) {
+            log_debug("Found SMBIOS Table at %lx\n", (uintptr_t)table->VendorTable);
+            table_addr = (uintptr_t)table->VendorTable;
+            found = true;
+            break;
+        }
+
+        if (!efi_guidcmp(table->VendorGuid, smbios3Guid)) {
+            log_debug("Found SMBIOS 3.0 Table at %lx\n", (uintptr_t)table->VendorTable);
+            table_addr = (uintptr_t)table->VendorTable;
+            found = true;
+            break;
+        }
+    }
+
+    if (found) {
+        if (table_addr > 0xffffffff) {
+            log_warn("SMBIOS table address too high\n");
+            return -1;
+        }
+        priv->low_stub->boot_table.SmbiosTable = table_addr;
+        return 0;
+    }
+
+    log_warn("No SMBIOS table found\n");
+
+    return -1;
+}
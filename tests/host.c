@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: libc shim for the host tests and tools.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "host.h"
+
+/* From tinyprintf.h, which needs our types.h */
+extern void init_printf(void *putp, void (*putf)(void *, char));
+
+void host_putc(void *p, char c)
+{
+    (void)p;
+    putchar(c);
+}
+
+/* Route printf (tfp_printf in our code) to stdout. */
+void host_init(void)
+{
+    init_printf(NULL, host_putc);
+}
+
+void host_exit(int status)
+{
+    fflush(stdout);
+    exit(status);
+}
+
+unsigned long long host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void *host_alloc(unsigned long size)
+{
+    void *ptr = calloc(1, size);
+
+    if (ptr == NULL) {
+        fprintf(stderr, "out of memory (%lu bytes)\n", size);
+        exit(2);
+    }
+
+    return ptr;
+}
+
+void host_free(void *ptr)
+{
+    free(ptr);
+}
+
+int host_write_file(const char *path, const void *data, unsigned long size)
+{
+    FILE *f = fopen(path, "wb");
+    int ok;
+
+    if (f == NULL)
+        return -1;
+    ok = fwrite(data, 1, size, f) == size;
+    return (fclose(f) == 0 && ok) ? 0 : -1;
+}
+
+/* The whole file, NUL terminated, or NULL */
+char *host_read_file(const char *path, unsigned long *size)
+{
+    FILE *f = fopen(path, "rb");
+    char *data = NULL;
+    long len;
+
+    if (f == NULL)
+        return NULL;
+
+    if (fseek(f, 0, SEEK_END) == 0 && (len = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = host_alloc(len + 1);
+        if (fread(data, 1, len, f) != (size_t)len) {
+            free(data);
+            data = NULL;
+        } else if (size != NULL) {
+            *size = len;
+        }
+    }
+
+    fclose(f);
+    return data;
+}
+
+#define HOST_PAGE_SIZE      4096
+#define HOST_PAGES          (1ul << (32 - 12))
+
+/* Pages host_map_at has mapped, so blocks can share them */
+static unsigned char mapped[HOST_PAGES / 8];
+
+/*
+ * Make [addr, addr + size) of the 32-bit address space usable at exactly
+ * that address, zero filled. Returns NULL if any of it is taken by
+ * something else, e.g. the program itself or the C library.
+ */
+void *host_map_at(unsigned long addr, unsigned long size)
+{
+    unsigned long long first = addr / HOST_PAGE_SIZE;
+    unsigned long long end = ((unsigned long long)addr + size + HOST_PAGE_SIZE - 1) / HOST_PAGE_SIZE;
+
+    if (end > HOST_PAGES)
+        return NULL;
+
+    for (unsigned long long page = first; page < end; page++) {
+        void *want = (void *)(unsigned long)(page * HOST_PAGE_SIZE);
+        void *got;
+
+        if (mapped[page / 8] & (1 << (page % 8)))
+            continue;
+
+        // Kernels before 4.17 ignore MAP_FIXED_NOREPLACE and treat the
+        // address as a hint, so check where the page actually went.
+        got = mmap(want, HOST_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (got == MAP_FAILED)
+            return NULL;
+        if (got != want) {
+            munmap(got, HOST_PAGE_SIZE);
+            return NULL;
+        }
+        mapped[page / 8] |= 1 << (page % 8);
+    }
+
+    return (void *)addr;
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the libc shim used by the host tests and tools.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+/*
+ * Our types.h and the host's stdint.h disagree on what uint64_t is, so a
+ * translation unit includes one or the other, never both. Tests include
+ * our headers and reach libc through these functions, which only use
+ * plain C types. Everything else (memcpy, memset, ...) links against libc.
+ */
+
+/* Functions */
+extern void host_init(void);
+extern void host_putc(void *p, char c);
+extern void host_exit(int status);
+extern unsigned long long host_ns(void);
+extern void *host_alloc(unsigned long size);
+extern void host_free(void *ptr);
+extern int host_write_file(const char *path, const void *data, unsigned long size);
+extern char *host_read_file(const char *path, unsigned long *size);
+extern void *host_map_at(unsigned long addr, unsigned long size);
@@ -0,0 +1,118 @@
+#!/bin/sh
+#
+# Copyright (C) 2025 Sylas Hollander.
+# PURPOSE: Boot mach_kernel under QEMU through the multiboot loader and
+#          report how long it took.
+# SPDX-License-Identifier: MIT
+#
+# usage: boot.sh <loader.elf> <mach_kernel> [<FreeDOS disk image>]
+#
+# Without a disk image, the run ends when the TIMING: lines printed right
+# before Legacy16Boot are complete. With one, it ends when the line
+# $FREEDOS_MARKER shows up on COM1; add `echo CSMWRAPPLE-BOOT-OK > COM1` at
+# the end of the image's AUTOEXEC.BAT (or FDAUTO.BAT). The image is opened
+# with snapshot=on and never written. With EXITAT=<stage>, the kernel gets
+# exitat=<stage> and QEMU an isa-debug-exit device at port 0xF4, so the
+# run ends when QEMU exits after that stage.
+#
+# Environment: QEMU (qemu-system-i386), TIMEOUT (60 seconds), APPEND (extra
+# boot args), EXITAT, QEMU_ARGS (extra QEMU options), LOG_DIR (a temporary
+# directory, removed afterwards unless set).
+#
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 <loader.elf> <mach_kernel> [<FreeDOS disk image>]" >&2
+    exit 2
+fi
+
+LOADER=$1
+KERNEL=$2
+DISK=$3
+QEMU=${QEMU:-qemu-system-i386}
+TIMEOUT=${TIMEOUT:-60}
+FREEDOS_MARKER=${FREEDOS_MARKER:-CSMWRAPPLE-BOOT-OK}
+
+if [ -n "$LOG_DIR" ]; then
+    mkdir -p "$LOG_DIR" || exit 2
+    KEEP_LOGS=1
+else
+    LOG_DIR=$(mktemp -d) || exit 2
+fi
+DEBUG_LOG=$LOG_DIR/debugcon.log
+SERIAL_LOG=$LOG_DIR/serial.log
+: > "$DEBUG_LOG"
+: > "$SERIAL_LOG"
+
+# KVM when we may use it, TCG otherwise.
+if [ -w /dev/kvm ]; then
+    ACCEL="-accel kvm -cpu host"
+else
+    ACCEL="-accel tcg"
+fi
+
+set -- -m 256 -vga none -device bochs-display -display none -no-reboot \
+    -debugcon "file:$DEBUG_LOG" -serial "file:$SERIAL_LOG" -monitor none
+if [ -n "$DISK" ]; then
+    set -- "$@" -drive "file=$DISK,format=raw,if=ide,snapshot=on"
+fi
+if [ -n "$EXITAT" ]; then
+    # timing.h: TIMING_EXIT_PORT, written with 0, so QEMU exits with 1.
+    set -- "$@" -device isa-debug-exit,iobase=0xf4,iosize=0x04
+    APPEND="$APPEND exitat=$EXITAT"
+fi
+
+set -- -kernel "$LOADER" -initrd "$KERNEL" -append "console=debugcon $APPEND" "$@"
+
+start=$(date +%s%N)
+# shellcheck disable=SC2086 # ACCEL and QEMU_ARGS are lists of options
+$QEMU $ACCEL "$@" $QEMU_ARGS &
+qemu_pid=$!
+
+done_booting()
+{
+    if [ -n "$EXITAT" ]; then
+        return 1
+    elif [ -n "$DISK" ]; then
+        grep -q "$FREEDOS_MARKER" "$SERIAL_LOG"
+    else
+        grep -q "^TIMING: .* real mode calls" "$DEBUG_LOG"
+    fi
+}
+
+result=1
+while kill -0 $qemu_pid 2>/dev/null; do
+    if done_booting; then
+        result=0
+        break
+    fi
+    if [ $(( ($(date +%s%N) - start) / 1000000000 )) -ge "$TIMEOUT" ]; then
+        echo "boot: timed out after $TIMEOUT s" >&2
+        break
+    fi
+    sleep 0.05
+done
+elapsed_ms=$(( ($(date +%s%N) - start) / 1000000 ))
+kill $qemu_pid 2>/dev/null
+wait $qemu_pid
+status=$?
+if [ -n "$EXITAT" ] && [ $status -eq 1 ] && grep -q "^TIMING: exit at" "$DEBUG_LOG"; then
+    result=0
+fi
+
+# The ACPI/SMBIOS/framebuffer setup and the kernel's timeline.
+grep "^loader:" "$DEBUG_LOG"
+grep "^TIMING:" "$DEBUG_LOG"
+
+if [ $result -ne 0 ]; then
+    echo "boot: FAILED, last lines of $DEBUG_LOG:" >&2
+    tail -n 20 "$DEBUG_LOG" >&2
+elif [ -n "$EXITAT" ]; then
+    echo "boot: exited at $EXITAT after $elapsed_ms ms of wall time"
+elif [ -n "$DISK" ]; then
+    echo "boot: FreeDOS up after $elapsed_ms ms of wall time"
+else
+    echo "boot: Legacy16Boot reached after $elapsed_ms ms of wall time"
+fi
+
+[ -z "$KEEP_LOGS" ] && rm -rf "$LOG_DIR"
+exit $result
@@ -0,0 +1,567 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Multiboot loader that starts mach_kernel under QEMU the way
+ *          boot.efi starts it on the Apple TV.
+ * SPDX-License-Identifier: MIT
+*/
+
+/*
+ * QEMU loads this with -kernel and mach_kernel (or the ELF build) with
+ * -initrd. SeaBIOS has already run by then, so the loader only has to turn
+ * what it left behind into what boot.efi hands over: an EFI memory map, a
+ * system table whose configuration table points at the ACPI and SMBIOS
+ * tables, and a linear framebuffer, programmed here on QEMU's Bochs display
+ * device. Everything SeaBIOS keeps in the legacy region is copied out of
+ * it first, since mach_kernel puts the CSM there.
+ */
+
+#include "csmwrapple.h"
+#include "cpu.h"
+#include "pci.h"
+#include "loader.h"
+
+/* Firmware tables, reported as runtime services data so nobody reuses them */
+typedef struct _loader_runtime_t
+{
+    efi_system_table_t          st;
+    efi_configuration_table_t   config[LOADER_MAX_CONFIG_TABLES];
+    uint8_t                     rsdp[36];
+    uint8_t                     smbios_eps[32];
+    uint8_t                     smbios[LOADER_SMBIOS_MAX];
+} loader_runtime_t;
+
+typedef struct _loader_claim_t
+{
+    uint64_t    start;
+    uint64_t    end;
+    uint32_t    type;
+} loader_claim_t;
+
+typedef struct _loader_kernel_t
+{
+    uint32_t    low;
+    uint32_t    high;
+    uint32_t    entry;
+} loader_kernel_t;
+
+/* loader.ld */
+extern uint8_t loader_image_start[], loader_image_end[];
+extern uint8_t loader_runtime_start[], loader_runtime_end[];
+
+static loader_runtime_t runtime __attribute__((section(".runtime")));
+
+static mach_boot_args_t boot_args;
+static uint8_t mem_map[LOADER_MAX_DESCS * LOADER_DESC_SIZE];
+static uint32_t num_descs;
+
+static loader_claim_t claims[LOADER_MAX_CLAIMS];
+static uint32_t num_claims;
+
+static const wchar_t firmware_vendor[] = { 'Q', 'E', 'M', 'U', 0 };
+
+static void loader_putc(void *p, char c)
+{
+    (void)p;
+    outb(DEBUGCON_PORT, c);
+}
+
+static noreturn void loader_fail(void)
+{
+    printf("loader: cannot start the kernel\n");
+    for (;;)
+        asm volatile("cli; hlt");
+}
+
+static uint8_t checksum(const uint8_t *p, uint32_t len)
+{
+    uint8_t sum = 0;
+
+    while (len--)
+        sum += *p++;
+    return sum;
+}
+
+static uint32_t pci_read32(uint8_t devfn, uint8_t reg)
+{
+    outl(PCI_CONFIG_ADDRESS, 0x80000000 | (devfn << 8) | (reg & 0xFC));
+    return inl(PCI_CONFIG_DATA);
+}
+
+static void pci_write32(uint8_t devfn, uint8_t reg, uint32_t value)
+{
+    outl(PCI_CONFIG_ADDRESS, 0x80000000 | (devfn << 8) | (reg & 0xFC));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+static void pci_write8(uint8_t devfn, uint8_t reg, uint8_t value)
+{
+    outl(PCI_CONFIG_ADDRESS, 0x80000000 | (devfn << 8) | (reg & 0xFC));
+    outb(PCI_CONFIG_DATA + (reg & 3), value);
+}
+
+/*
+ * SeaBIOS leaves 0xC0000-0xFFFFF read-only. The Apple TV firmware does not,
+ * and mach_kernel copies the VGA BIOS and the CSM there without asking.
+ */
+static void unlock_legacy_region(void)
+{
+    uint16_t device = pci_read32(PCI_DEVFN(0, 0), PCI_VENDOR_ID) >> 16;
+    uint8_t pam0;
+
+    if (device == I440FX_DEVICE_ID) {
+        pam0 = I440FX_PAM0;
+    } else if (device == Q35_DEVICE_ID) {
+        pam0 = Q35_PAM0;
+    } else {
+        printf("loader: unknown host bridge %04x, the BIOS region may be read-only\n", device);
+        return;
+    }
+
+    // PAM0 only has the upper nibble, for 0xF0000-0xFFFFF.
+    pci_write8(PCI_DEVFN(0, 0), pam0, PAM_READ_WRITE & 0xF0);
+    for (uint8_t i = 1; i < PAM_REGISTERS; i++)
+        pci_write8(PCI_DEVFN(0, 0), pam0 + i, PAM_READ_WRITE);
+}
+
+static const uint8_t *find_rsdp(void)
+{
+    const uint8_t *ebda = (const uint8_t *)((uint32_t)*(uint16_t *)0x40E << 4);
+    const uint8_t *p;
+
+    for (p = ebda; p < ebda + 1024; p += 16) {
+        if (!memcmp(p, "RSD PTR ", 8) && checksum(p, 20) == 0)
+            return p;
+    }
+    for (p = (const uint8_t *)0xE0000; p < (const uint8_t *)0x100000; p += 16) {
+        if (!memcmp(p, "RSD PTR ", 8) && checksum(p, 20) == 0)
+            return p;
+    }
+
+    return NULL;
+}
+
+static void add_config_table(efi_guid_t guid, void *table)
+{
+    efi_configuration_table_t *entry = &runtime.config[runtime.st.NumberOfTableEntries++];
+
+    entry->VendorGuid = guid;
+    entry->VendorTable = table;
+}
+
+static void copy_acpi(void)
+{
+    efi_guid_t acpi_guid = ACPI_TABLE_GUID;
+    efi_guid_t acpi2_guid = ACPI_20_TABLE_GUID;
+    const uint8_t *rsdp = find_rsdp();
+
+    if (rsdp == NULL) {
+        printf("loader: no ACPI RSDP\n");
+        return;
+    }
+
+    // The RSDT and XSDT are in high memory already.
+    memcpy(runtime.rsdp, rsdp, rsdp[15] >= 2 ? 36 : 20);
+    printf("loader: ACPI %d.0 RSDP at %x, copied to %x\n", rsdp[15] >= 2 ? 2 : 1, (uint32_t)rsdp,
+           (uint32_t)runtime.rsdp);
+    if (rsdp[15] >= 2)
+        add_config_table(acpi2_guid, runtime.rsdp);
+    add_config_table(acpi_guid, runtime.rsdp);
+}
+
+/*
+ * Copy the SMBIOS entry point and the structures it points at, which
+ * SeaBIOS may keep in the F segment too, and fix up the copy.
+ */
+static void copy_smbios(void)
+{
+    efi_guid_t smbios_guid = SMBIOS_TABLE_GUID;
+    efi_guid_t smbios3_guid = SMBIOS3_TABLE_GUID;
+    uint8_t *eps = runtime.smbios_eps;
+    const uint8_t *p;
+
+    for (p = (const uint8_t *)0xF0000; p < (const uint8_t *)0x100000; p += 16) {
+        if (!memcmp(p, "_SM_", 4) && p[5] <= sizeof(runtime.smbios_eps) && checksum(p, p[5]) == 0) {
+            uint16_t length = *(const uint16_t *)(p + 0x16);
+
+            if (length > sizeof(runtime.smbios))
+                break;
+            memcpy(eps, p, p[5]);
+            memcpy(runtime.smbios, (const void *)*(const uint32_t *)(p + 0x18), length);
+            *(uint32_t *)(eps + 0x18) = (uint32_t)runtime.smbios;
+            eps[0x15] = 0;
+            eps[0x15] = -checksum(eps + 0x10, 0x0F);
+            eps[0x04] = 0;
+            eps[0x04] = -checksum(eps, eps[5]);
+            add_config_table(smbios_guid, eps);
+            printf("loader: SMBIOS entry point at %x, copied to %x\n", (uint32_t)p, (uint32_t)eps);
+            return;
+        }
+
+        if (!memcmp(p, "_SM3_", 5) && p[6] <= sizeof(runtime.smbios_eps) && checksum(p, p[6]) == 0) {
+            uint32_t length = *(const uint32_t *)(p + 0x0C);
+            uint64_t addr = *(const uint64_t *)(p + 0x10);
+
+            if (length > sizeof(runtime.smbios) || addr > 0xFFFFFFFF)
+                break;
+            memcpy(eps, p, p[6]);
+            memcpy(runtime.smbios, (const void *)(uint32_t)addr, length);
+            *(uint64_t *)(eps + 0x10) = (uint32_t)runtime.smbios;
+            eps[0x05] = 0;
+            eps[0x05] = -checksum(eps, eps[6]);
+            add_config_table(smbios3_guid, eps);
+            printf("loader: SMBIOS 3.0 entry point at %x, copied to %x\n", (uint32_t)p, (uint32_t)eps);
+            return;
+        }
+    }
+
+    printf("loader: no usable SMBIOS entry point\n");
+}
+
+static void build_system_table(void)
+{
+    memset(&runtime, 0, sizeof(runtime));
+    runtime.st.Hdr.Signature = EFI_SYSTEM_TABLE_SIGNATURE;
+    runtime.st.Hdr.Revision = (1 << 16) | 10;
+    runtime.st.Hdr.HeaderSize = sizeof(runtime.st);
+    runtime.st.FirmwareVendor = (wchar_t *)firmware_vendor;
+    runtime.st.ConfigurationTable = runtime.config;
+
+    copy_acpi();
+    copy_smbios();
+
+    boot_args.efi_sys_tbl = (uint32_t)&runtime.st;
+}
+
+static void dispi_write(volatile uint16_t *mmio, uint16_t index, uint16_t value)
+{
+    if (mmio != NULL) {
+        mmio[index] = value;
+    } else {
+        outw(BOCHS_DISPI_IOPORT_INDEX, index);
+        outw(BOCHS_DISPI_IOPORT_DATA, value);
+    }
+}
+
+static uint16_t dispi_read(volatile uint16_t *mmio, uint16_t index)
+{
+    if (mmio != NULL)
+        return mmio[index];
+    outw(BOCHS_DISPI_IOPORT_INDEX, index);
+    return inw(BOCHS_DISPI_IOPORT_DATA);
+}
+
+/*
+ * Set a 32bpp mode on the first Bochs display device on bus 0. The
+ * bochs-display device only has the MMIO registers in BAR 2, the std VGA
+ * also answers on the legacy ports.
+ */
+static void setup_framebuffer(void)
+{
+    volatile uint16_t *mmio = NULL;
+    uint32_t bar0, bar2;
+    uint8_t devfn = 0;
+
+    do {
+        uint32_t id = pci_read32(devfn, PCI_VENDOR_ID);
+
+        if ((id & 0xFFFF) == BOCHS_VENDOR_ID && (id >> 16) == BOCHS_DEVICE_ID)
+            break;
+    } while (++devfn != 0);
+
+    if (pci_read32(devfn, PCI_VENDOR_ID) != ((BOCHS_DEVICE_ID << 16) | BOCHS_VENDOR_ID)) {
+        printf("loader: no Bochs display, mach_kernel gets no framebuffer\n");
+        return;
+    }
+
+    bar0 = pci_read32(devfn, PCI_BASE_ADDRESS_0);
+    if ((bar0 & 0x6) == 0x4 && pci_read32(devfn, PCI_BASE_ADDRESS_0 + 4) != 0) {
+        printf("loader: framebuffer is above 4GiB, mach_kernel gets none\n");
+        return;
+    }
+    bar2 = pci_read32(devfn, PCI_BASE_ADDRESS_0 + 8);
+    if (!(bar2 & 1) && (bar2 & ~0xF))
+        mmio = (volatile uint16_t *)((bar2 & ~0xF) + BOCHS_DISPI_MMIO_OFFSET);
+
+    // Memory decode on, in case SeaBIOS left it off.
+    pci_write32(devfn, PCI_COMMAND, pci_read32(devfn, PCI_COMMAND) | 0x2);
+
+    if ((dispi_read(mmio, BOCHS_DISPI_INDEX_ID) & 0xFFF0) != BOCHS_DISPI_ID0) {
+        printf("loader: display at %02x.%x does not speak DISPI\n", PCI_SLOT(devfn), PCI_FUNC(devfn));
+        return;
+    }
+
+    dispi_write(mmio, BOCHS_DISPI_INDEX_ENABLE, 0);
+    dispi_write(mmio, BOCHS_DISPI_INDEX_XRES, LOADER_FB_WIDTH);
+    dispi_write(mmio, BOCHS_DISPI_INDEX_YRES, LOADER_FB_HEIGHT);
+    dispi_write(mmio, BOCHS_DISPI_INDEX_BPP, LOADER_FB_DEPTH);
+    dispi_write(mmio, BOCHS_DISPI_INDEX_VIRT_WIDTH, LOADER_FB_WIDTH);
+    dispi_write(mmio, BOCHS_DISPI_INDEX_X_OFFSET, 0);
+    dispi_write(mmio, BOCHS_DISPI_INDEX_Y_OFFSET, 0);
+    dispi_write(mmio, BOCHS_DISPI_INDEX_ENABLE, BOCHS_DISPI_ENABLED | BOCHS_DISPI_LFB_ENABLED);
+
+    boot_args.video.base_addr = bar0 & ~0xF;
+    boot_args.video.pitch = LOADER_FB_WIDTH * (LOADER_FB_DEPTH / 8);
+    boot_args.video.width = LOADER_FB_WIDTH;
+    boot_args.video.height = LOADER_FB_HEIGHT;
+    boot_args.video.depth = LOADER_FB_DEPTH;
+    printf("loader: %dx%dx%d framebuffer at %x\n", LOADER_FB_WIDTH, LOADER_FB_HEIGHT, LOADER_FB_DEPTH,
+           boot_args.video.base_addr);
+}
+
+/*
+ * Find the extent and entry point of a Mach-O or ELF kernel, and copy its
+ * segments into place if `load` is set.
+ */
+static boolean_t walk_kernel(const uint8_t *image, uint32_t size, boolean_t load, loader_kernel_t *k)
+{
+    k->low = 0xFFFFFFFF;
+    k->high = 0;
+    k->entry = 0;
+
+    if (size >= sizeof(macho_header_t) && ((const macho_header_t *)image)->magic == MACHO_MAGIC) {
+        const macho_header_t *mh = (const macho_header_t *)image;
+        uint32_t offset = sizeof(macho_header_t);
+
+        for (uint32_t i = 0; i < mh->ncmds; i++) {
+            const macho_load_command_t *lc = (const macho_load_command_t *)(image + offset);
+
+            if (offset + sizeof(*lc) > size || lc->cmdsize < sizeof(*lc) || offset + lc->cmdsize > size)
+                return false;
+
+            if (lc->cmd == MACHO_LC_SEGMENT && lc->cmdsize >= sizeof(macho_segment_t)) {
+                const macho_segment_t *seg = (const macho_segment_t *)lc;
+
+                // __PAGEZERO and other empty segments take no memory.
+                if (seg->vmsize != 0 && (seg->filesize != 0 || seg->vmaddr != 0)) {
+                    if (seg->fileoff > size || seg->filesize > size - seg->fileoff || seg->filesize > seg->vmsize)
+                        return false;
+                    if (seg->vmaddr < k->low)
+                        k->low = seg->vmaddr;
+                    if (seg->vmaddr + seg->vmsize > k->high)
+                        k->high = seg->vmaddr + seg->vmsize;
+                    if (load) {
+                        memcpy((void *)seg->vmaddr, image + seg->fileoff, seg->filesize);
+                        memset((void *)(seg->vmaddr + seg->filesize), 0, seg->vmsize - seg->filesize);
+                    }
+                }
+            } else if (lc->cmd == MACHO_LC_UNIXTHREAD && lc->cmdsize >= sizeof(macho_thread_t)) {
+                const macho_thread_t *thread = (const macho_thread_t *)lc;
+
+                if (thread->flavor == MACHO_X86_THREAD_STATE32)
+                    k->entry = thread->eip;
+            }
+
+            offset += lc->cmdsize;
+        }
+    } else if (size >= sizeof(elf_header_t) && ((const elf_header_t *)image)->magic == ELF_MAGIC) {
+        const elf_header_t *eh = (const elf_header_t *)image;
+
+        if (eh->phoff > size || eh->phentsize < sizeof(elf_phdr_t) ||
+            eh->phnum > (size - eh->phoff) / eh->phentsize)
+            return false;
+
+        for (uint32_t i = 0; i < eh->phnum; i++) {
+            const elf_phdr_t *ph = (const elf_phdr_t *)(image + eh->phoff + i * eh->phentsize);
+
+            if (ph->type != ELF_PT_LOAD || ph->memsz == 0)
+                continue;
+            if (ph->offset > size || ph->filesz > size - ph->offset || ph->filesz > ph->memsz)
+                return false;
+            if (ph->paddr < k->low)
+                k->low = ph->paddr;
+            if (ph->paddr + ph->memsz > k->high)
+                k->high = ph->paddr + ph->memsz;
+            if (load) {
+                memcpy((void *)ph->paddr, image + ph->offset, ph->filesz);
+                memset((void *)(ph->paddr + ph->filesz), 0, ph->memsz - ph->filesz);
+            }
+        }
+        k->entry = eh->entry;
+    } else {
+        return false;
+    }
+
+    return k->entry != 0 && k->low < k->high;
+}
+
+static boolean_t overlaps(uint32_t start, uint32_t end, uint32_t other_start, uint32_t other_end)
+{
+    return start < other_end && other_start < end;
+}
+
+/* Keep a page range out of conventional memory in the EFI memory map */
+static void claim(uint64_t start, uint64_t end, uint32_t type)
+{
+    uint32_t i;
+
+    if (num_claims == LOADER_MAX_CLAIMS)
+        return;
+
+    for (i = num_claims; i > 0 && claims[i - 1].start > start; i--)
+        claims[i] = claims[i - 1];
+    claims[i].start = start & ~(uint64_t)EFI_PAGE_MASK;
+    claims[i].end = (end + EFI_PAGE_MASK) & ~(uint64_t)EFI_PAGE_MASK;
+    claims[i].type = type;
+    num_claims++;
+}
+
+static void add_desc(uint32_t type, uint64_t start, uint64_t end)
+{
+    efi_memory_descriptor_t *d = (efi_memory_descriptor_t *)(mem_map + num_descs * LOADER_DESC_SIZE);
+    efi_memory_descriptor_t *prev = (efi_memory_descriptor_t *)((uint8_t *)d - LOADER_DESC_SIZE);
+
+    if (end <= start)
+        return;
+
+    if (num_descs > 0 && prev->Type == type &&
+        prev->PhysicalStart + (prev->NumberOfPages << EFI_PAGE_SHIFT) == start) {
+        prev->NumberOfPages += (end - start) >> EFI_PAGE_SHIFT;
+        return;
+    }
+
+    if (num_descs == LOADER_MAX_DESCS) {
+        printf("loader: memory map full, dropped %llx-%llx\n", start, end - 1);
+        return;
+    }
+
+    memset(d, 0, LOADER_DESC_SIZE);
+    d->Type = type;
+    d->PhysicalStart = start;
+    d->NumberOfPages = (end - start) >> EFI_PAGE_SHIFT;
+    num_descs++;
+}
+
+/* RAM shrinks to whole pages, everything else grows to them. */
+static void add_ram(uint64_t start, uint64_t end)
+{
+    start = (start + EFI_PAGE_MASK) & ~(uint64_t)EFI_PAGE_MASK;
+    end &= ~(uint64_t)EFI_PAGE_MASK;
+
+    for (uint32_t i = 0; i < num_claims && start < end; i++) {
+        if (claims[i].end <= start || claims[i].start >= end)
+            continue;
+        add_desc(EfiConventionalMemory, start, claims[i].start);
+        add_desc(claims[i].type, claims[i].start > start ? claims[i].start : start,
+                 claims[i].end < end ? claims[i].end : end);
+        start = claims[i].end;
+    }
+    add_desc(EfiConventionalMemory, start, end);
+}
+
+static void build_memory_map(const multiboot_info_t *mbi)
+{
+    uint32_t p = mbi->mmap_addr;
+
+    while (p < mbi->mmap_addr + mbi->mmap_length) {
+        const multiboot_mmap_t *e = (const multiboot_mmap_t *)p;
+        uint64_t start = e->addr, end = e->addr + e->len;
+        uint32_t type;
+
+        switch (e->type) {
+            case MULTIBOOT_MEMORY_AVAILABLE:
+                add_ram(start, end);
+                p += e->size + sizeof(e->size);
+                continue;
+            case MULTIBOOT_MEMORY_ACPI:
+                type = EfiACPIReclaimMemory;
+                break;
+            case MULTIBOOT_MEMORY_NVS:
+                type = EfiACPIMemoryNVS;
+                break;
+            case MULTIBOOT_MEMORY_BADRAM:
+                type = EfiUnusableMemory;
+                break;
+            default:
+                type = EfiReservedMemoryType;
+                break;
+        }
+
+        add_desc(type, start & ~(uint64_t)EFI_PAGE_MASK, (end + EFI_PAGE_MASK) & ~(uint64_t)EFI_PAGE_MASK);
+        p += e->size + sizeof(e->size);
+    }
+
+    boot_args.efi_mem_map_ptr = (uint32_t)mem_map;
+    boot_args.efi_mem_map_size = num_descs * LOADER_DESC_SIZE;
+    boot_args.efi_mem_desc_size = LOADER_DESC_SIZE;
+    boot_args.efi_mem_desc_ver = LOADER_DESC_VERSION;
+}
+
+/*
+ * The multiboot command line starts with the loader's own name. The rest
+ * is mach_kernel's; "-v" asks for verbose mode like Command-V does.
+ */
+static void copy_cmdline(const multiboot_info_t *mbi)
+{
+    const char *cmdline = "";
+
+    if (mbi->flags & MULTIBOOT_INFO_CMDLINE) {
+        cmdline = (const char *)mbi->cmdline;
+        while (*cmdline && *cmdline != ' ')
+            cmdline++;
+        while (*cmdline == ' ')
+            cmdline++;
+    }
+
+    strncpy(boot_args.cmdline, cmdline, sizeof(boot_args.cmdline) - 1);
+    boot_args.video.display_mode = DISPLAY_MODE_GRAPHICS;
+    for (const char *p = boot_args.cmdline; *p; p++) {
+        if ((p == boot_args.cmdline || p[-1] == ' ') && p[0] == '-' && p[1] == 'v' && (p[2] == ' ' || !p[2]))
+            boot_args.video.display_mode = DISPLAY_MODE_TEXT;
+    }
+}
+
+noreturn void loader_main(uint32_t magic, const multiboot_info_t *mbi)
+{
+    const multiboot_module_t *mod;
+    loader_kernel_t kernel;
+
+    init_printf(NULL, loader_putc);
+
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
+        printf("loader: not started by a multiboot loader (%x)\n", magic);
+        loader_fail();
+    }
+    if (!(mbi->flags & MULTIBOOT_INFO_MODS) || mbi->mods_count == 0) {
+        printf("loader: no kernel, pass mach_kernel with -initrd\n");
+        loader_fail();
+    }
+    if (!(mbi->flags & MULTIBOOT_INFO_MMAP)) {
+        printf("loader: no memory map\n");
+        loader_fail();
+    }
+
+    mod = (const multiboot_module_t *)mbi->mods_addr;
+    if (!walk_kernel((const uint8_t *)mod->mod_start, mod->mod_end - mod->mod_start, false, &kernel)) {
+        printf("loader: module at %x is not a 32-bit Mach-O or ELF kernel\n", mod->mod_start);
+        loader_fail();
+    }
+    if (kernel.low < 0x100000 ||
+        overlaps(kernel.low, kernel.high, (uint32_t)loader_image_start, (uint32_t)loader_runtime_end) ||
+        overlaps(kernel.low, kernel.high, mod->mod_start, mod->mod_end)) {
+        printf("loader: kernel at %x-%x collides with the loader or its own file at %x-%x\n",
+               kernel.low, kernel.high - 1, mod->mod_start, mod->mod_end - 1);
+        loader_fail();
+    }
+    printf("loader: kernel %x-%x, entry %x\n", kernel.low, kernel.high - 1, kernel.entry);
+
+    boot_args.revision = LOADER_BOOT_ARGS_REVISION;
+    boot_args.version = LOADER_BOOT_ARGS_VERSION;
+    boot_args.efi_mode = LOADER_EFI_MODE;
+    boot_args.kernel_base = kernel.low;
+    boot_args.kernel_size = kernel.high - kernel.low;
+    copy_cmdline(mbi);
+
+    unlock_legacy_region();
+    build_system_table();
+    setup_framebuffer();
+
+    claim((uint32_t)loader_image_start, (uint32_t)loader_image_end, EfiLoaderData);
+    claim((uint32_t)loader_runtime_start, (uint32_t)loader_runtime_end, EfiRuntimeServicesData);
+    claim(kernel.low, kernel.high, EfiLoaderCode);
+    claim(mod->mod_start, mod->mod_end, EfiBootServicesData);
+    build_memory_map(mbi);
+    printf("loader: %d memory descriptors, command line \"%s\"\n", num_descs, boot_args.cmdline);
+
+    walk_kernel((const uint8_t *)mod->mod_start, mod->mod_end - mod->mod_start, true, &kernel);
+    loader_jump(kernel.entry, &boot_args);
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the QEMU multiboot loader of mach_kernel.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+/* Multiboot 1, as QEMU's -kernel implements it */
+#define MULTIBOOT_BOOTLOADER_MAGIC  0x2BADB002
+
+#define MULTIBOOT_INFO_CMDLINE      (1 << 2)
+#define MULTIBOOT_INFO_MODS         (1 << 3)
+#define MULTIBOOT_INFO_MMAP         (1 << 6)
+
+#define MULTIBOOT_MEMORY_AVAILABLE  1
+#define MULTIBOOT_MEMORY_ACPI       3
+#define MULTIBOOT_MEMORY_NVS        4
+#define MULTIBOOT_MEMORY_BADRAM     5
+
+typedef struct _multiboot_info_t
+{
+    uint32_t    flags;
+    uint32_t    mem_lower;
+    uint32_t    mem_upper;
+    uint32_t    boot_device;
+    uint32_t    cmdline;
+    uint32_t    mods_count;
+    uint32_t    mods_addr;
+    uint32_t    syms[4];
+    uint32_t    mmap_length;
+    uint32_t    mmap_addr;
+} multiboot_info_t;
+
+typedef struct _multiboot_module_t
+{
+    uint32_t    mod_start;
+    uint32_t    mod_end;
+    uint32_t    string;
+    uint32_t    reserved;
+} multiboot_module_t;
+
+/* `size` does not count itself */
+typedef struct _multiboot_mmap_t
+{
+    uint32_t    size;
+    uint64_t    addr;
+    uint64_t    len;
+    uint32_t    type;
+} __attribute__((packed)) multiboot_mmap_t;
+
+/* The parts of a 32-bit Mach-O file a static kernel uses */
+#define MACHO_MAGIC                 0xFEEDFACE
+#define MACHO_LC_SEGMENT            0x1
+#define MACHO_LC_UNIXTHREAD         0x5
+#define MACHO_X86_THREAD_STATE32    1
+
+typedef struct _macho_header_t
+{
+    uint32_t    magic;
+    uint32_t    cputype;
+    uint32_t    cpusubtype;
+    uint32_t    filetype;
+    uint32_t    ncmds;
+    uint32_t    sizeofcmds;
+    uint32_t    flags;
+} macho_header_t;
+
+typedef struct _macho_load_command_t
+{
+    uint32_t    cmd;
+    uint32_t    cmdsize;
+} macho_load_command_t;
+
+typedef struct _macho_segment_t
+{
+    uint32_t    cmd;
+    uint32_t    cmdsize;
+    char        segname[16];
+    uint32_t    vmaddr;
+    uint32_t    vmsize;
+    uint32_t    fileoff;
+    uint32_t    filesize;
+    uint32_t    maxprot;
+    uint32_t    initprot;
+    uint32_t    nsects;
+    uint32_t    flags;
+} macho_segment_t;
+
+typedef struct _macho_thread_t
+{
+    uint32_t    cmd;
+    uint32_t    cmdsize;
+    uint32_t    flavor;
+    uint32_t    count;
+    uint32_t    eax, ebx, ecx, edx, edi, esi, ebp, esp;
+    uint32_t    ss, eflags, eip, cs, ds, es, fs, gs;
+} macho_thread_t;
+
+/* And of a 32-bit ELF executable, for `make elf` builds */
+#define ELF_MAGIC                   0x464C457F
+#define ELF_PT_LOAD                 1
+
+typedef struct _elf_header_t
+{
+    uint32_t    magic;
+    uint8_t     ident[12];
+    uint16_t    type;
+    uint16_t    machine;
+    uint32_t    version;
+    uint32_t    entry;
+    uint32_t    phoff;
+    uint32_t    shoff;
+    uint32_t    flags;
+    uint16_t    ehsize;
+    uint16_t    phentsize;
+    uint16_t    phnum;
+    uint16_t    shentsize;
+    uint16_t    shnum;
+    uint16_t    shstrndx;
+} elf_header_t;
+
+typedef struct _elf_phdr_t
+{
+    uint32_t    type;
+    uint32_t    offset;
+    uint32_t    vaddr;
+    uint32_t    paddr;
+    uint32_t    filesz;
+    uint32_t    memsz;
+    uint32_t    flags;
+    uint32_t    align;
+} elf_phdr_t;
+
+/* Bochs DISPI interface of QEMU's bochs-display and std VGA (1234:1111) */
+#define BOCHS_VENDOR_ID             0x1234
+#define BOCHS_DEVICE_ID             0x1111
+#define BOCHS_DISPI_MMIO_OFFSET     0x500
+#define BOCHS_DISPI_IOPORT_INDEX    0x1CE
+#define BOCHS_DISPI_IOPORT_DATA     0x1CF
+
+#define BOCHS_DISPI_INDEX_ID        0x0
+#define BOCHS_DISPI_INDEX_XRES      0x1
+#define BOCHS_DISPI_INDEX_YRES      0x2
+#define BOCHS_DISPI_INDEX_BPP       0x3
+#define BOCHS_DISPI_INDEX_ENABLE    0x4
+#define BOCHS_DISPI_INDEX_VIRT_WIDTH 0x6
+#define BOCHS_DISPI_INDEX_X_OFFSET  0x8
+#define BOCHS_DISPI_INDEX_Y_OFFSET  0x9
+
+#define BOCHS_DISPI_ID0             0xB0C0
+#define BOCHS_DISPI_ENABLED         0x01
+#define BOCHS_DISPI_LFB_ENABLED     0x40
+
+/* The Apple TV drives its display at 720p */
+#define LOADER_FB_WIDTH             1280
+#define LOADER_FB_HEIGHT            720
+#define LOADER_FB_DEPTH             32
+
+/* PAM registers of the i440FX (pc) and Q35 (q35) host bridges */
+#define I440FX_DEVICE_ID            0x1237
+#define I440FX_PAM0                 0x59
+#define Q35_DEVICE_ID               0x29C0
+#define Q35_PAM0                    0x90
+#define PAM_REGISTERS               7
+#define PAM_READ_WRITE              0x33
+
+/* Boot args as boot.efi from the Apple TV 1.0 firmware fills them */
+#define LOADER_BOOT_ARGS_REVISION   5
+#define LOADER_BOOT_ARGS_VERSION    1
+#define LOADER_EFI_MODE             32
+
+/* Apple's firmware pads its memory descriptors to 48 bytes */
+#define LOADER_DESC_SIZE            48
+#define LOADER_DESC_VERSION         1
+#define LOADER_MAX_DESCS            64
+#define LOADER_MAX_CLAIMS           8
+
+#define LOADER_MAX_CONFIG_TABLES    4
+#define LOADER_SMBIOS_MAX           0x4000
+
+#define EFI_SYSTEM_TABLE_SIGNATURE  SIGNATURE_64('I','B','I',' ','S','Y','S','T')
+
+/* Functions */
+extern noreturn void loader_jump(uint32_t entry, mach_boot_args_t *ba);
@@ -0,0 +1,78 @@
+#!/bin/sh
+#
+# Copyright (C) 2025 Sylas Hollander.
+# PURPOSE: Time the boot stages of mach_kernel under QEMU over several runs.
+# SPDX-License-Identifier: MIT
+#
+# usage: timing.sh <loader.elf> <mach_kernel>
+#
+# Boots RUNS times (5) through boot.sh with EXITAT=<stage>
+# (Legacy16PrepareToBoot by default), so each run ends through
+# isa-debug-exit right after that stage. The TIMING: lines of every run are
+# scraped, and the median, minimum and maximum cycles of each stage and of
+# the real mode part are printed, along with the median milliseconds. Other
+# boot.sh variables (QEMU, APPEND, QEMU_ARGS, TIMEOUT) are passed on.
+#
+
+if [ $# -ne 2 ]; then
+    echo "usage: $0 <loader.elf> <mach_kernel>" >&2
+    exit 2
+fi
+
+RUNS=${RUNS:-5}
+EXITAT=${EXITAT:-Legacy16PrepareToBoot}
+export EXITAT
+
+LOGS=$(mktemp -d) || exit 2
+trap 'rm -rf "$LOGS"' EXIT
+
+run=1
+while [ $run -le "$RUNS" ]; do
+    if ! LOG_DIR=$LOGS/$run "$(dirname "$0")/boot.sh" "$1" "$2" > "$LOGS/$run.out"; then
+        cat "$LOGS/$run.out"
+        echo "timing: run $run failed" >&2
+        exit 1
+    fi
+    run=$((run + 1))
+done
+
+# Lines look like "TIMING: <stage> <cycles> cycles[, <ms> ms][, <cycles> in real mode]".
+cat "$LOGS"/*/debugcon.log | awk -v runs="$RUNS" '
+function sort(a, n,    i, j, t) {
+    for (i = 2; i <= n; i++)
+        for (j = i; j > 1 && a[j - 1] > a[j]; j--) {
+            t = a[j]; a[j] = a[j - 1]; a[j - 1] = t
+        }
+}
+function median(a, n) {
+    sort(a, n)
+    return n % 2 ? a[(n + 1) / 2] : (a[n / 2] + a[n / 2 + 1]) / 2
+}
+/^TIMING: / {
+    line = substr($0, 9)
+    at = match(line, / [0-9]+ cycles/)
+    if (!at)
+        next
+    name = substr(line, 1, at - 1)
+    rest = substr(line, at + 1)
+    if (!(name in count))
+        order[stages++] = name
+    n = ++count[name]
+    split(rest, f, " ")
+    cycles[name, n] = f[1] + 0
+    ms[name, n] = match(rest, /[0-9.]+ ms/) ? substr(rest, RSTART, RLENGTH - 3) + 0 : 0
+    real[name, n] = match(rest, /[0-9]+ in real mode/) ? substr(rest, RSTART, RLENGTH - 13) + 0 : 0
+}
+END {
+    printf "%-28s %14s %14s %14s %10s %14s\n", "stage", "median", "min", "max", "ms", "real mode"
+    for (s = 0; s < stages; s++) {
+        name = order[s]
+        n = count[name]
+        for (i = 1; i <= n; i++) {
+            c[i] = cycles[name, i]; m[i] = ms[name, i]; r[i] = real[name, i]
+        }
+        med = median(c, n)
+        printf "%-28s %14d %14d %14d %10.3f %14d\n", name, med, c[1], c[n], median(m, n), median(r, n)
+    }
+    printf "%d runs\n", runs
+}'
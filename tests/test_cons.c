@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Host golden-image and throughput tests for the framebuffer console.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "host.h"
+
+/* From video_cons.c and font.h */
+extern linear_framebuffer_t fb;
+extern console_priv_t con;
+extern unsigned char iso_font[];
+
+#define CHAR_WIDTH          8
+#define CHAR_HEIGHT         16
+
+/*
+ * Golden screens are 10x4 cells on a framebuffer a little larger than
+ * that, so the partial column and row at the edges and the padding at the
+ * end of each line are covered too.
+ */
+#define GOLDEN_COLS         10
+#define GOLDEN_ROWS         4
+#define GOLDEN_WIDTH        (GOLDEN_COLS * CHAR_WIDTH + 4)
+#define GOLDEN_HEIGHT       (GOLDEN_ROWS * CHAR_HEIGHT + 6)
+
+#define FG_COLOR            0xAABBCC00
+#define BG_COLOR            0x11223300
+
+/* Throughput: best of BENCH_RUNS passes over the screen */
+#define BENCH_RUNS          5
+#define BENCH_SCROLLS       256
+
+typedef struct _golden_t
+{
+    const char  *name;
+    const char  *script;
+    const char  *screen[GOLDEN_ROWS];  /* Missing rows and columns are blank */
+} golden_t;
+
+static const golden_t goldens[] = {
+    { "wrap", "ABCDEFGHIJKLM", { "ABCDEFGHIJ", "KLM" } },
+    // A newline right at the end of a full row does not skip a row.
+    { "wrap-newline", "0123456789\nX", { "0123456789", "X" } },
+    { "carriage-return", "hello\rJ\r\n\rab", { "Jello", "ab" } },
+    { "scroll", "1\n2\n3\n4\n5\n6", { "3", "4", "5", "6" } },
+    // The scroll waits for something to be printed on the new row.
+    { "scroll-deferred", "1\n2\n3\n4\n", { "1", "2", "3", "4" } },
+    { "scroll-wrap", "0123456789012345678901234567890123456789AB", { "0123456789", "0123456789", "0123456789", "AB" } },
+    { "backspace", "abc\b\bX", { "aX" } },
+    { "backspace-line-start", "\b\bq\n\bz", { "q", "z" } },
+    { "backspace-full-row", "0123456789\bZ", { "012345678Z" } },
+    { "backspace-after-scroll", "1\n2\n3\n4\n5xy\b", { "2", "3", "4", "5x" } },
+};
+
+/* Pixel formats, with the native values of FG_COLOR and BG_COLOR */
+typedef struct _format_t
+{
+    uint32_t    depth;
+    uint32_t    fg;
+    uint32_t    bg;
+} format_t;
+
+static const format_t formats[] = {
+    { 32, 0x00AABBCC, 0x00112233 },
+    { 24, 0x00AABBCC, 0x00112233 },
+    { 16, ((0xAA >> 3) << 11) | ((0xBB >> 2) << 5) | (0xCC >> 3),
+          ((0x11 >> 3) << 11) | ((0x22 >> 2) << 5) | (0x33 >> 3) },
+};
+
+static const char *out_dir = ".";
+static int failures;
+
+/* Console output for printf; cons.c would pull in the serial port. */
+void cons_putc(void *p, char c)
+{
+    host_putc(p, c);
+}
+
+static void put_pixel(uint8_t *line, uint32_t x, uint32_t depth, uint32_t color)
+{
+    uint8_t *p = line + x * (depth >> 3);
+
+    for (uint32_t i = 0; i < (depth >> 3); i++)
+        p[i] = (uint8_t)(color >> (8 * i));
+}
+
+static uint32_t get_pixel(const uint8_t *line, uint32_t x, uint32_t depth)
+{
+    const uint8_t *p = line + x * (depth >> 3);
+    uint32_t color = 0;
+
+    for (uint32_t i = 0; i < (depth >> 3); i++)
+        color |= (uint32_t)p[i] << (8 * i);
+    return color;
+}
+
+/* Draw the expected screen straight from the font. */
+static void render_golden(uint8_t *image, const golden_t *g, const format_t *f, uint32_t pitch)
+{
+    for (uint32_t y = 0; y < GOLDEN_HEIGHT; y++) {
+        for (uint32_t x = 0; x < GOLDEN_WIDTH; x++) {
+            uint32_t row = y / CHAR_HEIGHT, col = x / CHAR_WIDTH;
+            const char *text = row < GOLDEN_ROWS ? g->screen[row] : NULL;
+            uint8_t c = ' ';
+            uint32_t bits;
+
+            if (text != NULL && col < GOLDEN_COLS && col < strlen(text))
+                c = text[col];
+            bits = iso_font[c * CHAR_HEIGHT + y % CHAR_HEIGHT];
+            put_pixel(image + y * pitch, x, f->depth, ((bits >> (x % CHAR_WIDTH)) & 1) ? f->fg : f->bg);
+        }
+    }
+}
+
+/* Save a screen as a binary PPM, foreground white and background black. */
+static void dump_image(const char *name, const char *kind, const uint8_t *image, const format_t *f, uint32_t pitch)
+{
+    static uint8_t ppm[32 + GOLDEN_WIDTH * GOLDEN_HEIGHT * 3];
+    char path[256];
+    int len;
+
+    len = snprintf((char *)ppm, 32, "P6\n%d %d\n255\n", GOLDEN_WIDTH, GOLDEN_HEIGHT);
+    for (uint32_t y = 0; y < GOLDEN_HEIGHT; y++) {
+        for (uint32_t x = 0; x < GOLDEN_WIDTH; x++) {
+            uint32_t color = get_pixel(image + y * pitch, x, f->depth);
+            uint8_t v = color == f->fg ? 0xFF : color == f->bg ? 0x00 : 0x80;
+            uint8_t *p = ppm + len + (y * GOLDEN_WIDTH + x) * 3;
+            p[0] = p[1] = p[2] = v;
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s/cons-%s-%d.%s.ppm", out_dir, name, f->depth, kind);
+    if (host_write_file(path, ppm, len + GOLDEN_WIDTH * GOLDEN_HEIGHT * 3) == 0)
+        printf("cons: wrote %s\n", path);
+}
+
+static void set_mode(uint32_t width, uint32_t height, uint32_t depth, uint32_t pitch)
+{
+    mach_video_t mv = { 0 };
+
+    mv.pitch = pitch;
+    mv.width = width;
+    mv.height = height;
+    mv.depth = depth;
+    if (!cons_init(&mv, FG_COLOR, BG_COLOR)) {
+        printf("FAIL: cons_init rejected %dx%dx%d\n", width, height, depth);
+        host_exit(1);
+    }
+
+    // boot_args only has room for a 32-bit framebuffer address.
+    fb.base = (uintptr_t)host_alloc(fb.size);
+}
+
+static void run_golden(const golden_t *g, const format_t *f)
+{
+    // Lines padded past the last pixel.
+    uint32_t pitch = ((GOLDEN_WIDTH * (f->depth >> 3) + 3) & ~3) + 8;
+    uint8_t *golden = host_alloc(pitch * GOLDEN_HEIGHT);
+    uint8_t *screen;
+
+    set_mode(GOLDEN_WIDTH, GOLDEN_HEIGHT, f->depth, pitch);
+    screen = (uint8_t *)(uintptr_t)fb.base;
+    cons_clear_screen(BG_COLOR);
+    for (const char *c = g->script; *c; c++)
+        cons_print_char(NULL, *c);
+
+    render_golden(golden, g, f, pitch);
+    for (uint32_t y = 0; y < GOLDEN_HEIGHT; y++) {
+        for (uint32_t x = 0; x < GOLDEN_WIDTH; x++) {
+            if (get_pixel(screen + y * pitch, x, f->depth) == get_pixel(golden + y * pitch, x, f->depth))
+                continue;
+
+            printf("FAIL: %s at %dbpp: row %d column %d differs\n", g->name, f->depth,
+                   y / CHAR_HEIGHT, x / CHAR_WIDTH);
+            dump_image(g->name, "golden", golden, f, pitch);
+            dump_image(g->name, "actual", screen, f, pitch);
+            failures++;
+            y = GOLDEN_HEIGHT;
+            break;
+        }
+    }
+
+    host_free(screen);
+    host_free(golden);
+}
+
+/* Printable characters per second, filling the screen without scrolling */
+static void bench_chars(uint32_t width, uint32_t height)
+{
+    uint64_t best = ~0ull;
+    uint32_t chars;
+
+    set_mode(width, height, 32, width * 4);
+    chars = con.width * (con.height - 1);
+
+    for (uint32_t run = 0; run < BENCH_RUNS; run++) {
+        uint64_t start, ns;
+
+        cons_clear_screen(BG_COLOR);
+        start = host_ns();
+        for (uint32_t i = 0; i < chars; i++)
+            cons_print_char(NULL, (char)(' ' + i % 95));
+        ns = host_ns() - start;
+        if (ns < best)
+            best = ns;
+    }
+
+    printf("cons: %dx%d: %llu characters/s\n", width, height, chars * 1000000000ull / best);
+    host_free((void *)(uintptr_t)fb.base);
+}
+
+/* Full screen scrolls per second, each bringing in a row with one character */
+static void bench_scroll(uint32_t width, uint32_t height)
+{
+    uint64_t best = ~0ull;
+
+    set_mode(width, height, 32, width * 4);
+    cons_clear_screen(BG_COLOR);
+    for (uint32_t i = 0; i < con.height; i++)
+        cons_print_char(NULL, '\n');
+
+    for (uint32_t run = 0; run < BENCH_RUNS; run++) {
+        uint64_t start = host_ns(), ns;
+
+        for (uint32_t i = 0; i < BENCH_SCROLLS; i++) {
+            cons_print_char(NULL, '\n');
+            cons_print_char(NULL, '#');
+        }
+        ns = host_ns() - start;
+        if (ns < best)
+            best = ns;
+    }
+
+    printf("cons: %dx%d: %llu scrolled lines/s\n", width, height, BENCH_SCROLLS * 1000000000ull / best);
+    host_free((void *)(uintptr_t)fb.base);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = 0;
+
+    host_init();
+    if (argc > 1)
+        out_dir = argv[1];
+
+    for (uint32_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        for (uint32_t g = 0; g < sizeof(goldens) / sizeof(goldens[0]); g++, count++)
+            run_golden(&goldens[g], &formats[f]);
+    }
+    printf("cons: %d of %d golden images differ\n", failures, count);
+
+    bench_chars(1280, 720);
+    bench_scroll(1280, 720);
+    bench_chars(1920, 1080);
+    bench_scroll(1920, 1080);
+
+    printf("cons: %s\n", failures ? "FAILED" : "ok");
+    host_exit(failures != 0);
+    return 0;
+}
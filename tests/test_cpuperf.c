@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Host test of the Enhanced SpeedStep switch against simulated MSRs.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cpuperf.h"
+#include "host.h"
+
+/* cmdline.c reads the boot args through this; csmwrapple.c is not linked */
+mach_boot_args_t *gBA;
+
+/* IA32_PERF_STATUS with the current and the highest ratio/VID pair */
+#define STATUS(ratio, vid, max_ratio, max_vid) \
+    (((uint64_t)PERF_VALUE(max_ratio, max_vid) << 32) | PERF_VALUE(ratio, vid))
+
+/* Bits of IA32_PERF_CTL above the ratio/VID pair that must survive */
+#define CTL_OTHER_BITS      0x0000000100000000ULL
+
+/*
+ * A Pentium M as far as cpuperf_set_max can see it. A write to PERF_CTL
+ * moves PERF_STATUS to the new pair unless the transition is stuck.
+ */
+typedef struct _sim_cpu_t
+{
+    uint64_t    status;
+    uint64_t    misc;
+    uint64_t    ctl;
+    boolean_t   stuck;
+    uint32_t    status_reads;
+    uint32_t    misc_writes;
+    uint32_t    ctl_writes;
+} sim_cpu_t;
+
+static sim_cpu_t cpu;
+static int failures;
+
+#define fail(...) \
+    do { \
+        printf("FAIL: " __VA_ARGS__); \
+        failures++; \
+    } while (0)
+
+static uint64_t sim_read(uint32_t msr)
+{
+    switch (msr) {
+        case MSR_IA32_PERF_STATUS:
+            cpu.status_reads++;
+            return cpu.status;
+        case MSR_IA32_MISC_ENABLE:
+            return cpu.misc;
+        case MSR_IA32_PERF_CTL:
+            return cpu.ctl;
+        default:
+            fail("read of MSR %x\n", msr);
+            return 0;
+    }
+}
+
+static void sim_write(uint32_t msr, uint64_t value)
+{
+    switch (msr) {
+        case MSR_IA32_MISC_ENABLE:
+            cpu.misc_writes++;
+            cpu.misc = value;
+            break;
+        case MSR_IA32_PERF_CTL:
+            cpu.ctl_writes++;
+            cpu.ctl = value;
+            if (!cpu.stuck)
+                cpu.status = (cpu.status & ~0xFFFFULL) | (value & 0xFFFF);
+            break;
+        default:
+            fail("write of MSR %x\n", msr);
+            break;
+    }
+}
+
+static const cpuperf_msr_ops_t sim_ops =
+{
+    .read   = sim_read,
+    .write  = sim_write,
+};
+
+static void sim_reset(uint64_t status, uint64_t misc, boolean_t stuck)
+{
+    memset(&cpu, 0, sizeof(cpu));
+    cpu.status = status;
+    cpu.misc = misc;
+    cpu.ctl = CTL_OTHER_BITS | PERF_VALUE(1, 1);
+    cpu.stuck = stuck;
+}
+
+static void check(const char *name, int ret, int expect_ret, uint32_t expect_ctl_writes,
+                  uint32_t expect_ratio, uint32_t expect_vid)
+{
+    if (ret != expect_ret)
+        fail("%s: returned %d, expected %d\n", name, ret, expect_ret);
+    if (cpu.ctl_writes != expect_ctl_writes)
+        fail("%s: %d PERF_CTL writes, expected %d\n", name, cpu.ctl_writes, expect_ctl_writes);
+    if (PERF_RATIO(cpu.status) != expect_ratio || PERF_VID(cpu.status) != expect_vid)
+        fail("%s: left at ratio %d VID %x, expected ratio %d VID %x\n", name,
+             PERF_RATIO(cpu.status), PERF_VID(cpu.status), expect_ratio, expect_vid);
+    if ((cpu.ctl & ~0xFFFFULL) != CTL_OTHER_BITS)
+        fail("%s: PERF_CTL upper bits changed\n", name);
+}
+
+static void test_switch(void)
+{
+    cpuperf_state_t before, after;
+    int ret;
+
+    sim_reset(STATUS(6, 0x10, 12, 0x26), MISC_ENABLE_EIST, false);
+    ret = cpuperf_set_max(&before, &after);
+    check("switch", ret, 0, 1, 12, 0x26);
+    if (before.ratio != 6 || before.vid != 0x10 || after.ratio != 12 || after.vid != 0x26)
+        fail("switch: reported ratio %d VID %x -> ratio %d VID %x\n",
+             before.ratio, before.vid, after.ratio, after.vid);
+}
+
+static void test_enable_eist(void)
+{
+    cpuperf_state_t before, after;
+    int ret;
+
+    sim_reset(STATUS(6, 0x10, 12, 0x26), 0, false);
+    ret = cpuperf_set_max(&before, &after);
+    check("enable EIST", ret, 0, 1, 12, 0x26);
+    if (!(cpu.misc & MISC_ENABLE_EIST) || cpu.misc_writes != 1)
+        fail("enable EIST: MISC_ENABLE %llx after %d writes\n", (unsigned long long)cpu.misc, cpu.misc_writes);
+}
+
+static void test_eist_locked(void)
+{
+    cpuperf_state_t before, after;
+    int ret;
+
+    sim_reset(STATUS(6, 0x10, 12, 0x26), MISC_ENABLE_EIST_LOCK, false);
+    ret = cpuperf_set_max(&before, &after);
+    check("EIST off and locked", ret, -1, 0, 6, 0x10);
+    if (cpu.misc_writes != 0)
+        fail("EIST off and locked: MISC_ENABLE written\n");
+}
+
+static void test_at_max(void)
+{
+    cpuperf_state_t before, after;
+    int ret;
+
+    sim_reset(STATUS(12, 0x26, 12, 0x26), MISC_ENABLE_EIST, false);
+    ret = cpuperf_set_max(&before, &after);
+    check("already at max", ret, 0, 0, 12, 0x26);
+    if (before.ratio != after.ratio || before.vid != after.vid)
+        fail("already at max: reported ratio %d VID %x -> ratio %d VID %x\n",
+             before.ratio, before.vid, after.ratio, after.vid);
+}
+
+static void test_stuck(void)
+{
+    cpuperf_state_t before, after;
+    int ret;
+
+    sim_reset(STATUS(6, 0x10, 12, 0x26), MISC_ENABLE_EIST, true);
+    ret = cpuperf_set_max(&before, &after);
+    check("stuck transition", ret, -1, 1, 6, 0x10);
+    // The first read, then every poll.
+    if (cpu.status_reads != CPUPERF_TRANSITION_POLLS + 1)
+        fail("stuck transition: %d PERF_STATUS reads, expected %d\n", cpu.status_reads,
+             CPUPERF_TRANSITION_POLLS + 1);
+}
+
+static void test_no_max(void)
+{
+    cpuperf_state_t before, after;
+    int ret;
+
+    sim_reset(STATUS(6, 0x10, 0, 0), MISC_ENABLE_EIST, false);
+    ret = cpuperf_set_max(&before, &after);
+    check("max ratio 0", ret, -1, 0, 6, 0x10);
+    if (cpu.misc_writes != 0)
+        fail("max ratio 0: MISC_ENABLE written\n");
+}
+
+int main(void)
+{
+    host_init();
+    cpuperf_set_msr_ops(&sim_ops);
+
+    test_switch();
+    test_enable_eist();
+    test_eist_locked();
+    test_at_max();
+    test_stuck();
+    test_no_max();
+
+    cpuperf_set_msr_ops(NULL);
+
+    printf("cpuperf: %s\n", failures ? "FAILED" : "ok");
+    host_exit(failures != 0);
+    return 0;
+}
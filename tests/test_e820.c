@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Host fuzz test and scaling benchmark for the EFI to E820 conversion.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "e820.h"
+#include "host.h"
+
+/* Random maps checked per run, and their size */
+#define FUZZ_ROUNDS         2000
+#define FUZZ_MAX_DESC       64
+
+/* Scaling benchmark: 10 up to this many descriptors, best of BENCH_RUNS */
+#define BENCH_MAX_DESC      10000
+#define BENCH_RUNS          20
+
+/* Room for every boundary of the largest map, so nothing is truncated */
+#define MAX_POINTS          (2 * BENCH_MAX_DESC)
+
+/* Dense maps crowd their descriptors into this many pages */
+#define DENSE_PAGES         1024
+
+/* Pages a fuzzed map can span: sparse maps have up to 257 per descriptor */
+#define FUZZ_MAX_PAGES      (FUZZ_MAX_DESC * 257 + DENSE_PAGES)
+
+static uint32_t seed = 0x2545F491;
+static int failures;
+
+static uint32_t fuzz_random(void)
+{
+    // xorshift32
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/*
+ * Reference for the conversion, written out independently of e820conv.c:
+ * the E820 type of every EFI type, and how restrictive it is when
+ * descriptors overlap.
+ */
+static const uint8_t ref_type[EfiPalCode + 1] = {
+    [EfiReservedMemoryType]         = E820_RESERVED,
+    [EfiLoaderCode]                 = E820_RAM,
+    [EfiLoaderData]                 = E820_RAM,
+    [EfiBootServicesCode]           = E820_RAM,
+    [EfiBootServicesData]           = E820_RAM,
+    [EfiRuntimeServicesCode]        = E820_RESERVED,
+    [EfiRuntimeServicesData]        = E820_RESERVED,
+    [EfiConventionalMemory]         = E820_RAM,
+    [EfiUnusableMemory]             = E820_UNUSABLE,
+    [EfiACPIReclaimMemory]          = E820_ACPI,
+    [EfiACPIMemoryNVS]              = E820_NVS,
+    [EfiMemoryMappedIO]             = E820_RESERVED,
+    [EfiMemoryMappedIOPortSpace]    = E820_RESERVED,
+    [EfiPalCode]                    = E820_RESERVED,
+};
+
+static const uint8_t ref_rank[E820_UNUSABLE + 1] = {
+    [E820_RAM]      = 1,
+    [E820_ACPI]     = 2,
+    [E820_NVS]      = 3,
+    [E820_RESERVED] = 4,
+    [E820_UNUSABLE] = 5,
+};
+
+#define fail(...) \
+    do { \
+        printf("FAIL: " __VA_ARGS__); \
+        failures++; \
+    } while (0)
+
+/*
+ * Fill `count` descriptors `stride` bytes apart. Dense maps crowd them into
+ * DENSE_PAGES so they overlap and nest; sparse ones are laid out back to
+ * back like a real firmware map, with the odd gap. Both are shuffled.
+ * Returns the page right after the highest descriptor.
+ */
+static uint64_t fill_map(uint8_t *efi_map, uint32_t stride, uint32_t count, boolean_t dense)
+{
+    uint8_t tmp[sizeof(efi_memory_descriptor_t) + 16];
+    uint64_t next = 0, top = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        efi_memory_descriptor_t *d = (efi_memory_descriptor_t *)(efi_map + i * stride);
+
+        // Whatever follows the structure in a larger stride is garbage.
+        memset(d, 0xA5, stride);
+        d->Type = fuzz_random() % (EfiPalCode + 1);
+        if (dense) {
+            d->PhysicalStart = (uint64_t)(fuzz_random() % DENSE_PAGES) * EFI_PAGE_SIZE;
+            d->NumberOfPages = fuzz_random() % 64;
+        } else {
+            next += (uint64_t)(fuzz_random() % 4 == 0) * EFI_PAGE_SIZE;
+            d->PhysicalStart = next;
+            d->NumberOfPages = 1 + fuzz_random() % 256;
+            next += d->NumberOfPages * EFI_PAGE_SIZE;
+        }
+
+        if (d->PhysicalStart / EFI_PAGE_SIZE + d->NumberOfPages > top)
+            top = d->PhysicalStart / EFI_PAGE_SIZE + d->NumberOfPages;
+    }
+
+    for (uint32_t i = count; i > 1; i--) {
+        uint32_t j = fuzz_random() % i;
+        memcpy(tmp, efi_map + (i - 1) * stride, stride);
+        memcpy(efi_map + (i - 1) * stride, efi_map + j * stride, stride);
+        memcpy(efi_map + j * stride, tmp, stride);
+    }
+
+    return top;
+}
+
+/*
+ * Check the invariants directly: entries sorted, non-overlapping, non-empty
+ * and merged, and page for page the most restrictive type of the
+ * descriptors covering it. Pages no descriptor covers must not show up, and
+ * no RAM may be lost. Returns the number of problems.
+ */
+static int check_pages(const uint8_t *efi_map, uint32_t stride, uint32_t count, uint64_t pages,
+                       const struct e820_entry *map, uint32_t entries, uint8_t *expect)
+{
+    uint64_t ram_expected = 0, ram_found = 0;
+    uint64_t page;
+    int problems = 0;
+    uint32_t i;
+
+    memset(expect, 0, pages);
+    for (i = 0; i < count; i++) {
+        const efi_memory_descriptor_t *d = (const efi_memory_descriptor_t *)(efi_map + i * stride);
+        uint8_t type = ref_type[d->Type];
+
+        for (page = d->PhysicalStart / EFI_PAGE_SIZE; page < d->PhysicalStart / EFI_PAGE_SIZE + d->NumberOfPages; page++) {
+            if (ref_rank[type] > ref_rank[expect[page]])
+                expect[page] = type;
+        }
+    }
+
+    for (i = 0; i < entries; i++) {
+        if (map[i].size == 0 || (map[i].addr | map[i].size) & EFI_PAGE_MASK)
+            problems++;
+        if (i > 0 && map[i - 1].addr + map[i - 1].size > map[i].addr)
+            problems++;
+        if (i > 0 && map[i - 1].addr + map[i - 1].size == map[i].addr && map[i - 1].type == map[i].type)
+            problems++;
+    }
+
+    // Walk the pages and the entries side by side.
+    i = 0;
+    for (page = 0; page < pages; page++) {
+        uint64_t addr = page * EFI_PAGE_SIZE;
+        uint8_t found = 0;
+
+        while (i < entries && map[i].addr + map[i].size <= addr)
+            i++;
+        if (i < entries && map[i].addr <= addr)
+            found = map[i].type;
+
+        if (found != expect[page])
+            problems++;
+        ram_expected += expect[page] == E820_RAM;
+        ram_found += found == E820_RAM;
+    }
+
+    if (entries && map[entries - 1].addr + map[entries - 1].size > pages * EFI_PAGE_SIZE)
+        problems++;
+    if (ram_found != ram_expected)
+        problems++;
+
+    return problems;
+}
+
+static void fuzz(uint8_t *efi_map, e820_conv_t *conv, uint8_t *expect)
+{
+    uint32_t failed = 0;
+
+    for (uint32_t round = 0; round < FUZZ_ROUNDS; round++) {
+        // Firmware may hand out descriptors larger than the structure.
+        uint32_t stride = sizeof(efi_memory_descriptor_t) + 8 * (fuzz_random() % 3);
+        uint32_t count = fuzz_random() % FUZZ_MAX_DESC;
+        boolean_t dense = round & 1;
+        uint64_t pages;
+        int problems;
+
+        pages = fill_map(efi_map, stride, count, dense);
+        e820_convert(efi_map, count * stride, stride, conv);
+
+        problems = e820_check(efi_map, count * stride, stride, conv->map, conv->entries);
+        problems += check_pages(efi_map, stride, count, pages, conv->map, conv->entries, expect);
+        if (problems || conv->truncated) {
+            if (failed++ == 0)
+                fail("round %d, %d %s descriptors, stride %d: %d problems%s\n", round, count,
+                     dense ? "dense" : "sparse", stride, problems, conv->truncated ? ", truncated" : "");
+        }
+    }
+
+    printf("e820: %d of %d random maps failed the checks\n", failed, FUZZ_ROUNDS);
+}
+
+static void put_desc(uint8_t *efi_map, uint32_t stride, uint32_t i, uint32_t type, uint64_t start, uint64_t pages)
+{
+    efi_memory_descriptor_t *d = (efi_memory_descriptor_t *)(efi_map + i * stride);
+
+    memset(d, 0, stride);
+    d->Type = type;
+    d->PhysicalStart = start;
+    d->NumberOfPages = pages;
+}
+
+/* Inputs the random maps are unlikely to hit */
+static void edge_cases(uint8_t *efi_map, e820_conv_t *conv)
+{
+    uint32_t stride = sizeof(efi_memory_descriptor_t);
+    e820_conv_t small = *conv;
+
+    if (e820_convert(efi_map, 0, stride, conv) != 0 || conv->truncated)
+        fail("empty map\n");
+
+    // Descriptors smaller than the structure cannot be read.
+    put_desc(efi_map, stride, 0, EfiConventionalMemory, 0, 16);
+    if (e820_convert(efi_map, stride, stride - 8, conv) != 0)
+        fail("short descriptor stride accepted\n");
+
+    // A trailing partial descriptor is ignored.
+    if (e820_convert(efi_map, stride + stride / 2, stride, conv) != 1)
+        fail("partial descriptor\n");
+
+    // Empty and wrapping descriptors are skipped.
+    put_desc(efi_map, stride, 1, EfiReservedMemoryType, 0x100000, 0);
+    put_desc(efi_map, stride, 2, EfiReservedMemoryType, 0xFFFFFFFFFFFFF000ull, 2);
+    if (e820_convert(efi_map, 3 * stride, stride, conv) != 1 || conv->map[0].size != 16 * EFI_PAGE_SIZE)
+        fail("empty or wrapping descriptor not skipped\n");
+
+    // Reserved memory inside RAM splits it in three.
+    put_desc(efi_map, stride, 0, EfiConventionalMemory, 0, 256);
+    put_desc(efi_map, stride, 1, EfiRuntimeServicesData, 16 * EFI_PAGE_SIZE, 16);
+    if (e820_convert(efi_map, 2 * stride, stride, conv) != 3 ||
+        conv->map[1].type != E820_RESERVED || conv->map[2].addr != 32 * EFI_PAGE_SIZE ||
+        conv->map[2].type != E820_RAM)
+        fail("reserved range inside RAM\n");
+
+    // Adjacent RAM of different EFI types is merged.
+    put_desc(efi_map, stride, 0, EfiBootServicesData, 16 * EFI_PAGE_SIZE, 16);
+    put_desc(efi_map, stride, 1, EfiConventionalMemory, 0, 16);
+    if (e820_convert(efi_map, 2 * stride, stride, conv) != 1 || conv->map[0].size != 32 * EFI_PAGE_SIZE)
+        fail("adjacent RAM not merged\n");
+
+    // Running out of entries or boundaries is reported.
+    for (uint32_t i = 0; i < 8; i++)
+        put_desc(efi_map, stride, i, (i & 1) ? EfiACPIMemoryNVS : EfiConventionalMemory, i * EFI_PAGE_SIZE, 1);
+    small.max_entries = 4;
+    if (e820_convert(efi_map, 8 * stride, stride, &small) != 4 || !small.truncated)
+        fail("entry overflow not reported\n");
+    small = *conv;
+    small.max_points = 6;
+    if (e820_convert(efi_map, 8 * stride, stride, &small) != 3 || !small.truncated)
+        fail("boundary overflow not reported\n");
+}
+
+/* Conversion time as the map grows, best of BENCH_RUNS */
+static void bench(uint8_t *efi_map, e820_conv_t *conv)
+{
+    static const uint32_t counts[] = { 10, 30, 100, 300, 1000, 3000, 10000 };
+    uint32_t stride = sizeof(efi_memory_descriptor_t) + 8;
+
+    printf("e820: descriptors entries         ns   ns/desc\n");
+    for (uint32_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        uint32_t count = counts[c];
+        uint64_t best = ~0ull;
+
+        fill_map(efi_map, stride, count, false);
+        for (uint32_t run = 0; run < BENCH_RUNS; run++) {
+            uint64_t start = host_ns();
+            e820_convert(efi_map, count * stride, stride, conv);
+            uint64_t ns = host_ns() - start;
+            if (ns < best)
+                best = ns;
+        }
+
+        if (conv->truncated || e820_check(efi_map, count * stride, stride, conv->map, conv->entries))
+            fail("%d descriptors: converted map fails the checks\n", count);
+        printf("e820: %11d %7d %10llu %9llu\n", count, conv->entries, best, best / count);
+    }
+}
+
+int main(void)
+{
+    uint32_t stride = sizeof(efi_memory_descriptor_t) + 16;
+    uint8_t *efi_map = host_alloc(BENCH_MAX_DESC * stride);
+    uint8_t *expect = host_alloc(FUZZ_MAX_PAGES);
+    e820_conv_t conv;
+
+    host_init();
+
+    conv.points = host_alloc(MAX_POINTS * sizeof(e820_point_t));
+    conv.max_points = MAX_POINTS;
+    conv.map = host_alloc(MAX_POINTS * sizeof(struct e820_entry));
+    conv.max_entries = MAX_POINTS;
+
+    edge_cases(efi_map, &conv);
+    fuzz(efi_map, &conv, expect);
+    bench(efi_map, &conv);
+
+    printf("e820: %s\n", failures ? "FAILED" : "ok");
+    host_exit(failures != 0);
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Host test and benchmark of tinyprintf against the C library's printf.
+ * SPDX-License-Identifier: MIT
+*/
+
+/*
+ * The reference is the host's snprintf, so this file includes libc headers
+ * and none of ours. Field precision ('.'), the '+' and ' ' flags, '*' widths
+ * and floating point are not supported by tinyprintf and not tested.
+ */
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "host.h"
+
+/* From tinyprintf.h */
+extern int tfp_snprintf(char *str, size_t size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+/* Random values on top of the fixed ones */
+#define RANDOM_VALUES       2000
+
+/* Calls per format in the benchmark, best of BENCH_RUNS */
+#define BENCH_CALLS         200000
+#define BENCH_RUNS          5
+
+static unsigned long long seed = 0x9E3779B97F4A7C15ull;
+static unsigned long checks;
+static int failures;
+
+static unsigned long long test_random(void)
+{
+    // xorshift64
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+static void compare(const char *fmt, const char *expect, int expect_len, const char *got, int got_len)
+{
+    checks++;
+    if (expect_len == got_len && !strcmp(expect, got))
+        return;
+
+    if (failures++ < 20)
+        printf("FAIL: \"%s\": expected \"%s\" (%d), got \"%s\" (%d)\n", fmt, expect, expect_len, got, got_len);
+}
+
+#define CHECK(fmt, ...) \
+    do { \
+        char expect[128], got[128]; \
+        int expect_len = snprintf(expect, sizeof(expect), fmt, __VA_ARGS__); \
+        int got_len = tfp_snprintf(got, sizeof(got), fmt, __VA_ARGS__); \
+        compare(fmt, expect, expect_len, got, got_len); \
+    } while (0)
+
+/* Pass v as the type the length modifier asks for */
+#define CHECK_INT(signed_type, unsigned_type) \
+    do { \
+        if (is_signed) \
+            CHECK(fmt, (signed_type)v); \
+        else \
+            CHECK(fmt, (unsigned_type)v); \
+    } while (0)
+
+static const char *const lengths[] = { "hh", "h", "", "l", "ll", "z", "j", "t" };
+static const char *const flags[] = { "", "-", "0", "-0", "#", "#0", "-#" };
+static const char *const widths[] = { "", "1", "5", "12", "24" };
+
+/* One integer conversion, every length modifier, flag and width */
+static void check_integer(char conv, unsigned long long v)
+{
+    int is_signed = conv == 'd' || conv == 'i';
+
+    for (unsigned l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        for (unsigned f = 0; f < sizeof(flags) / sizeof(flags[0]); f++) {
+            // '#' is only defined for octal and hex.
+            if (strchr(flags[f], '#') && (is_signed || conv == 'u'))
+                continue;
+
+            for (unsigned w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+                char fmt[16];
+                const char *len = lengths[l];
+
+                snprintf(fmt, sizeof(fmt), "%%%s%s%s%c", flags[f], widths[w], len, conv);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+                if (!strcmp(len, "hh"))
+                    CHECK_INT(signed char, unsigned char);
+                else if (!strcmp(len, "h"))
+                    CHECK_INT(short, unsigned short);
+                else if (!strcmp(len, ""))
+                    CHECK_INT(int, unsigned int);
+                else if (!strcmp(len, "l"))
+                    CHECK_INT(long, unsigned long);
+                else if (!strcmp(len, "ll"))
+                    CHECK_INT(long long, unsigned long long);
+                else if (!strcmp(len, "z"))
+                    CHECK_INT(ptrdiff_t, size_t);
+                else if (!strcmp(len, "j"))
+                    CHECK_INT(intmax_t, uintmax_t);
+                else
+                    CHECK_INT(ptrdiff_t, size_t);
+#pragma GCC diagnostic pop
+            }
+        }
+    }
+}
+
+static void check_integers(unsigned long long v)
+{
+    static const char convs[] = "diuxXo";
+
+    for (const char *c = convs; *c; c++)
+        check_integer(*c, v);
+}
+
+static void check_others(void)
+{
+    static const char *const strings[] = { "", "a", "boot", "Legacy16Boot" };
+
+    for (unsigned i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+        CHECK("%s", strings[i]);
+        CHECK("[%8s]", strings[i]);
+        CHECK("[%-8s]", strings[i]);
+        CHECK("[%2s]", strings[i]);
+    }
+
+    CHECK("%c%c%c", 'a', ' ', '~');
+    CHECK("[%3c]", 'x');
+    CHECK("[%-3c]", 'x');
+    CHECK("100%%%s", "");
+    CHECK("%p", (void *)&seed);
+    CHECK("%p", (void *)(uintptr_t)0xE0000);
+    CHECK("%s=%d, %s=%#x, %s=%llu", "a", -5, "b", 0xbeef, "c", 18446744073709551615ull);
+}
+
+/* Output longer than the buffer is cut, with the full length returned. */
+static void check_truncation(void)
+{
+    for (size_t size = 1; size < 12; size++) {
+        char expect[16], got[16];
+        int expect_len, got_len;
+
+        memset(expect, 'X', sizeof(expect));
+        memset(got, 'X', sizeof(got));
+        expect_len = snprintf(expect, size, "%s %d", "truncated", -123);
+        got_len = tfp_snprintf(got, size, "%s %d", "truncated", -123);
+        compare("%s %d, truncated", expect, expect_len, got, got_len);
+        if (memcmp(expect, got, sizeof(got))) {
+            printf("FAIL: truncation to %zu bytes wrote past the end\n", size);
+            failures++;
+        }
+    }
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+static unsigned long long bench_one(int (*fn)(char *, size_t, const char *, ...), const char *fmt, unsigned long long v)
+{
+    unsigned long long best = ~0ull;
+    char buf[64];
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        unsigned long long start = host_ns(), ns;
+
+        for (unsigned long i = 0; i < BENCH_CALLS; i++)
+            fn(buf, sizeof(buf), fmt, v + i);
+        ns = host_ns() - start;
+        if (ns < best)
+            best = ns;
+    }
+
+    return best * 1000 / BENCH_CALLS;
+}
+#pragma GCC diagnostic pop
+
+static void bench(void)
+{
+    static const struct { const char *fmt; unsigned long long v; } cases[] = {
+        { "%llu", 42 },
+        { "%llu", 4000000000ull },
+        { "%llu", 18446744073709000000ull },
+        { "%llx", 0xFEDCBA9876543210ull },
+        { "%016llx", 0x123456789ull },
+        { "%llo", 0xFEDCBA9876543210ull },
+        { "%lld", -9223372036854775807ll },
+    };
+
+    printf("tinyprintf: %-10s %22s %10s %10s\n", "format", "value", "tinyprintf", "libc");
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        unsigned long long tfp = bench_one(tfp_snprintf, cases[i].fmt, cases[i].v);
+        unsigned long long libc = bench_one(snprintf, cases[i].fmt, cases[i].v);
+
+        char value[32];
+
+        snprintf(value, sizeof(value), cases[i].fmt, cases[i].v);
+        printf("tinyprintf: %-10s %22s %7llu.%02llu %7llu.%02llu ns\n", cases[i].fmt, value,
+               tfp / 1000, tfp % 1000 / 10, libc / 1000, libc % 1000 / 10);
+    }
+}
+
+int main(void)
+{
+    static const unsigned long long values[] = {
+        0, 1, 7, 8, 9, 10, 42, 99, 100, 127, 128, 255, 256, 999, 1000,
+        SHRT_MAX, (unsigned short)SHRT_MIN, USHRT_MAX, 65536,
+        INT_MAX, (unsigned int)INT_MIN, UINT_MAX, 1ull << 32,
+        999999999, 1000000000, 1000000001, 4294967295999999999ull,
+        9999999999ull, 10000000000ull, 1000000000000000000ull, 10000000000000000000ull,
+        LLONG_MAX, (unsigned long long)LLONG_MIN, ULLONG_MAX, ULLONG_MAX - 1,
+        0x123456789ABCDEFull, 0x8000000000000001ull,
+        -1ll, -9ll, -10ll, -42ll, -1000000000ll, (unsigned long long)(long long)INT_MIN - 1,
+    };
+
+    for (unsigned i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+        check_integers(values[i]);
+    for (unsigned i = 0; i < RANDOM_VALUES; i++) {
+        // Spread the random values over every magnitude.
+        check_integers(test_random() >> (test_random() % 64));
+    }
+    check_others();
+    check_truncation();
+    printf("tinyprintf: %d of %lu outputs differ from the C library\n", failures, checks);
+
+    bench();
+
+    printf("tinyprintf: %s\n", failures ? "FAILED" : "ok");
+    host_exit(failures != 0);
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: RDTSC based boot stage timeline.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "cpu.h"
+#include "cpuperf.h"
+#include "pmc.h"
+#include "timing.h"
+
+static timing_stage_t   stages[TIMING_MAX_STAGES];
+static uint32_t         num_stages;
+
+/* Time spent behind AsmThunk16, and the TSC when the current call started */
+static uint64_t         thunk_cycles;
+static uint64_t         thunk_start;
+static uint32_t         thunk_calls;
+
+static char             exit_stage[TIMING_NAME_MAX];
+static boolean_t        live_marks;
+
+void timing_init(void)
+{
+    num_stages = 0;
+    thunk_cycles = 0;
+    thunk_calls = 0;
+    if (!cmdline_get("exitat", exit_stage, sizeof(exit_stage)))
+        exit_stage[0] = '\0';
+    timing_mark("entry");
+    // The console is not up yet, so the first mark printed is "console".
+    live_marks = cmdline_has("timingmarks");
+}
+
+/* Stage names have spaces, which the command line cannot; `_` stands for one */
+static boolean_t stage_matches(const char *name, const char *arg)
+{
+    for (; *name && *arg; name++, arg++) {
+        if (*name != *arg && !(*name == ' ' && *arg == '_'))
+            return false;
+    }
+    return *name == *arg;
+}
+
+/*
+ * exitat=<stage>: stop right after the stage, print the timeline and
+ * leave through QEMU's isa-debug-exit device if there is one, so scripted
+ * runs end there. Anywhere else the CPU is simply halted.
+ */
+static noreturn void timing_exit(const char *name)
+{
+    timing_report();
+    printf("TIMING: exit at %s\n", name);
+
+    outb(TIMING_EXIT_PORT, 0);
+    for (;;)
+        asm volatile("cli; hlt");
+}
+
+void timing_thunk_begin(void)
+{
+    thunk_start = rdtsc();
+}
+
+void timing_thunk_end(void)
+{
+    thunk_cycles += rdtsc() - thunk_start;
+    thunk_calls++;
+}
+
+void timing_mark(const char *name)
+{
+    if (num_stages >= TIMING_MAX_STAGES)
+        return;
+
+    stages[num_stages].name = name;
+    stages[num_stages].tsc = rdtsc();
+    stages[num_stages].thunk = thunk_cycles;
+    if (pmc_enabled())
+        pmc_read(&stages[num_stages].pmc);
+    num_stages++;
+
+    // For a VMM that timestamps console output, see tools/kvmrun.c.
+    if (live_marks)
+        printf("TIMING: mark %s\n", name);
+
+    if (exit_stage[0] && stage_matches(name, exit_stage))
+        timing_exit(name);
+}
+
+/* cycles / mhz, in microseconds, without the 64-bit division helpers */
+static uint32_t cycles_to_us(uint64_t cycles, uint32_t mhz)
+{
+    uint64_t us = 0;
+    uint32_t rem = 0;
+
+    for (int bit = 63; bit >= 0; bit--) {
+        rem = (rem << 1) | (uint32_t)((cycles >> bit) & 1);
+        if (rem >= mhz) {
+            rem -= mhz;
+            us |= 1ULL << bit;
+        }
+    }
+
+    return us > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)us;
+}
+
+static void print_stage(const char *name, uint64_t cycles, uint64_t real, uint32_t mhz)
+{
+    printf("TIMING: %s %llu cycles", name, cycles);
+    if (mhz) {
+        uint32_t us = cycles_to_us(cycles, mhz);
+        printf(", %d.%03d ms", us / 1000, us % 1000);
+    }
+    if (real)
+        printf(", %llu in real mode", real);
+    printf("\n");
+}
+
+static void print_pmc_row(const char *name, const pmc_sample_t *delta)
+{
+    printf("PMC: %s", name);
+    for (uint32_t i = 0; i < PMC_COUNTERS; i++) {
+        printf(" %s=%llu", pmc_label(i), delta->count[i]);
+    }
+    printf("\n");
+}
+
+/*
+ * Hardware event counts per stage, in the same order as the TIMING: lines,
+ * and the share of them spent in real mode behind AsmThunk16.
+ */
+static void pmc_stage_report(void)
+{
+    pmc_sample_t delta;
+    uint32_t calls;
+
+    for (uint32_t i = 1; i < num_stages; i++) {
+        for (uint32_t c = 0; c < PMC_COUNTERS; c++)
+            delta.count[c] = (stages[i].pmc.count[c] - stages[i - 1].pmc.count[c]) & PMC_COUNTER_MASK;
+        print_pmc_row(stages[i].name, &delta);
+    }
+
+    calls = pmc_thunk_totals(&delta);
+    printf("PMC: %d thunk calls\n", calls);
+    print_pmc_row("thunk", &delta);
+}
+
+/*
+ * Dump the timeline. Every line starts with "TIMING:" so that boot logs
+ * captured over debugcon or serial can be scraped by scripts; the last line
+ * is the total from entry to the most recent mark. Milliseconds use the
+ * clock measured now, after cpuperf; stages that ran before it at a lower
+ * SpeedStep ratio took longer than shown.
+ */
+void timing_report(void)
+{
+    timing_stage_t *last;
+    uint32_t mhz;
+
+    if (num_stages == 0)
+        return;
+
+    last = &stages[num_stages - 1];
+    mhz = cpuperf_current_mhz();
+
+    for (uint32_t i = 1; i < num_stages; i++)
+        print_stage(stages[i].name, stages[i].tsc - stages[i - 1].tsc,
+                    stages[i].thunk - stages[i - 1].thunk, mhz);
+
+    print_stage("total", last->tsc - stages[0].tsc, last->thunk - stages[0].thunk, mhz);
+    printf("TIMING: %d real mode calls\n", thunk_calls);
+
+    if (pmc_enabled())
+        pmc_stage_report();
+}
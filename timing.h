@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the boot stage timeline.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#include "pmc.h"
+
+#define TIMING_MAX_STAGES   24
+#define TIMING_NAME_MAX     32
+
+/* QEMU -device isa-debug-exit,iobase=0xf4,iosize=0x04 */
+#define TIMING_EXIT_PORT    0xF4
+
+typedef struct _timing_stage_t
+{
+    const char  *name;
+    uint64_t    tsc;
+    uint64_t    thunk;      /* Cycles in real mode up to this mark */
+    pmc_sample_t pmc;       /* Only with pmc= */
+} timing_stage_t;
+
+/* Functions */
+extern void timing_init(void);
+extern void timing_mark(const char *name);
+extern void timing_report(void);
+extern void timing_thunk_begin(void);
+extern void timing_thunk_end(void);
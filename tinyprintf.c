@@ -30,7 +30,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #define PRINTF_LONG_SUPPORT
 
 /* Enable long long int support (implies long int support) */
-//#define PRINTF_LONG_LONG_SUPPORT
+#define PRINTF_LONG_LONG_SUPPORT
 
 /* Enable %z (size_t) support */
 #define PRINTF_SIZE_T_SUPPORT
@@ -81,91 +81,180 @@ struct param {
 };
 
 
+/*
+ * Number conversion. Digits are produced least significant first, backwards
+ * from the end of a scratch buffer, then copied to p->bf. Octal and hex use
+ * shifts and masks; decimal takes two digits per step from a table, and the
+ * division by 100 is by a constant, which compilers turn into a multiply.
+ * Nothing here needs the compiler's 64-bit division helpers.
+ */
+#define TFP_DIGITS_MAX  23  /* 64-bit octal and the terminator */
+
+static const char digits_lc[] = "0123456789abcdef";
+static const char digits_uc[] = "0123456789ABCDEF";
+
+static const char digit_pairs[] =
+    "00010203040506070809" "10111213141516171819"
+    "20212223242526272829" "30313233343536373839"
+    "40414243444546474849" "50515253545556575859"
+    "60616263646566676869" "70717273747576777879"
+    "80818283848586878889" "90919293949596979899";
+
+static char *uli2a_dec(unsigned long num, char *end)
+{
+    while (num >= 100) {
+        unsigned long q = num / 100;
+        const char *pair = &digit_pairs[(num - q * 100) * 2];
+        *--end = pair[1];
+        *--end = pair[0];
+        num = q;
+    }
+    if (num >= 10) {
+        *--end = digit_pairs[num * 2 + 1];
+        *--end = digit_pairs[num * 2];
+    } else {
+        *--end = '0' + num;
+    }
+    return end;
+}
+
+static void put_digits(const char *first, const char *end, struct param *p)
+{
+    char *bf = p->bf;
+    while (first < end)
+        *bf++ = *first++;
+    *bf = 0;
+}
+
+#ifdef PRINTF_LONG_SUPPORT
+static void uli2a(unsigned long int num, struct param *p)
+#else
+static void ui2a(unsigned int num, struct param *p)
+#endif
+{
+    char tmp[TFP_DIGITS_MAX];
+    char *end = tmp + sizeof(tmp);
+    char *first;
+
+    if (p->base == 10) {
+        first = uli2a_dec(num, end);
+    } else {
+        const char *digits = p->uc ? digits_uc : digits_lc;
+        unsigned int shift = (p->base == 8) ? 3 : 4;
+
+        first = end;
+        do {
+            *--first = digits[num & (p->base - 1)];
+            num >>= shift;
+        } while (num);
+    }
+    put_digits(first, end, p);
+}
+
+#ifdef PRINTF_LONG_SUPPORT
+# define ui2a(num, p)   uli2a((num), (p))
+#endif
+
 #ifdef PRINTF_LONG_LONG_SUPPORT
+/*
+ * 64-bit values above 32 bits. Octal and hex shift the 64-bit value
+ * directly; decimal splits off four digits at a time with a long division
+ * by 10^4 over 16-bit limbs, where every step fits 32 bits. Hosts with a
+ * 64-bit long take the same path, so the host tests cover the i386 code.
+ */
 static void _TFP_GCC_NO_INLINE_ ulli2a(
         unsigned long long int num, struct param *p)
 {
-    int n = 0;
-    unsigned long long int d = 1;
-    char *bf = p->bf;
-    while (num / d >= p->base)
-        d *= p->base;
-    while (d != 0) {
-        int dgt = num / d;
-        num %= d;
-        d /= p->base;
-        if (n || dgt > 0 || d == 0) {
-            *bf++ = dgt + (dgt < 10 ? '0' : (p->uc ? 'A' : 'a') - 10);
-            ++n;
+    char tmp[TFP_DIGITS_MAX];
+    char *end = tmp + sizeof(tmp);
+    char *first = end;
+
+    if (!(num >> 32)) {
+        uli2a((unsigned long)num, p);
+        return;
+    }
+
+    if (p->base != 10) {
+        const char *digits = p->uc ? digits_uc : digits_lc;
+        unsigned int shift = (p->base == 8) ? 3 : 4;
+
+        do {
+            *--first = digits[(unsigned int)num & (p->base - 1)];
+            num >>= shift;
+        } while (num);
+        put_digits(first, end, p);
+        return;
+    }
+
+    while (num >> 32) {
+        unsigned long long q = 0;
+        unsigned long r = 0;
+        char *chunk = first - 4;
+
+        for (int shift = 48; shift >= 0; shift -= 16) {
+            unsigned long cur = (r << 16) | (unsigned long)((num >> shift) & 0xFFFF);
+            unsigned long digit = cur / 10000;
+
+            r = cur - digit * 10000;
+            q |= (unsigned long long)digit << shift;
         }
+        first = uli2a_dec(r, first);
+        while (first > chunk)
+            *--first = '0';
+        num = q;
     }
-    *bf = 0;
+    first = uli2a_dec((unsigned long)num, first);
+    put_digits(first, end, p);
 }
 
 static void lli2a(long long int num, struct param *p)
 {
     if (num < 0) {
-        num = -num;
         p->sign = '-';
+        ulli2a(-(unsigned long long int)num, p);
+        return;
     }
     ulli2a(num, p);
 }
 #endif
 
 #ifdef PRINTF_LONG_SUPPORT
-static void uli2a(unsigned long int num, struct param *p)
-{
-    int n = 0;
-    unsigned long int d = 1;
-    char *bf = p->bf;
-    while (num / d >= p->base)
-        d *= p->base;
-    while (d != 0) {
-        int dgt = num / d;
-        num %= d;
-        d /= p->base;
-        if (n || dgt > 0 || d == 0) {
-            *bf++ = dgt + (dgt < 10 ? '0' : (p->uc ? 'A' : 'a') - 10);
-            ++n;
-        }
-    }
-    *bf = 0;
-}
-
 static void li2a(long num, struct param *p)
 {
     if (num < 0) {
-        num = -num;
         p->sign = '-';
+        uli2a(-(unsigned long int)num, p);
+        return;
     }
     uli2a(num, p);
 }
 #endif
 
-static void ui2a(unsigned int num, struct param *p)
+/* Arguments narrower than int arrive promoted; h and hh convert them back. */
+static unsigned int narrow_u(unsigned int num, char half)
 {
-    int n = 0;
-    unsigned int d = 1;
-    char *bf = p->bf;
-    while (num / d >= p->base)
-        d *= p->base;
-    while (d != 0) {
-        int dgt = num / d;
-        num %= d;
-        d /= p->base;
-        if (n || dgt > 0 || d == 0) {
-            *bf++ = dgt + (dgt < 10 ? '0' : (p->uc ? 'A' : 'a') - 10);
-            ++n;
-        }
-    }
-    *bf = 0;
+    if (half == 2)
+        return (unsigned char)num;
+    if (half == 1)
+        return (unsigned short)num;
+    return num;
+}
+
+static int narrow_i(int num, char half)
+{
+    if (half == 2)
+        return (signed char)num;
+    if (half == 1)
+        return (short)num;
+    return num;
 }
 
 static void i2a(int num, struct param *p)
 {
     if (num < 0) {
-        num = -num;
         p->sign = '-';
+        ui2a(-(unsigned int)num, p);
+        return;
     }
     ui2a(num, p);
 }
@@ -204,6 +293,12 @@ static void putchw(void *putp, putcf putf, struct param *p)
     int n = p->width;
     char *bf = p->bf;
 
+    /* As in C: no 0x or leading 0 for a zero, and '-' overrides '0' */
+    if (p->bf[0] == '0' && p->bf[1] == 0)
+        p->alt = 0;
+    if (p->align_left)
+        p->lz = 0;
+
     /* Number of filling characters */
     while (*bf++ && n > 0)
         n--;
@@ -268,6 +363,7 @@ void tfp_format(void *putp, putcf putf, const char *fmt, va_list va)
 #ifdef PRINTF_LONG_SUPPORT
             char lng = 0;  /* 1 for long, 2 for long long */
 #endif
+            char half = 0;  /* 1 for short, 2 for char */
             /* Init parameter struct */
             p.lz = 0;
             p.alt = 0;
@@ -309,9 +405,19 @@ void tfp_format(void *putp, putcf putf, const char *fmt, va_list va)
                 } while ((ch >= '0') && (ch <= '9'));
             }
 
+            if (ch == 'h') {
+                ch = *(fmt++);
+                half = 1;
+                if (ch == 'h') {
+                    ch = *(fmt++);
+                    half = 2;
+                }
+            }
+
 #ifdef PRINTF_SIZE_T_SUPPORT
 # ifdef PRINTF_LONG_SUPPORT
-            if (ch == 'z') {
+            /* ptrdiff_t is as wide as size_t */
+            if (ch == 'z' || ch == 't') {
                 ch = *(fmt++);
                 if (sizeof(size_t) == sizeof(unsigned long int))
                     lng = 1;
@@ -335,6 +441,14 @@ void tfp_format(void *putp, putcf putf, const char *fmt, va_list va)
 #endif
             }
 #endif
+
+#ifdef PRINTF_LONG_LONG_SUPPORT
+            /* intmax_t is 64 bits wide */
+            if (ch == 'j') {
+                ch = *(fmt++);
+                lng = 2;
+            }
+#endif
             switch (ch) {
                 case 0:
                     goto abort;
@@ -350,7 +464,7 @@ void tfp_format(void *putp, putcf putf, const char *fmt, va_list va)
                         uli2a(va_arg(va, unsigned long int), &p);
                     else
 #endif
-                    ui2a(va_arg(va, unsigned int), &p);
+                    ui2a(narrow_u(va_arg(va, unsigned int), half), &p);
                     putchw(putp, putf, &p);
                     break;
                 case 'd':
@@ -366,7 +480,7 @@ void tfp_format(void *putp, putcf putf, const char *fmt, va_list va)
                         li2a(va_arg(va, long int), &p);
                     else
 #endif
-                    i2a(va_arg(va, int), &p);
+                    i2a(narrow_i(va_arg(va, int), half), &p);
                     putchw(putp, putf, &p);
                     break;
 #ifdef SIZEOF_POINTER
@@ -382,7 +496,8 @@ void tfp_format(void *putp, putcf putf, const char *fmt, va_list va)
 #endif
                 case 'x':
                 case 'X':
-                    p.base = 16;
+                case 'o':
+                    p.base = (ch == 'o') ? 8 : 16;
                     p.uc = (ch == 'X')?1:0;
 #ifdef PRINTF_LONG_SUPPORT
 #ifdef PRINTF_LONG_LONG_SUPPORT
@@ -394,16 +509,14 @@ void tfp_format(void *putp, putcf putf, const char *fmt, va_list va)
                         uli2a(va_arg(va, unsigned long int), &p);
                     else
 #endif
-                    ui2a(va_arg(va, unsigned int), &p);
-                    putchw(putp, putf, &p);
-                    break;
-                case 'o':
-                    p.base = 8;
-                    ui2a(va_arg(va, unsigned int), &p);
+                    ui2a(narrow_u(va_arg(va, unsigned int), half), &p);
                     putchw(putp, putf, &p);
                     break;
                 case 'c':
-                    putf(putp, (char)(va_arg(va, int)));
+                    bf[0] = (char)(va_arg(va, int));
+                    bf[1] = 0;
+                    p.lz = 0;
+                    putchw(putp, putf, &p);
                     break;
                 case 's':
                     p.bf = va_arg(va, char *);
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Replay a firmware handoff capture through build_e820_map,
+ *          copy_rsdt and set_smbios_table on the host.
+ * SPDX-License-Identifier: MIT
+*/
+
+/*
+ * Reads a boot log with the CAPTURE: lines printed by the `capture` option,
+ * maps every block at the address it was captured from and runs the
+ * kernel's own code on it, then times each function. The captured data is
+ * full of 32-bit pointers, so this has to be built as a 32-bit program.
+ */
+
+#include "csmwrapple.h"
+#include "capture.h"
+#include "host.h"
+
+/* Calls per function in the benchmark */
+#define REPLAY_RUNS         1000
+
+/* Stand-in for the CSM image copy_rsdt copies the RSDP into */
+#define REPLAY_CSM_BASE     0xE0000
+#define REPLAY_CSM_SIZE     0x20000
+#define REPLAY_RSDP_OFFSET  0x100
+
+#define CAPTURE_PREFIX      "CAPTURE: "
+
+mach_boot_args_t *gBA;
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * Collect the bytes of every "CAPTURE: <offset> <hex>" line, wherever the
+ * prefix is on the line, checking that the offsets follow on. Anything
+ * else in the log is skipped; a second capture in the same log is ignored.
+ */
+static uint8_t *parse_log(const char *log, uint32_t *size)
+{
+    uint8_t *blob = host_alloc(strlen(log) / 2 + 1);
+    const char *line = log;
+    uint32_t fill = 0;
+
+    *size = 0;
+    while (*line) {
+        const char *end = strchr(line, '\n');
+        const char *p;
+        uint32_t offset = 0;
+        int n;
+
+        if (end == NULL)
+            end = line + strlen(line);
+
+        p = memmem(line, end - line, CAPTURE_PREFIX, sizeof(CAPTURE_PREFIX) - 1);
+        if (p != NULL) {
+            p += sizeof(CAPTURE_PREFIX) - 1;
+            for (n = 0; n < 8 && p < end && hex_digit(*p) >= 0; n++, p++)
+                offset = (offset << 4) | hex_digit(*p);
+
+            // The closing "CAPTURE: end, ..." line has no offset.
+            if (n == 8 && p < end && *p == ' ') {
+                if (offset == 0 && fill != 0)
+                    break;
+                if (offset != fill) {
+                    printf("capreplay: bytes %x to %x of the capture are missing\n", fill, offset - 1);
+                    return NULL;
+                }
+                for (p++; p + 1 < end && hex_digit(p[0]) >= 0 && hex_digit(p[1]) >= 0; p += 2)
+                    blob[fill++] = (hex_digit(p[0]) << 4) | hex_digit(p[1]);
+            }
+        }
+
+        line = *end ? end + 1 : end;
+    }
+
+    *size = fill;
+    return blob;
+}
+
+/*
+ * Check the capture and copy every block back to its original address.
+ * Returns the replayed boot args, or NULL if the capture is damaged or an
+ * address is not available in this process.
+ */
+static mach_boot_args_t *replay(const uint8_t *blob, uint32_t size)
+{
+    const uint8_t *p = blob;
+    const uint8_t *end = p + size;
+    mach_boot_args_t *ba = NULL;
+    uint32_t sum = 1;
+
+    while (p + sizeof(capture_block_t) <= end) {
+        const capture_block_t *block = (const capture_block_t *)p;
+        uint32_t padded;
+        void *dst;
+
+        if (block->magic != CAPTURE_MAGIC || block->version != CAPTURE_VERSION) {
+            printf("capreplay: no block at offset %x\n", (uint32_t)(p - blob));
+            return NULL;
+        }
+
+        if (block->type == CAPTURE_END) {
+            if (block->addr != sum) {
+                printf("capreplay: checksum %08x, expected %08x\n", sum, block->addr);
+                return NULL;
+            }
+            if (ba == NULL)
+                printf("capreplay: no boot args in the capture\n");
+            return ba;
+        }
+
+        padded = (block->size + 3) & ~3;
+        if (block->size > CAPTURE_MAX_BLOCK || padded > (uint32_t)(end - p) - sizeof(capture_block_t)) {
+            printf("capreplay: block at offset %x is cut short\n", (uint32_t)(p - blob));
+            return NULL;
+        }
+
+        sum = capture_checksum(sum, p, sizeof(capture_block_t) + padded);
+
+        dst = host_map_at(block->addr, block->size);
+        if (dst == NULL) {
+            printf("capreplay: cannot map %x-%x in this process\n", block->addr, block->addr + block->size - 1);
+            return NULL;
+        }
+        memcpy(dst, p + sizeof(capture_block_t), block->size);
+
+        if (block->type == CAPTURE_BOOT_ARGS && block->size == sizeof(mach_boot_args_t))
+            ba = dst;
+
+        p += sizeof(capture_block_t) + padded;
+    }
+
+    printf("capreplay: capture has no end block\n");
+    return NULL;
+}
+
+static void discard_putc(void *p, char c)
+{
+    (void)p;
+    (void)c;
+}
+
+/* Average time per call of `fn`, with its messages silenced */
+static uint64_t time_calls(int (*fn)(struct csmwrap_priv *), struct csmwrap_priv *priv)
+{
+    uint64_t start, ns;
+
+    init_printf(NULL, discard_putc);
+    start = host_ns();
+    for (uint32_t i = 0; i < REPLAY_RUNS; i++)
+        fn(priv);
+    ns = host_ns() - start;
+    host_init();
+
+    return ns / REPLAY_RUNS;
+}
+
+int main(int argc, char **argv)
+{
+    EFI_COMPATIBILITY16_TABLE csm_table;
+    struct csmwrap_priv priv;
+    char signature[9] = { 0 }, oem[7] = { 0 };
+    const uint8_t *rsdp;
+    uint8_t *blob;
+    char *log;
+    uint32_t size;
+    int entries;
+
+    host_init();
+    if (argc != 2) {
+        printf("usage: capreplay <boot log>\n");
+        host_exit(2);
+    }
+
+    log = host_read_file(argv[1], NULL);
+    if (log == NULL) {
+        printf("capreplay: cannot read %s\n", argv[1]);
+        host_exit(2);
+    }
+
+    blob = parse_log(log, &size);
+    if (blob == NULL)
+        host_exit(1);
+    if (size == 0) {
+        printf("capreplay: no capture in %s\n", argv[1]);
+        host_exit(1);
+    }
+
+    gBA = replay(blob, size);
+    if (gBA == NULL)
+        host_exit(1);
+
+    printf("capreplay: %d bytes, boot args %d.%d, %d byte EFI memory map of %d byte descriptors\n",
+           size, gBA->revision, gBA->version, gBA->efi_mem_map_size, gBA->efi_mem_desc_size);
+
+    memset(&priv, 0, sizeof(priv));
+    memset(&csm_table, 0, sizeof(csm_table));
+    priv.csm_bin = host_alloc(REPLAY_CSM_SIZE);
+    priv.csm_bin_base = REPLAY_CSM_BASE;
+    priv.csm_efi_table = &csm_table;
+    priv.low_stub = host_alloc(sizeof(struct low_stub));
+    csm_table.AcpiRsdPtrPointer = REPLAY_CSM_BASE + REPLAY_RSDP_OFFSET;
+
+    if (copy_rsdt(&priv) == 0) {
+        rsdp = priv.csm_bin + REPLAY_RSDP_OFFSET;
+        memcpy(signature, rsdp, 8);
+        memcpy(oem, rsdp + 9, 6);
+        printf("capreplay: RSDP \"%s\", OEM \"%s\", revision %d\n", signature, oem, rsdp[15]);
+    }
+
+    if (set_smbios_table(&priv) == 0)
+        printf("capreplay: SMBIOS table at %x\n", priv.low_stub->boot_table.SmbiosTable);
+
+    entries = build_e820_map(&priv);
+    for (int i = 0; i < entries; i++) {
+        struct e820_entry *e = &priv.low_stub->e820_map[i];
+        printf("E820: [%016llx-%016llx] type %d\n", e->addr, e->addr + e->size - 1, e->type);
+    }
+
+    printf("capreplay: build_e820_map %llu ns, copy_rsdt %llu ns, set_smbios_table %llu ns\n",
+           time_calls(build_e820_map, &priv), time_calls(copy_rsdt, &priv),
+           time_calls(set_smbios_table, &priv));
+
+    host_exit(0);
+    return 0;
+}
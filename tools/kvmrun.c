@@ -0,0 +1,832 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Minimal KVM virtual machine that boots mach_kernel through the
+ *          QEMU loader and times its boot stages.
+ * SPDX-License-Identifier: MIT
+*/
+
+/*
+ * The guest is a PC with 256 MiB and no firmware: guest RAM with the
+ * memory map QEMU would report, a Bochs display framebuffer, a host bridge
+ * and the display on PCI bus 0, CMOS and PIT channel 2 for calibration.
+ * Every other port reads as a floating bus. tests/qemu/loader.elf is loaded
+ * like a multiboot kernel with mach_kernel as its module, so the boot args,
+ * EFI memory map and framebuffer are built by the same code as under QEMU.
+ *
+ * Port 0xE9 output is timestamped on the host as it arrives, and the
+ * `TIMING: mark <stage>` lines printed with `timingmarks` give the time of
+ * every stage, the Legacy16 calls included. A run ends on `hlt`, on a write
+ * to the isa-debug-exit port (exitat=) or after the timeout.
+ *
+ * This is a host program built against libc. boot_args.h, cpuperf.h and the
+ * loader's header only need the fixed width integer types, so no other
+ * header of ours is included.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/kvm.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "boot_args.h"
+#include "cpuperf.h"
+#include "tests/qemu/loader.h"
+
+#define VM_RAM_SIZE         (256u << 20)
+#define VM_FB_BASE          0xE0000000u
+#define VM_FB_SIZE          (16u << 20)     /* BAR 0 of the Bochs display */
+#define VM_TSS_ADDR         0xFFFBD000u
+#define VM_IDENTITY_ADDR    0xFFFBC000u
+#define VM_MBI_BASE         0x9000u         /* Multiboot info, memory map, strings */
+#define VM_BOOT_STACK       0x8000u
+
+#define VM_DEBUGCON_PORT    0xE9            /* cons.h: DEBUGCON_PORT */
+#define VM_EXIT_PORT        0xF4            /* timing.h: TIMING_EXIT_PORT */
+#define VM_PCI_ADDRESS      0xCF8
+#define VM_PCI_DATA         0xCFC
+#define VM_CMOS_INDEX       0x70
+#define VM_CMOS_DATA        0x71
+#define VM_PIT_CH0_PORT     0x40
+
+#define VM_HOST_BRIDGE      0x00            /* devfn 00.0 */
+#define VM_DISPLAY          0x10            /* devfn 02.0 */
+
+#define VM_DEFAULT_ARGS     "console=debugcon timingmarks"
+#define VM_DEFAULT_TIMEOUT  30
+#define VM_MAX_RUNS         64
+#define VM_MAX_MARKS        32
+#define VM_LINE_MAX         256
+#define VM_MAX_CPUID        128
+
+typedef enum {
+    VM_END_NONE,
+    VM_END_DEBUG_EXIT,
+    VM_END_HLT,
+    VM_END_SHUTDOWN,
+    VM_END_TIMEOUT,
+    VM_END_ERROR,
+} vm_end_t;
+
+static const char *const end_names[] = {
+    "running", "debug exit", "hlt", "triple fault", "timeout", "KVM error",
+};
+
+typedef struct _vm_mark_t
+{
+    char        name[32];
+    uint64_t    ns;
+} vm_mark_t;
+
+typedef struct _vm_run_t
+{
+    vm_mark_t   marks[VM_MAX_MARKS];
+    uint32_t    num_marks;
+    uint64_t    end_ns;
+    uint64_t    exits;
+    vm_end_t    end;
+    uint32_t    exit_code;
+    int         reached_boot;       /* The timeline before Legacy16Boot was printed */
+} vm_run_t;
+
+/* PIT channel 2 as far as TSC calibration needs it, driven by the host clock */
+typedef struct _vm_pit_t
+{
+    uint8_t     gate;               /* Port 0x61, bits 0 and 1 */
+    uint8_t     mode;
+    uint16_t    count;
+    uint16_t    latch;
+    int         latched;
+    int         write_high;
+    int         read_high;
+    int         ch0_read_high;
+    uint8_t     refresh;
+    uint64_t    start_ns;
+} vm_pit_t;
+
+typedef struct _vm_t
+{
+    int             fd;
+    int             vcpu;
+    struct kvm_run  *run;
+    size_t          run_size;
+    uint8_t         *ram;
+    uint8_t         *fb;
+
+    uint32_t        pci_address;
+    uint8_t         pci_config[2][256];
+    uint8_t         cmos_index;
+    uint8_t         cmos[128];
+    uint16_t        dispi_index;
+    uint16_t        dispi[16];
+    vm_pit_t        pit;
+
+    char            line[VM_LINE_MAX];
+    uint32_t        line_len;
+    uint64_t        start_ns;
+    int             quiet;
+    vm_run_t        *result;
+} vm_t;
+
+static int kvm_fd = -1;
+static struct kvm_run *volatile current_run;
+static volatile sig_atomic_t timed_out;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static noreturn void die(const char *what)
+{
+    fprintf(stderr, "kvmrun: %s: %s\n", what, strerror(errno));
+    exit(2);
+}
+
+static void on_alarm(int sig)
+{
+    (void)sig;
+    timed_out = 1;
+    if (current_run != NULL)
+        current_run->immediate_exit = 1;
+}
+
+static void *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    void *data;
+    long len;
+
+    if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fprintf(stderr, "kvmrun: cannot read %s\n", path);
+        exit(2);
+    }
+    data = malloc(len ? len : 1);
+    if (data == NULL || fread(data, 1, len, f) != (size_t)len) {
+        fprintf(stderr, "kvmrun: cannot read %s\n", path);
+        exit(2);
+    }
+    fclose(f);
+    *size = len;
+    return data;
+}
+
+/*
+ * Copy the loader's PT_LOAD segments into guest RAM, like QEMU's multiboot
+ * support does. Returns the entry point and the end of the image.
+ */
+static uint32_t load_loader(vm_t *vm, const uint8_t *image, size_t size, uint32_t *end)
+{
+    const elf_header_t *eh = (const elf_header_t *)image;
+
+    if (size < sizeof(*eh) || eh->magic != ELF_MAGIC || eh->phentsize < sizeof(elf_phdr_t) ||
+        eh->phoff > size || eh->phnum > (size - eh->phoff) / eh->phentsize) {
+        fprintf(stderr, "kvmrun: the loader is not a 32-bit ELF file\n");
+        exit(2);
+    }
+
+    *end = 0;
+    for (uint32_t i = 0; i < eh->phnum; i++) {
+        const elf_phdr_t *ph = (const elf_phdr_t *)(image + eh->phoff + i * eh->phentsize);
+
+        if (ph->type != ELF_PT_LOAD || ph->memsz == 0)
+            continue;
+        if (ph->offset > size || ph->filesz > size - ph->offset || ph->filesz > ph->memsz ||
+            ph->paddr >= VM_RAM_SIZE || ph->memsz > VM_RAM_SIZE - ph->paddr) {
+            fprintf(stderr, "kvmrun: loader segment at %x does not fit\n", ph->paddr);
+            exit(2);
+        }
+        memcpy(vm->ram + ph->paddr, image + ph->offset, ph->filesz);
+        memset(vm->ram + ph->paddr + ph->filesz, 0, ph->memsz - ph->filesz);
+        if (ph->paddr + ph->memsz > *end)
+            *end = ph->paddr + ph->memsz;
+    }
+
+    return eh->entry;
+}
+
+static void add_mmap(multiboot_mmap_t **e, uint64_t addr, uint64_t len, uint32_t type)
+{
+    (*e)->size = sizeof(multiboot_mmap_t) - sizeof((*e)->size);
+    (*e)->addr = addr;
+    (*e)->len = len;
+    (*e)->type = type;
+    (*e)++;
+}
+
+/* The multiboot info QEMU would build, with the kernel placed after the loader */
+static uint32_t build_multiboot(vm_t *vm, uint32_t loader_end, const void *kernel, size_t kernel_size,
+                                const char *cmdline)
+{
+    multiboot_info_t *mbi = (multiboot_info_t *)(vm->ram + VM_MBI_BASE);
+    multiboot_module_t *mod = (multiboot_module_t *)(mbi + 1);
+    multiboot_mmap_t *first = (multiboot_mmap_t *)(mod + 1);
+    multiboot_mmap_t *e = first;
+    uint32_t mod_start = (loader_end + 0xFFF) & ~0xFFFu;
+    char *strings;
+
+    if (kernel_size > VM_RAM_SIZE - mod_start) {
+        fprintf(stderr, "kvmrun: the kernel does not fit in guest RAM\n");
+        exit(2);
+    }
+    memcpy(vm->ram + mod_start, kernel, kernel_size);
+
+    add_mmap(&e, 0, 0x9FC00, MULTIBOOT_MEMORY_AVAILABLE);
+    add_mmap(&e, 0x9FC00, 0x400, 2);
+    add_mmap(&e, 0xF0000, 0x10000, 2);
+    add_mmap(&e, 0x100000, VM_RAM_SIZE - 0x100000, MULTIBOOT_MEMORY_AVAILABLE);
+    add_mmap(&e, 0xFFFC0000, 0x40000, 2);
+
+    strings = (char *)e;
+    mod->mod_start = mod_start;
+    mod->mod_end = mod_start + kernel_size;
+    mod->string = (uint32_t)((uint8_t *)strings - vm->ram);
+    strings += sprintf(strings, "mach_kernel") + 1;
+
+    mbi->flags = MULTIBOOT_INFO_CMDLINE | MULTIBOOT_INFO_MODS | MULTIBOOT_INFO_MMAP;
+    mbi->mem_lower = 0x9FC00 >> 10;
+    mbi->mem_upper = (VM_RAM_SIZE - 0x100000) >> 10;
+    mbi->cmdline = (uint32_t)((uint8_t *)strings - vm->ram);
+    snprintf(strings, MACH_CMDLINE, "loader.elf %s", cmdline);
+    mbi->mods_count = 1;
+    mbi->mods_addr = (uint32_t)((uint8_t *)mod - vm->ram);
+    mbi->mmap_addr = (uint32_t)((uint8_t *)first - vm->ram);
+    mbi->mmap_length = (uint32_t)((uint8_t *)e - (uint8_t *)first);
+
+    return VM_MBI_BASE;
+}
+
+static void set_pci_id(uint8_t *config, uint16_t vendor, uint16_t device, uint32_t class)
+{
+    *(uint16_t *)(config + 0x00) = vendor;
+    *(uint16_t *)(config + 0x02) = device;
+    *(uint32_t *)(config + 0x08) = class << 8;
+}
+
+static void init_devices(vm_t *vm)
+{
+    set_pci_id(vm->pci_config[0], 0x8086, I440FX_DEVICE_ID, 0x060000);
+    set_pci_id(vm->pci_config[1], BOCHS_VENDOR_ID, BOCHS_DEVICE_ID, 0x038000);
+    // Memory decode on, prefetchable 32-bit BAR 0, no MMIO BAR so the DISPI ports are used.
+    *(uint16_t *)(vm->pci_config[1] + 0x04) = 0x0002;
+    *(uint32_t *)(vm->pci_config[1] + 0x10) = VM_FB_BASE | 0x8;
+
+    vm->cmos[0x0A] = 0x26;
+    vm->cmos[0x0B] = 0x02;
+    vm->cmos[0x0D] = 0x80;
+}
+
+static uint8_t *pci_device(vm_t *vm)
+{
+    uint8_t devfn = (vm->pci_address >> 8) & 0xFF;
+
+    if (!(vm->pci_address & 0x80000000) || (vm->pci_address >> 16) & 0xFF)
+        return NULL;
+    if (devfn == VM_HOST_BRIDGE)
+        return vm->pci_config[0];
+    if (devfn == VM_DISPLAY)
+        return vm->pci_config[1];
+    return NULL;
+}
+
+static void pci_config_write(vm_t *vm, uint8_t *config, uint32_t reg, uint32_t size, uint32_t value)
+{
+    for (uint32_t i = 0; i < size; i++, reg++, value >>= 8) {
+        // BAR 0 of the display decodes VM_FB_SIZE, the other BARs are absent.
+        if (config == vm->pci_config[1] && reg >= 0x10 && reg < 0x28) {
+            if (reg < 0x14) {
+                uint32_t bar = *(uint32_t *)(config + 0x10);
+
+                ((uint8_t *)&bar)[reg - 0x10] = (uint8_t)value;
+                *(uint32_t *)(config + 0x10) = (bar & ~(VM_FB_SIZE - 1)) | 0x8;
+            }
+            continue;
+        }
+        if ((reg >= 0x04 && reg < 0x08) || reg >= 0x40)
+            config[reg] = (uint8_t)value;
+    }
+}
+
+/* Ticks of the 1.193182 MHz PIT clock since channel 2 was (re)started */
+static uint64_t pit_ticks(vm_pit_t *pit)
+{
+    return (now_ns() - pit->start_ns) * PIT_HZ / 1000000000ull;
+}
+
+static uint16_t pit_ch2_count(vm_pit_t *pit)
+{
+    uint32_t count = pit->count ? pit->count : 0x10000;
+    uint64_t ticks = pit_ticks(pit);
+
+    if (pit->mode == 0)
+        return (uint16_t)(count - ticks);
+    return (uint16_t)(count - ticks % count);
+}
+
+static int pit_out2(vm_pit_t *pit)
+{
+    uint32_t count = pit->count ? pit->count : 0x10000;
+    uint64_t ticks = pit_ticks(pit);
+
+    if (!(pit->gate & PIT_GATE_CH2))
+        return pit->mode != 0;
+    switch (pit->mode) {
+        case 0:
+            return ticks >= count;
+        case 2:
+            return ticks % count != count - 1;
+        default:
+            return ticks % count < count / 2;
+    }
+}
+
+static uint32_t pit_read(vm_t *vm, uint16_t port)
+{
+    vm_pit_t *pit = &vm->pit;
+    uint16_t value;
+
+    switch (port) {
+        case PIT_GATE_PORT:
+            pit->refresh ^= 0x10;
+            return pit->gate | pit->refresh | (pit_out2(pit) ? PIT_GATE_OUT2 : 0);
+        case PIT_CH2_PORT:
+            value = pit->latched ? pit->latch : pit_ch2_count(pit);
+            if (pit->read_high)
+                pit->latched = 0;
+            pit->read_high = !pit->read_high;
+            return pit->read_high ? value & 0xFF : value >> 8;
+        default:
+            // Channel 0 free runs at its full period.
+            value = (uint16_t)(0x10000 - (now_ns() * PIT_HZ / 1000000000ull) % 0x10000);
+            pit->ch0_read_high = !pit->ch0_read_high;
+            return pit->ch0_read_high ? value & 0xFF : value >> 8;
+    }
+}
+
+static void pit_write(vm_t *vm, uint16_t port, uint8_t value)
+{
+    vm_pit_t *pit = &vm->pit;
+
+    switch (port) {
+        case PIT_GATE_PORT:
+            if ((value & PIT_GATE_CH2) && !(pit->gate & PIT_GATE_CH2))
+                pit->start_ns = now_ns();
+            pit->gate = value & (PIT_GATE_CH2 | PIT_GATE_SPEAKER);
+            break;
+        case PIT_CMD_PORT:
+            if ((value >> 6) != 2)
+                break;
+            if (((value >> 4) & 3) == 0) {
+                pit->latch = pit_ch2_count(pit);
+                pit->latched = 1;
+                break;
+            }
+            pit->mode = (value >> 1) & 7;
+            pit->write_high = 0;
+            pit->read_high = 0;
+            break;
+        case PIT_CH2_PORT:
+            if (pit->write_high) {
+                pit->count = (pit->count & 0xFF) | (value << 8);
+                pit->start_ns = now_ns();
+            } else {
+                pit->count = (pit->count & 0xFF00) | value;
+            }
+            pit->write_high = !pit->write_high;
+            break;
+    }
+}
+
+static void add_mark(vm_t *vm, const char *name, uint64_t ns)
+{
+    vm_run_t *r = vm->result;
+
+    if (r->num_marks == VM_MAX_MARKS)
+        return;
+    snprintf(r->marks[r->num_marks].name, sizeof(r->marks[0].name), "%s", name);
+    r->marks[r->num_marks].ns = ns;
+    r->num_marks++;
+}
+
+static void debugcon_line(vm_t *vm)
+{
+    uint64_t ns = now_ns() - vm->start_ns;
+
+    vm->line[vm->line_len] = '\0';
+    vm->line_len = 0;
+
+    if (!strncmp(vm->line, "TIMING: mark ", 13))
+        add_mark(vm, vm->line + 13, ns);
+    else if (strstr(vm->line, " real mode calls") && !strncmp(vm->line, "TIMING: ", 8))
+        vm->result->reached_boot = 1;
+
+    if (!vm->quiet)
+        printf("[%10.3f] %s\n", ns / 1e6, vm->line);
+}
+
+static void debugcon_putc(vm_t *vm, char c)
+{
+    if (c == '\r')
+        return;
+    if (c != '\n')
+        vm->line[vm->line_len++] = c;
+    if (c == '\n' || vm->line_len == VM_LINE_MAX - 1)
+        debugcon_line(vm);
+}
+
+static uint32_t io_read(vm_t *vm, uint16_t port, uint32_t size)
+{
+    uint8_t *config;
+    uint32_t value = 0;
+
+    switch (port) {
+        case VM_PCI_ADDRESS:
+            return size == 4 ? vm->pci_address : 0xFFFFFFFF;
+        case VM_PCI_DATA ... VM_PCI_DATA + 3:
+            config = pci_device(vm);
+            if (config == NULL)
+                return 0xFFFFFFFF;
+            memcpy(&value, config + (vm->pci_address & 0xFC) + (port - VM_PCI_DATA), size);
+            return value;
+        case VM_CMOS_DATA:
+            return vm->cmos[vm->cmos_index];
+        case BOCHS_DISPI_IOPORT_INDEX:
+            return vm->dispi_index;
+        case BOCHS_DISPI_IOPORT_DATA:
+            if (vm->dispi_index == BOCHS_DISPI_INDEX_ID)
+                return BOCHS_DISPI_ID0 | 5;
+            return vm->dispi_index < 16 ? vm->dispi[vm->dispi_index] : 0;
+        case VM_PIT_CH0_PORT:
+        case PIT_CH2_PORT:
+        case PIT_GATE_PORT:
+            return pit_read(vm, port);
+        default:
+            // Nothing there: the bus floats high.
+            return 0xFFFFFFFF;
+    }
+}
+
+/* Returns non-zero when the write ends the run */
+static int io_write(vm_t *vm, uint16_t port, uint32_t size, uint32_t value)
+{
+    uint8_t *config;
+
+    switch (port) {
+        case VM_DEBUGCON_PORT:
+            debugcon_putc(vm, (char)value);
+            return 0;
+        case VM_EXIT_PORT:
+            // Like QEMU's isa-debug-exit: exit status (value << 1) | 1.
+            vm->result->end = VM_END_DEBUG_EXIT;
+            vm->result->exit_code = (value << 1) | 1;
+            return 1;
+        case VM_PCI_ADDRESS:
+            if (size == 4)
+                vm->pci_address = value;
+            return 0;
+        case VM_PCI_DATA ... VM_PCI_DATA + 3:
+            config = pci_device(vm);
+            if (config != NULL)
+                pci_config_write(vm, config, (vm->pci_address & 0xFC) + (port - VM_PCI_DATA), size, value);
+            return 0;
+        case VM_CMOS_INDEX:
+            vm->cmos_index = value & 0x7F;
+            return 0;
+        case VM_CMOS_DATA:
+            vm->cmos[vm->cmos_index] = (uint8_t)value;
+            return 0;
+        case BOCHS_DISPI_IOPORT_INDEX:
+            vm->dispi_index = (uint16_t)value;
+            return 0;
+        case BOCHS_DISPI_IOPORT_DATA:
+            if (vm->dispi_index < 16)
+                vm->dispi[vm->dispi_index] = (uint16_t)value;
+            return 0;
+        case PIT_CMD_PORT:
+        case PIT_CH2_PORT:
+        case PIT_GATE_PORT:
+            pit_write(vm, port, (uint8_t)value);
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+static int handle_io(vm_t *vm)
+{
+    struct kvm_run *run = vm->run;
+    uint8_t *data = (uint8_t *)run + run->io.data_offset;
+
+    for (uint32_t i = 0; i < run->io.count; i++, data += run->io.size) {
+        uint32_t value = 0;
+
+        if (run->io.direction == KVM_EXIT_IO_IN) {
+            value = io_read(vm, run->io.port, run->io.size);
+            memcpy(data, &value, run->io.size);
+        } else {
+            memcpy(&value, data, run->io.size);
+            if (io_write(vm, run->io.port, run->io.size, value))
+                return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void set_memory(vm_t *vm, uint32_t slot, uint64_t addr, uint64_t size, void *host)
+{
+    struct kvm_userspace_memory_region region = {
+        .slot = slot,
+        .guest_phys_addr = addr,
+        .memory_size = size,
+        .userspace_addr = (uintptr_t)host,
+    };
+
+    if (ioctl(vm->fd, KVM_SET_USER_MEMORY_REGION, &region) < 0)
+        die("KVM_SET_USER_MEMORY_REGION");
+}
+
+static void set_cpuid(vm_t *vm)
+{
+    struct {
+        struct kvm_cpuid2 header;
+        struct kvm_cpuid_entry2 entries[VM_MAX_CPUID];
+    } cpuid = { .header.nent = VM_MAX_CPUID };
+
+    if (ioctl(kvm_fd, KVM_GET_SUPPORTED_CPUID, &cpuid) < 0)
+        die("KVM_GET_SUPPORTED_CPUID");
+    if (ioctl(vm->vcpu, KVM_SET_CPUID2, &cpuid) < 0)
+        die("KVM_SET_CPUID2");
+}
+
+/* Flat 32-bit protected mode, paging off, as multiboot hands over */
+static void set_multiboot_state(vm_t *vm, uint32_t entry, uint32_t mbi)
+{
+    struct kvm_segment code = {
+        .base = 0, .limit = 0xFFFFFFFF, .selector = 0x08, .type = 0xB,
+        .present = 1, .dpl = 0, .db = 1, .s = 1, .l = 0, .g = 1,
+    };
+    struct kvm_segment data = code;
+    struct kvm_sregs sregs;
+    struct kvm_regs regs;
+
+    if (ioctl(vm->vcpu, KVM_GET_SREGS, &sregs) < 0)
+        die("KVM_GET_SREGS");
+    data.selector = 0x10;
+    data.type = 0x3;
+    sregs.cs = code;
+    sregs.ds = sregs.es = sregs.fs = sregs.gs = sregs.ss = data;
+    sregs.cr0 = (sregs.cr0 | 0x1) & ~0x80000000ull;
+    if (ioctl(vm->vcpu, KVM_SET_SREGS, &sregs) < 0)
+        die("KVM_SET_SREGS");
+
+    memset(&regs, 0, sizeof(regs));
+    regs.rip = entry;
+    regs.rax = MULTIBOOT_BOOTLOADER_MAGIC;
+    regs.rbx = mbi;
+    regs.rsp = VM_BOOT_STACK;
+    regs.rflags = 0x2;
+    if (ioctl(vm->vcpu, KVM_SET_REGS, &regs) < 0)
+        die("KVM_SET_REGS");
+}
+
+static void create_vm(vm_t *vm)
+{
+    int size;
+
+    vm->fd = ioctl(kvm_fd, KVM_CREATE_VM, 0);
+    if (vm->fd < 0)
+        die("KVM_CREATE_VM");
+    if (ioctl(vm->fd, KVM_SET_TSS_ADDR, VM_TSS_ADDR) < 0)
+        die("KVM_SET_TSS_ADDR");
+    uint64_t identity = VM_IDENTITY_ADDR;
+    if (ioctl(vm->fd, KVM_SET_IDENTITY_MAP_ADDR, &identity) < 0)
+        die("KVM_SET_IDENTITY_MAP_ADDR");
+
+    vm->ram = mmap(NULL, VM_RAM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    vm->fb = mmap(NULL, VM_FB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (vm->ram == MAP_FAILED || vm->fb == MAP_FAILED)
+        die("mmap");
+    set_memory(vm, 0, 0, VM_RAM_SIZE, vm->ram);
+    set_memory(vm, 1, VM_FB_BASE, VM_FB_SIZE, vm->fb);
+
+    vm->vcpu = ioctl(vm->fd, KVM_CREATE_VCPU, 0);
+    if (vm->vcpu < 0)
+        die("KVM_CREATE_VCPU");
+    size = ioctl(kvm_fd, KVM_GET_VCPU_MMAP_SIZE, 0);
+    if (size < 0)
+        die("KVM_GET_VCPU_MMAP_SIZE");
+    vm->run_size = size;
+    vm->run = mmap(NULL, vm->run_size, PROT_READ | PROT_WRITE, MAP_SHARED, vm->vcpu, 0);
+    if (vm->run == MAP_FAILED)
+        die("mmap vcpu");
+    set_cpuid(vm);
+}
+
+static void destroy_vm(vm_t *vm)
+{
+    munmap(vm->run, vm->run_size);
+    munmap(vm->fb, VM_FB_SIZE);
+    munmap(vm->ram, VM_RAM_SIZE);
+    close(vm->vcpu);
+    close(vm->fd);
+}
+
+static void run_vm(vm_t *vm, uint32_t timeout)
+{
+    vm_run_t *r = vm->result;
+
+    timed_out = 0;
+    current_run = vm->run;
+    vm->start_ns = now_ns();
+    alarm(timeout);
+
+    while (r->end == VM_END_NONE) {
+        if (timed_out || ioctl(vm->vcpu, KVM_RUN, 0) < 0) {
+            if (timed_out) {
+                r->end = VM_END_TIMEOUT;
+            } else if (errno != EINTR) {
+                perror("kvmrun: KVM_RUN");
+                r->end = VM_END_ERROR;
+            }
+            continue;
+        }
+        r->exits++;
+
+        switch (vm->run->exit_reason) {
+            case KVM_EXIT_IO:
+                handle_io(vm);
+                break;
+            case KVM_EXIT_MMIO:
+                if (!vm->run->mmio.is_write)
+                    memset(vm->run->mmio.data, 0xFF, sizeof(vm->run->mmio.data));
+                break;
+            case KVM_EXIT_HLT:
+                r->end = VM_END_HLT;
+                break;
+            case KVM_EXIT_SHUTDOWN:
+                r->end = VM_END_SHUTDOWN;
+                break;
+            default:
+                fprintf(stderr, "kvmrun: unexpected exit reason %d\n", vm->run->exit_reason);
+                r->end = VM_END_ERROR;
+                break;
+        }
+    }
+
+    alarm(0);
+    current_run = NULL;
+    r->end_ns = now_ns() - vm->start_ns;
+    if (vm->line_len)
+        debugcon_line(vm);
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Time of the mark `name` in run `r` minus the mark before it, or -1 */
+static int64_t stage_ns(const vm_run_t *r, const char *name)
+{
+    for (uint32_t i = 1; i < r->num_marks; i++) {
+        if (!strcmp(r->marks[i].name, name))
+            return r->marks[i].ns - r->marks[i - 1].ns;
+    }
+    return -1;
+}
+
+static void print_row(const char *name, uint64_t *ns, uint32_t n)
+{
+    qsort(ns, n, sizeof(ns[0]), compare_u64);
+    printf("kvmrun: %-28s %10.3f %10.3f %10.3f\n", name, ns[n / 2] / 1e6, ns[0] / 1e6, ns[n - 1] / 1e6);
+}
+
+/* Median, minimum and maximum of every stage over the runs, in ms */
+static void report(const vm_run_t *runs, uint32_t count)
+{
+    uint64_t ns[VM_MAX_RUNS];
+    const vm_run_t *first = &runs[0];
+    uint32_t n;
+
+    printf("kvmrun: %-28s %10s %10s %10s\n", "stage (ms)", "median", "min", "max");
+    for (uint32_t m = 1; m < first->num_marks; m++) {
+        n = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            int64_t t = stage_ns(&runs[i], first->marks[m].name);
+
+            if (t >= 0)
+                ns[n++] = t;
+        }
+        if (n)
+            print_row(first->marks[m].name, ns, n);
+    }
+
+    n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (runs[i].num_marks)
+            ns[n++] = runs[i].marks[runs[i].num_marks - 1].ns - runs[i].marks[0].ns;
+    }
+    if (n)
+        print_row("total", ns, n);
+
+    for (uint32_t i = 0; i < count; i++)
+        ns[i] = runs[i].end_ns;
+    print_row("VM start to end", ns, count);
+}
+
+static noreturn void usage(void)
+{
+    fprintf(stderr, "usage: kvmrun [-n runs] [-t seconds] [-q] <loader.elf> <mach_kernel> [boot args...]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    static vm_run_t runs[VM_MAX_RUNS];
+    struct sigaction sa;
+    char cmdline[MACH_CMDLINE];
+    uint32_t count = 1, timeout = VM_DEFAULT_TIMEOUT;
+    int quiet = 0, opt, failed = 0;
+    size_t loader_size, kernel_size, len;
+    uint8_t *loader, *kernel;
+
+    while ((opt = getopt(argc, argv, "n:t:q")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                timeout = strtoul(optarg, NULL, 0);
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            default:
+                usage();
+        }
+    }
+    if (argc - optind < 2 || count == 0 || count > VM_MAX_RUNS || timeout == 0)
+        usage();
+
+    len = snprintf(cmdline, sizeof(cmdline), "%s", VM_DEFAULT_ARGS);
+    for (int i = optind + 2; i < argc && len < sizeof(cmdline); i++)
+        len += snprintf(cmdline + len, sizeof(cmdline) - len, " %s", argv[i]);
+
+    kvm_fd = open("/dev/kvm", O_RDWR | O_CLOEXEC);
+    if (kvm_fd < 0) {
+        fprintf(stderr, "kvmrun: cannot open /dev/kvm (%s), use tests/qemu/timing.sh instead\n", strerror(errno));
+        return 2;
+    }
+    if (ioctl(kvm_fd, KVM_GET_API_VERSION, 0) != KVM_API_VERSION) {
+        fprintf(stderr, "kvmrun: unsupported KVM API version\n");
+        return 2;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_alarm;
+    sigaction(SIGALRM, &sa, NULL);
+
+    loader = read_file(argv[optind], &loader_size);
+    kernel = read_file(argv[optind + 1], &kernel_size);
+
+    for (uint32_t i = 0; i < count; i++) {
+        vm_t vm;
+        uint32_t entry, end, mbi;
+
+        memset(&vm, 0, sizeof(vm));
+        vm.quiet = quiet || i > 0;
+        vm.result = &runs[i];
+        create_vm(&vm);
+        init_devices(&vm);
+        entry = load_loader(&vm, loader, loader_size, &end);
+        mbi = build_multiboot(&vm, end, kernel, kernel_size, cmdline);
+        set_multiboot_state(&vm, entry, mbi);
+        run_vm(&vm, timeout);
+        destroy_vm(&vm);
+
+        printf("kvmrun: run %d: %s after %.3f ms, %llu exits\n", i + 1, end_names[runs[i].end],
+               runs[i].end_ns / 1e6, (unsigned long long)runs[i].exits);
+
+        // exitat= leaves through the exit port with 0, a full run halts after Legacy16Boot.
+        if (!(runs[i].end == VM_END_DEBUG_EXIT && runs[i].exit_code == 1) &&
+            !(runs[i].end == VM_END_HLT && runs[i].reached_boot))
+            failed = 1;
+    }
+
+    report(runs, count);
+    printf("kvmrun: %s\n", failed ? "FAILED" : "ok");
+    return failed;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Find the BIOS call trace ring and the real mode profile in a
+ *          memory dump and print them.
+ * SPDX-License-Identifier: MIT
+*/
+
+/*
+ * Reads a raw dump of guest physical memory, e.g. from QEMU's monitor
+ * (`pmemsave 0 0x100000 low.bin`) or /dev/mem, and prints every trace
+ * ring and profile histogram in it the way the warm reboot path does. This needs neither
+ * warmboot nor a working guest. The structures are allocated from the
+ * CSM on 16 byte boundaries, which is where the signatures are looked for.
+ */
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "host.h"
+#include "profile.h"
+#include "trace.h"
+
+/* cmdline.c reads the boot args through this; csmwrapple.c is not linked */
+mach_boot_args_t *gBA;
+
+/* A ring left by an earlier boot has a sane head too; only the layout is checked */
+static boolean_t trace_ring_valid(const trace_ring_t *ring)
+{
+    return ring->signature == TRACE_SIGNATURE && ring->head < TRACE_ENTRIES;
+}
+
+static boolean_t prof_hist_valid(const prof_hist_t *hist)
+{
+    return hist->signature == PROF_SIGNATURE && hist->divider && hist->divider <= PROF_MAX_DIVIDER &&
+           !(hist->divider & (hist->divider - 1));
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long size;
+    uint32_t base = 0;
+    uint32_t found = 0;
+    uint8_t *dump;
+
+    host_init();
+    if (argc < 2 || argc > 3 || (argc == 3 && !parse_uint(argv[2], &base, NULL))) {
+        printf("usage: rmdump <memory dump> [physical address of the dump]\n");
+        host_exit(2);
+    }
+
+    dump = (uint8_t *)host_read_file(argv[1], &size);
+    if (dump == NULL) {
+        printf("rmdump: cannot read %s\n", argv[1]);
+        host_exit(2);
+    }
+
+    for (unsigned long offset = 0; offset + sizeof(uint32_t) <= size; offset += 16) {
+        const trace_ring_t *ring = (const trace_ring_t *)(dump + offset);
+        const prof_hist_t *hist = (const prof_hist_t *)(dump + offset);
+
+        if (offset + sizeof(trace_ring_t) <= size && trace_ring_valid(ring)) {
+            printf("rmdump: trace ring at %x\n", base + (uint32_t)offset);
+            trace_print_ring(ring);
+            found++;
+        } else if (offset + sizeof(prof_hist_t) <= size && prof_hist_valid(hist)) {
+            printf("rmdump: profile histogram at %x, divider %d\n", base + (uint32_t)offset, hist->divider);
+            profile_print_hist(hist);
+            found++;
+        }
+    }
+
+    if (found == 0)
+        printf("rmdump: no trace ring or profile histogram in %s\n", argv[1]);
+    host_exit(found == 0);
+    return 0;
+}
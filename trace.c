@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Trace the BIOS services a legacy OS calls after Legacy16Boot.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "lowmem.h"
+#include "rmhook.h"
+#include "trace.h"
+
+/* Trace16.nasm */
+extern const uint8_t  mTrace16Start;
+extern const uint16_t mTrace16Size;
+extern const uint16_t mTrace16Vector;
+extern const uint16_t mTrace16Old;
+extern const uint16_t mTrace16RingSeg;
+
+static trace_ring_t *trace_ring;
+
+/*
+ * trace[=<list>]: hook the comma separated (hex) vectors, by default the
+ * video, disk, system, keyboard and clock services. Must run after
+ * Legacy16PrepareToBoot so the CSM's own handlers are in the IVT.
+ */
+int trace_install(struct csmwrap_priv *priv)
+{
+    char list[32];
+    char *p, *tok;
+    uint32_t vector;
+    uint32_t hooked = 0;
+    uint16_t ring_seg;
+
+    if (!cmdline_has("trace"))
+        return 0;
+
+    if (!cmdline_get("trace", list, sizeof(list)) || !list[0])
+        strcpy(list, TRACE_DEFAULT_VECTORS);
+
+    trace_ring = (trace_ring_t *)lowmem_csm_alloc(priv, LEGACY16_REGION_ANY, sizeof(trace_ring_t), 16);
+    if (trace_ring == NULL)
+        return -1;
+
+    memset(trace_ring, 0, sizeof(trace_ring_t));
+    trace_ring->signature = TRACE_SIGNATURE;
+    ring_seg = RMHOOK_SEGMENT(trace_ring);
+
+    p = list;
+    while ((tok = strsep(&p, ",")) != NULL) {
+        uint8_t *shim;
+        char hex[8];
+
+        // Vectors are always hex, with or without the 0x prefix.
+        if (strncmp(tok, "0x", 2) && strlen(tok) < sizeof(hex) - 2) {
+            strcpy(hex, "0x");
+            strcat(hex, tok);
+            tok = hex;
+        }
+
+        if (!parse_uint(tok, &vector, NULL) || vector > 0xFF || vector == 0x19) {
+            printf("TRACE: cannot hook vector %s\n", tok);
+            continue;
+        }
+
+        // Every shim takes F segment space the CSM may still need.
+        if (hooked == TRACE_MAX_VECTORS) {
+            printf("TRACE: at most %d vectors, not hooking %s\n", TRACE_MAX_VECTORS, tok);
+            break;
+        }
+
+        shim = rmhook_place(priv, &mTrace16Start, mTrace16Size);
+        if (shim == NULL)
+            return -1;
+
+        shim[mTrace16Vector] = (uint8_t)vector;
+        *(uint32_t *)(shim + mTrace16Old) = rmhook_get_vector((uint8_t)vector);
+        *(uint16_t *)(shim + mTrace16RingSeg) = ring_seg;
+        rmhook_set_vector((uint8_t)vector, RM_FARPTR(RMHOOK_SEGMENT(shim), 0));
+        hooked++;
+        printf("TRACE: hooked INT %02xh\n", vector);
+    }
+
+    printf("TRACE: ring of %d calls at %x, %d vectors\n", TRACE_ENTRIES, (uint32_t)(uintptr_t)trace_ring, hooked);
+    return 0;
+}
+
+/*
+ * The ring survives a warm reboot, so this is called from the warm reboot
+ * path to show what the previous OS did. tools/rmdump.c prints it from a
+ * memory dump instead.
+ */
+void trace_dump(void)
+{
+    if (trace_ring != NULL)
+        trace_print_ring(trace_ring);
+}
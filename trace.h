@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the real mode BIOS interrupt tracer.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#define TRACE_SIGNATURE         0x43525442  /* "BTRC" */
+/* Must match Trace16.nasm */
+#define TRACE_ENTRIES           1024
+#define TRACE_MAX_VECTORS       8
+#define TRACE_DEFAULT_VECTORS   "10,13,15,16,1a"
+
+#define TRACE_FLAG_CF           0x01
+#define TRACE_FLAG_DONE         0x80
+
+#pragma pack(1)
+typedef struct _trace_entry_t
+{
+    uint8_t     vector;
+    uint8_t     flags;
+    uint16_t    ax_in;
+    uint16_t    ax_out;
+    uint16_t    dx_in;
+    uint32_t    tsc;        /* Low half of the TSC at entry */
+    uint32_t    cycles;     /* Until the handler returned */
+} trace_entry_t;
+
+typedef struct _trace_ring_t
+{
+    uint32_t        signature;
+    uint16_t        head;   /* Next slot to be used */
+    uint16_t        reserved;
+    uint32_t        total;  /* Calls seen, including overwritten ones */
+    uint32_t        reserved2;
+    trace_entry_t   entry[TRACE_ENTRIES];
+} trace_ring_t;
+#pragma pack()
+
+/* Functions */
+extern int trace_install(struct csmwrap_priv *priv);
+extern void trace_dump(void);
+extern void trace_print_ring(const trace_ring_t *ring);
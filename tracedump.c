@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Print the BIOS call trace ring. Touches no hardware, so it
+ *          also builds on the host (see tools/rmdump.c).
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "trace.h"
+
+/* Most recent entries printed by trace_print_ring */
+#define TRACE_DUMP_RECENT       32
+#define TRACE_MAX_FUNCS         64
+
+/*
+ * Print a per-service summary of what is still in the ring, followed by the
+ * most recent calls.
+ */
+void trace_print_ring(const trace_ring_t *ring)
+{
+    static struct {
+        uint8_t     vector;
+        uint8_t     ah;
+        uint32_t    count;
+        uint32_t    errors;
+        uint64_t    cycles;
+        uint32_t    max;
+    } funcs[TRACE_MAX_FUNCS];
+    uint32_t nfuncs = 0;
+    uint32_t used;
+    uint32_t start;
+
+    if (ring->signature != TRACE_SIGNATURE)
+        return;
+
+    used = ring->total < TRACE_ENTRIES ? ring->total : TRACE_ENTRIES;
+    start = (ring->head - used) & (TRACE_ENTRIES - 1);
+
+    printf("TRACE: %d calls, last %d kept\n", ring->total, used);
+
+    for (uint32_t n = 0; n < used; n++) {
+        const trace_entry_t *e = &ring->entry[(start + n) & (TRACE_ENTRIES - 1)];
+        uint8_t ah = e->ax_in >> 8;
+        uint32_t i;
+
+        if (!(e->flags & TRACE_FLAG_DONE))
+            continue;
+
+        for (i = 0; i < nfuncs; i++)
+            if (funcs[i].vector == e->vector && funcs[i].ah == ah)
+                break;
+
+        if (i == nfuncs) {
+            if (nfuncs == TRACE_MAX_FUNCS)
+                continue;
+            memset(&funcs[i], 0, sizeof(funcs[i]));
+            funcs[i].vector = e->vector;
+            funcs[i].ah = ah;
+            nfuncs++;
+        }
+
+        funcs[i].count++;
+        funcs[i].cycles += e->cycles;
+        if (e->cycles > funcs[i].max)
+            funcs[i].max = e->cycles;
+        if (e->flags & TRACE_FLAG_CF)
+            funcs[i].errors++;
+    }
+
+    printf("TRACE: int  ah     calls  errors      kcycles   max cycles\n");
+    for (uint32_t i = 0; i < nfuncs; i++)
+        printf("TRACE: %02x   %02x  %8d  %6d  %11d  %11d\n", funcs[i].vector, funcs[i].ah,
+               funcs[i].count, funcs[i].errors, (uint32_t)(funcs[i].cycles >> 10), funcs[i].max);
+
+    if (used > TRACE_DUMP_RECENT) {
+        start = (start + used - TRACE_DUMP_RECENT) & (TRACE_ENTRIES - 1);
+        used = TRACE_DUMP_RECENT;
+    }
+
+    for (uint32_t n = 0; n < used; n++) {
+        const trace_entry_t *e = &ring->entry[(start + n) & (TRACE_ENTRIES - 1)];
+
+        if (!(e->flags & TRACE_FLAG_DONE)) {
+            printf("TRACE: int %02x ax=%04x dx=%04x (no return)\n", e->vector, e->ax_in, e->dx_in);
+            continue;
+        }
+
+        printf("TRACE: int %02x ax=%04x dx=%04x -> ax=%04x%s %d cycles\n", e->vector, e->ax_in,
+               e->dx_in, e->ax_out, (e->flags & TRACE_FLAG_CF) ? " CF" : "", e->cycles);
+    }
+}
@@ -24,6 +24,7 @@ typedef uint32_t            uintn_t;
 #define true                1
 #define false               0
 #define NULL                (void *) 0
+#define offsetof(t, m)      __builtin_offsetof(t, m)
 
 // Types for compatibility with EDK2.
 typedef int8_t              INT8;
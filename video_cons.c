@@ -11,30 +11,173 @@ linear_framebuffer_t    fb;
 console_priv_t          con;
 char                    print_buf[PRINT_BUFFER_SIZE];
 
+/*
+ * Glyph blitters, one per pixel format. Each one writes a full ISO_CHAR_WIDTH
+ * wide row per font line; the pixel is selected with a mask instead of a
+ * branch so the inner loop has no data dependent jumps.
+ */
+typedef void (*glyph_blit_t)(uint8_t *dst, uint32_t delta, const uint8_t *glyph, uint32_t fg, uint32_t bg);
+typedef void (*span_fill_t)(uint8_t *dst, uint32_t count, uint32_t color);
+
+#define PIXEL_SELECT(bits, column, fg, bg) \
+    ((bg) ^ (((fg) ^ (bg)) & -(((bits) >> (column)) & 1)))
+
+static
+void blit_glyph_xrgb8888(uint8_t *dst, uint32_t delta, const uint8_t *glyph, uint32_t fg, uint32_t bg)
+{
+    for (uint32_t line = 0; line < ISO_CHAR_HEIGHT; line++)
+    {
+        uint32_t *pixel = (uint32_t *) dst;
+        uint32_t bits = glyph[line];
+
+        for (uint32_t column = 0; column < ISO_CHAR_WIDTH; column++)
+            pixel[column] = PIXEL_SELECT(bits, column, fg, bg);
+
+        dst += delta;
+    }
+}
+
+static
+void fill_span_xrgb8888(uint8_t *dst, uint32_t count, uint32_t color)
+{
+    uint32_t *pixel = (uint32_t *) dst;
+
+    while (count--)
+        *pixel++ = color;
+}
+
+#ifndef CONFIG_FB_XRGB8888
+static
+void blit_glyph_rgb888(uint8_t *dst, uint32_t delta, const uint8_t *glyph, uint32_t fg, uint32_t bg)
+{
+    for (uint32_t line = 0; line < ISO_CHAR_HEIGHT; line++)
+    {
+        uint8_t *pixel = dst;
+        uint32_t bits = glyph[line];
+
+        for (uint32_t column = 0; column < ISO_CHAR_WIDTH; column++)
+        {
+            uint32_t color = PIXEL_SELECT(bits, column, fg, bg);
+            pixel[0] = (uint8_t) color;
+            pixel[1] = (uint8_t) (color >> 8);
+            pixel[2] = (uint8_t) (color >> 16);
+            pixel += 3;
+        }
+
+        dst += delta;
+    }
+}
+
+static
+void fill_span_rgb888(uint8_t *dst, uint32_t count, uint32_t color)
+{
+    while (count--)
+    {
+        dst[0] = (uint8_t) color;
+        dst[1] = (uint8_t) (color >> 8);
+        dst[2] = (uint8_t) (color >> 16);
+        dst += 3;
+    }
+}
+
 static
+void blit_glyph_rgb565(uint8_t *dst, uint32_t delta, const uint8_t *glyph, uint32_t fg, uint32_t bg)
+{
+    for (uint32_t line = 0; line < ISO_CHAR_HEIGHT; line++)
+    {
+        uint16_t *pixel = (uint16_t *) dst;
+        uint32_t bits = glyph[line];
+
+        for (uint32_t column = 0; column < ISO_CHAR_WIDTH; column++)
+            pixel[column] = (uint16_t) PIXEL_SELECT(bits, column, fg, bg);
+
+        dst += delta;
+    }
+}
+
+static
+void fill_span_rgb565(uint8_t *dst, uint32_t count, uint32_t color)
+{
+    uint16_t *pixel = (uint16_t *) dst;
+
+    while (count--)
+        *pixel++ = (uint16_t) color;
+}
+
+static glyph_blit_t     blit_glyph = blit_glyph_xrgb8888;
+static span_fill_t      fill_span = fill_span_xrgb8888;
+#else
+// Only one format is compiled in, so call it directly.
+#define blit_glyph      blit_glyph_xrgb8888
+#define fill_span       fill_span_xrgb8888
+#endif
+
 void video_print_char(char c, uint32_t x, uint32_t y, uint32_t fg_color, uint32_t bg_color)
 {
-    uint32_t    char_position = c * ISO_CHAR_HEIGHT;
+    const uint8_t *glyph = &iso_font[(uint8_t) c * ISO_CHAR_HEIGHT];
 
     // Set up delta and pixel location
     uint32_t delta = (fb.pitch + 3) & ~0x3;
-    uint32_t *pixel = (uint32_t *) ((char *) fb.base + (y * ISO_CHAR_HEIGHT) * delta + (x * ISO_CHAR_WIDTH * 4));
+    uint8_t *pixel = (uint8_t *) fb.base + (y * ISO_CHAR_HEIGHT) * delta + (x * ISO_CHAR_WIDTH * FB_BYTES_PER_PIXEL(fb));
 
     // Print character to screen
-    for (uint8_t line = 0; line < ISO_CHAR_HEIGHT; line++)
-    {
-        uint8_t char_line = iso_font[char_position];
-        for (uint8_t column = 0; column < ISO_CHAR_WIDTH; column++)
-        {
-            uint8_t mask = char_line >> column;
-            pixel[column] = (((mask & 1) == 1) ? RGBA_TO_NATIVE(fb, fg_color) : RGBA_TO_NATIVE(fb, bg_color));
-        }
-        char_position++;
-        pixel = (uint32_t *) ((char *) pixel + delta);
+    blit_glyph(pixel, delta, glyph, RGBA_TO_NATIVE(fb, fg_color), RGBA_TO_NATIVE(fb, bg_color));
+}
+
+/*
+ * Move a block of `rows` text rows, `cols` cells wide starting at `col`,
+ * from `src_row` to `dst_row`. Used by the INT 10h scroll fast path, which
+ * keeps its own text grid on top of the same cell layout.
+ */
+void video_move_cells(uint32_t dst_row, uint32_t src_row, uint32_t col, uint32_t cols, uint32_t rows)
+{
+    uint32_t delta = (fb.pitch + 3) & ~0x3;
+    uint32_t bpp = FB_BYTES_PER_PIXEL(fb);
+    uint32_t lines = rows * ISO_CHAR_HEIGHT;
+    uint32_t width = cols * ISO_CHAR_WIDTH * bpp;
+    uint8_t *dst = (uint8_t *) fb.base + dst_row * ISO_CHAR_HEIGHT * delta + col * ISO_CHAR_WIDTH * bpp;
+    uint8_t *src = (uint8_t *) fb.base + src_row * ISO_CHAR_HEIGHT * delta + col * ISO_CHAR_WIDTH * bpp;
+
+    if (dst_row <= src_row) {
+        for (uint32_t line = 0; line < lines; line++)
+            memcpy(dst + line * delta, src + line * delta, width);
+    } else {
+        for (uint32_t line = lines; line-- > 0;)
+            memcpy(dst + line * delta, src + line * delta, width);
     }
 }
 
+/* Whether a text grid of cols x rows cells fits the framebuffer */
+boolean_t video_grid_fits(uint32_t cols, uint32_t rows)
+{
+    return fb.enabled && cols * ISO_CHAR_WIDTH <= fb.width && rows * ISO_CHAR_HEIGHT <= fb.height;
+}
+
+void video_fill_cells(uint32_t col, uint32_t row, uint32_t cols, uint32_t rows, uint32_t color)
+{
+    uint32_t delta = (fb.pitch + 3) & ~0x3;
+    uint32_t native = RGBA_TO_NATIVE(fb, color);
+    uint8_t *dst = (uint8_t *) fb.base + row * ISO_CHAR_HEIGHT * delta + col * ISO_CHAR_WIDTH * FB_BYTES_PER_PIXEL(fb);
+
+    for (uint32_t line = 0; line < rows * ISO_CHAR_HEIGHT; line++)
+        fill_span(dst + line * delta, cols * ISO_CHAR_WIDTH, native);
+}
+
+/*
+ * Move the whole screen up one text row and clear the bottom one. The
+ * framebuffer is one contiguous block, so a single memmove does it.
+ */
 static
+void cons_scroll(void)
+{
+    uint32_t    delta = (fb.pitch + 3) & ~0x3;
+    uint32_t    top = (delta * ISO_CHAR_HEIGHT);
+
+    // We should double buffer here. But we don't. Who cares.
+    memmove((void *) fb.base, (const void *) fb.base + top, fb.size - top);
+    video_fill_cells(0, con.height - 1, con.width, 1, con.bg_color);
+}
+
 void cons_print_char(void *p, char c)
 {
     (void)(p); // Unused parameter.
@@ -44,6 +187,31 @@ void cons_print_char(void *p, char c)
     if (!fb.enabled)
         return;
 
+    // Control characters only move the cursor.
+    switch (c)
+    {
+        case '\r': // CR
+        {
+            con.cursor_x = 0;
+            return;
+        }
+        case '\n': // LF
+        {
+            con.cursor_x = 0;
+            con.cursor_y++;
+            return;
+        }
+        case '\b': // BS, erases the previous character
+        {
+            if (con.cursor_x > 0 && con.cursor_x <= con.width && con.cursor_y < con.height)
+            {
+                con.cursor_x--;
+                video_print_char(' ', con.cursor_x, con.cursor_y, con.fg_color, con.bg_color);
+            }
+            return;
+        }
+    }
+
     // CASE 2: Text wrapped around.
     // Add a newline in this case.
     if (con.cursor_x >= con.width)
@@ -53,41 +221,16 @@ void cons_print_char(void *p, char c)
     }
 
     // CASE 3: Screen is full.
-    // Scroll down (this function is very slow)
+    // Scroll down; deferred until something is printed on the new row.
     if (con.cursor_y >= con.height)
     {
-        uint32_t    delta = (fb.pitch + 3) & ~0x3;
-        uint32_t    top = (delta * ISO_CHAR_HEIGHT);
-
-        // We should double buffer here. But we don't. Who cares.
-        memmove((void *) fb.base, (const void *) fb.base + top, fb.size - top);
-        memset((void *) fb.base + fb.size - top, 0, top);
-        con.cursor_y--;
+        cons_scroll();
+        con.cursor_y = con.height - 1;
     }
 
     // Now we print the character.
-    switch (c)
-    {
-        // CASE 1: newline.
-        case '\r': // CR
-        case '\n': // LF
-        {
-            con.cursor_x = 0;
-            con.cursor_y++;
-        }
-        // CASE 2: backspace.
-        case '\b':
-        {
-            con.cursor_x--;
-            video_print_char(c, con.cursor_x, con.cursor_y, con.fg_color, con.bg_color);
-        }
-        // CASE 3: any other character.
-        default:
-        {
-            video_print_char(c, con.cursor_x, con.cursor_y, con.fg_color, con.bg_color);
-            con.cursor_x++;
-        }
-    }
+    video_print_char(c, con.cursor_x, con.cursor_y, con.fg_color, con.bg_color);
+    con.cursor_x++;
 }
 
 void cons_clear_screen(uint32_t color)
@@ -96,18 +239,81 @@ void cons_clear_screen(uint32_t color)
         return;
 
     uint32_t delta = (fb.pitch + 3) & ~0x3;
+    uint32_t native = RGBA_TO_NATIVE(fb, color);
 
     for (uint32_t line = 0; line < fb.height; line++)
+        fill_span((uint8_t *) fb.base + line * delta, fb.width, native);
+
+    con.cursor_x = 0;
+    con.cursor_y = 0;
+}
+
+// Pick the channel layout and blitters for the depth boot.efi reports.
+// Anything we don't know how to draw is treated as 32bpp, as before. The
+// release build only draws 32bpp and turns down every other depth.
+static
+boolean_t cons_set_pixel_format(uint32_t depth)
+{
+#ifdef CONFIG_FB_XRGB8888
+    if (depth != 0 && depth != FB_DEPTH)
+        return false;
+
+    depth = FB_DEPTH;
+#endif
+
+    switch (depth)
     {
-        uint32_t *screen = (uint32_t *) ((char *) fb.base + line * delta);
-        for (uint32_t column = 0; column < fb.width; column++)
+#ifndef CONFIG_FB_XRGB8888
+        case 16:
+        {
+            fb.red_size         = 5;
+            fb.red_shift        = 11;
+            fb.green_size       = 6;
+            fb.green_shift      = 5;
+            fb.blue_size        = 5;
+            fb.blue_shift       = 0;
+            fb.reserved_size    = 0;
+            fb.reserved_shift   = 0;
+            blit_glyph          = blit_glyph_rgb565;
+            fill_span           = fill_span_rgb565;
+            break;
+        }
+        case 24:
+        {
+            fb.red_size         = 8;
+            fb.red_shift        = 16;
+            fb.green_size       = 8;
+            fb.green_shift      = 8;
+            fb.blue_size        = 8;
+            fb.blue_shift       = 0;
+            fb.reserved_size    = 0;
+            fb.reserved_shift   = 0;
+            blit_glyph          = blit_glyph_rgb888;
+            fill_span           = fill_span_rgb888;
+            break;
+        }
+#endif
+        default:
         {
-            *screen++ = RGBA_TO_NATIVE(fb, color);
+            depth               = 32;
+            fb.red_size         = 8;
+            fb.red_shift        = 16;
+            fb.green_size       = 8;
+            fb.green_shift      = 8;
+            fb.blue_size        = 8;
+            fb.blue_shift       = 0;
+            fb.reserved_size    = 8;
+            fb.reserved_shift   = 24;
+#ifndef CONFIG_FB_XRGB8888
+            blit_glyph          = blit_glyph_xrgb8888;
+            fill_span           = fill_span_xrgb8888;
+#endif
+            break;
         }
     }
 
-    con.cursor_x = 0;
-    con.cursor_y = 0;
+    fb.depth = depth;
+    return true;
 }
 
 // Platform specific video initialization code.
@@ -115,14 +321,17 @@ void cons_clear_screen(uint32_t color)
 // After this, we will have a working printf.
 boolean_t cons_init(void *video_params, uint32_t fg_color, uint32_t bg_color)
 {
-    if (!video_params)
-        return false;
-
     mach_video_t        *mv = video_params;
 
     memset(&fb, 0, sizeof(fb));
     memset(&con, 0, sizeof(con));
 
+    // initialize printf function; the other backends work without us.
+    init_printf(print_buf, cons_putc);
+
+    if (!video_params)
+        return false;
+
     // set up screen
     fb.enabled          = false;
 
@@ -132,17 +341,14 @@ boolean_t cons_init(void *video_params, uint32_t fg_color, uint32_t bg_color)
     fb.pitch            = mv->pitch;
     fb.width            = mv->width;
     fb.height           = mv->height;
-    fb.depth            = 32;
-    fb.pixels_per_row   = (mv->pitch * 4);
-
-    fb.red_size         = 8;
-    fb.red_shift        = 16;
-    fb.green_size       = 8;
-    fb.green_shift      = 8;
-    fb.blue_size        = 8;
-    fb.blue_shift       = 0;
-    fb.reserved_size    = 8;
-    fb.reserved_shift   = 0;
+
+    if (!cons_set_pixel_format(mv->depth)) {
+        // Still describe the mode as it is to the VGA BIOS.
+        fb.depth = mv->depth;
+        return false;
+    }
+
+    fb.pixels_per_row   = mv->pitch / FB_BYTES_PER_PIXEL(fb);
 
     // set up text console
     con.cursor_x        = 0;
@@ -153,9 +359,6 @@ boolean_t cons_init(void *video_params, uint32_t fg_color, uint32_t bg_color)
     con.fg_color        = fg_color;
     con.bg_color        = bg_color;
 
-    // initialize printf function
-    init_printf(print_buf, cons_print_char);
-
     fb.enabled = true;
 
     return true;
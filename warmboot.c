@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Re-enter the CSM on reboot without going back through EFI.
+ * SPDX-License-Identifier: MIT
+*/
+
+#include "csmwrapple.h"
+#include "cmdline.h"
+#include "fastint10.h"
+#include "int13cache.h"
+#include "lowmem.h"
+#include "profile.h"
+#include "rmhook.h"
+#include "timing.h"
+#include "trace.h"
+#include "warmboot.h"
+
+/* Warm16.nasm */
+extern const uint8_t  mWarm16Start;
+extern const uint16_t mWarm16Size;
+extern const uint16_t mWarm16Reset;
+extern const uint16_t mWarm16Armed;
+extern const uint16_t mWarm16Old19;
+extern const uint16_t mWarm16Gdtr;
+extern const uint16_t mWarm16Target;
+extern const uint8_t  mWarmBootGdtr[6];
+extern void WarmBoot32(void);
+
+/*
+ * Everything the warm path needs lives in the kernel image, which is kept
+ * out of the OS's hands by an E820 reservation. The ROM images are the
+ * Csm16_bin/vgabios_bin arrays we copied from on the first boot; the boot
+ * arguments and the low stub are snapshotted here because they sit in memory
+ * the OS is free to reuse.
+ */
+static struct {
+    boolean_t               enabled;
+    struct csmwrap_priv     *priv;
+    mach_boot_args_t        ba;
+    struct low_stub         low_stub;
+    uint32_t                count;
+} warm;
+
+/*
+ * warmboot: reserve the kernel image in the E820 map. Has to run after
+ * build_e820_map and before the map is handed to the CSM.
+ */
+int warmboot_setup(struct csmwrap_priv *priv)
+{
+    if (!cmdline_has("warmboot"))
+        return 0;
+
+    if (e820_reserve_kernel(priv) != 0)
+        return -1;
+
+    warm.enabled = true;
+    return 0;
+}
+
+/* Take the snapshot right before the first Legacy16 call. */
+void warmboot_save(struct csmwrap_priv *priv)
+{
+    if (!warm.enabled)
+        return;
+
+    warm.priv = priv;
+    memcpy(&warm.ba, gBA, sizeof(mach_boot_args_t));
+    memcpy(&warm.low_stub, priv->low_stub, sizeof(struct low_stub));
+}
+
+/*
+ * Place the real mode stub in the F segment and point INT 19h and the
+ * reset vector at it. Must run after Legacy16PrepareToBoot, once the CSM
+ * has set up the IVT, and before Legacy16Boot.
+ */
+int warmboot_install(struct csmwrap_priv *priv)
+{
+    uint8_t *stub;
+    uint16_t segment;
+    uint8_t *reset = (uint8_t *)RESET_VECTOR;
+
+    if (!warm.enabled)
+        return 0;
+
+    stub = rmhook_place(priv, &mWarm16Start, mWarm16Size);
+    if (stub == NULL)
+        return -1;
+
+    stub[mWarm16Armed] = 0;
+    *(uint32_t *)(stub + mWarm16Old19) = rmhook_get_vector(0x19);
+    memcpy(stub + mWarm16Gdtr, mWarmBootGdtr, sizeof(mWarmBootGdtr));
+    *(uint32_t *)(stub + mWarm16Target) = (uint32_t)(uintptr_t)WarmBoot32;
+
+    segment = RMHOOK_SEGMENT(stub);
+    rmhook_set_vector(0x19, RM_FARPTR(segment, 0));
+
+    // jmp far segment:mWarm16Reset
+    reset[0] = 0xEA;
+    *(uint16_t *)(reset + 1) = mWarm16Reset;
+    *(uint16_t *)(reset + 3) = segment;
+
+    printf("WARMBOOT: INT 19h and reset vector hooked at %04x:0000\n", segment);
+    return 0;
+}
+
+/*
+ * Called from WarmBoot32 on its own stack. The OS owned conventional
+ * memory, so restore the low stub and the thunk, then boot again.
+ */
+noreturn void warmboot_entry(void)
+{
+    struct csmwrap_priv *priv = warm.priv;
+
+    // timing_init reads exitat= through gBA, so point it at our copy first.
+    gBA = &warm.ba;
+    timing_init();
+
+    warm.count++;
+    printf("WARMBOOT: warm reboot #%d\n", warm.count);
+
+    // What the previous OS did, before the CSM starts over.
+    fastint10_dump();
+    int13cache_dump();
+    trace_dump();
+    profile_dump();
+
+    memcpy(priv->low_stub, &warm.low_stub, sizeof(struct low_stub));
+    LegacyBiosInitializeThunk(lowmem.thunk, LOWMEM_THUNK_SIZE);
+    timing_mark("warm restore");
+
+    legacy16_boot(priv);
+}
@@ -0,0 +1,15 @@
+/*
+ * Copyright (C) 2025 Sylas Hollander.
+ * PURPOSE: Header for the warm reboot path.
+ * SPDX-License-Identifier: MIT
+*/
+
+#pragma once
+
+#define RESET_VECTOR            0x000FFFF0
+
+/* Functions */
+extern int warmboot_setup(struct csmwrap_priv *priv);
+extern void warmboot_save(struct csmwrap_priv *priv);
+extern int warmboot_install(struct csmwrap_priv *priv);
+extern noreturn void warmboot_entry(void);
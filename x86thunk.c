@@ -10,6 +10,8 @@
 
 #include "csmwrapple.h"
 #include "x86thunk.h"
+#include "pmc.h"
+#include "timing.h"
 
 // FIXME: Are we going to implement it?
 #define ASSERT(x)
@@ -360,7 +362,11 @@ boolean_t InternalLegacyBiosFarCall (uint16_t Segment, uint16_t Offset, EFI_IA32
   // Status = Private->Legacy8259->SetMode (Private->Legacy8259, Efi8259LegacyMode, NULL, NULL);
   // ASSERT_EFI_ERROR (Status);
 
+  pmc_thunk_begin ();
+  timing_thunk_begin ();
   AsmThunk16 (&mThunkContext);
+  timing_thunk_end ();
+  pmc_thunk_end ();
 
   if ((Stack != NULL) && (StackSize != 0)) {
     //
@@ -432,21 +438,17 @@ boolean_t InternalLegacyBiosFarCall (uint16_t Segment, uint16_t Offset, EFI_IA32
   return (boolean_t)(Regs->X.Flags.CF == 1);
 }
 
-// Return final pointer
-uintptr_t LegacyBiosInitializeThunkAndTable(uintptr_t MemoryAddress, size_t data_size) {
-  uintptr_t data_pages = (data_size / EFI_PAGE_SIZE) + 1;
-
-  mThunkContext.RealModeBuffer     = (void *)(uintptr_t)(MemoryAddress + (data_pages * EFI_PAGE_SIZE));
-  mThunkContext.RealModeBufferSize = EFI_PAGE_SIZE;
+// The buffer holds the thunk code, the stack grows down from its end
+void LegacyBiosInitializeThunk(uintptr_t MemoryAddress, size_t Size) {
+  mThunkContext.RealModeBuffer     = (void *)MemoryAddress;
+  mThunkContext.RealModeBufferSize = Size;
   mThunkContext.ThunkAttributes    = THUNK_ATTRIBUTE_BIG_REAL_MODE | THUNK_ATTRIBUTE_DISABLE_A20_MASK_INT_15;
 
   memset(mThunkContext.RealModeBuffer, 0, mThunkContext.RealModeBufferSize);
 
-  printf("RealmodeBuffer %lx\n", (uintptr_t)mThunkContext.RealModeBuffer);
+  printf("RealmodeBuffer %x\n", (uint32_t)(uintptr_t)mThunkContext.RealModeBuffer);
 
   AsmPrepareThunk16 (&mThunkContext);
-
-  return (uintptr_t)mThunkContext.RealModeBuffer + mThunkContext.RealModeBufferSize + EFI_PAGE_SIZE;
 }
 
 #if 0
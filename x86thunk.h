@@ -403,7 +403,7 @@ typedef struct {
 
 #pragma pack()
 
-extern uintptr_t LegacyBiosInitializeThunkAndTable(uintptr_t MemoryAddress, size_t data_size);
+extern void LegacyBiosInitializeThunk(uintptr_t MemoryAddress, size_t Size);
 
 extern boolean_t LegacyBiosFarCall86 (uint16_t Segment, uint16_t Offset, EFI_IA32_REGISTER_SET *Regs, void *Stack, uintptr_t StackSize);
 